@@ -0,0 +1,27 @@
+#pragma once
+#ifndef BUILD_ARTIFACTS_H
+#define BUILD_ARTIFACTS_H
+
+#include <filesystem>
+#include <string>
+
+#include "build/manager.hpp"
+
+namespace muuk {
+    namespace build {
+        /// Prebuilt dependency archives live in `<cache dir>/artifacts`, shared
+        /// by every project on the machine.
+        std::filesystem::path artifact_cache_dir();
+
+        /// Copies the cached archive for `key` to `archive`. An archive already
+        /// restored for the same key is left untouched, so the targets linking
+        /// it aren't relinked. Returns false on a miss.
+        bool restore_prebuilt_library(const std::string& key, const std::filesystem::path& archive);
+
+        /// Stores the archives built for prebuilt library misses, once the
+        /// build succeeded.
+        void store_prebuilt_libraries(const BuildManager& build_manager);
+    } // namespace build
+} // namespace muuk
+
+#endif // BUILD_ARTIFACTS_H
@@ -0,0 +1,98 @@
+#pragma once
+#ifndef BUILD_AUTO_PCH_H
+#define BUILD_AUTO_PCH_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace muuk {
+    namespace build {
+        namespace pch {
+            /// Name of the header generated under `muukfiles/<pkg>/`.
+            const std::string AUTO_PCH_HEADER = "auto_pch.hpp";
+
+            /// Inclusion statistics backing the generated header.
+            const std::string AUTO_PCH_STATE = "auto_pch.json";
+
+            struct IncludeDirective {
+                std::string spelling;
+                bool angled = false;
+            };
+
+            /// A translation unit and the headers it was last compiled against.
+            struct TranslationUnit {
+                std::string source;
+                std::vector<std::string> headers;
+            };
+
+            struct Candidate {
+                /// Text following `#include` in the generated header
+                std::string include;
+
+                /// Absolute path of the header
+                std::string path;
+
+                size_t tu_count = 0;
+                double fraction = 0.0;
+
+                /// Estimated bytes parsed when including the header, counting
+                /// the headers that are only ever pulled in alongside it.
+                std::uintmax_t cost = 0;
+
+                double score = 0.0;
+
+                /// Position of the header's first appearance across the TUs,
+                /// used to keep the generated include order stable.
+                size_t order = 0;
+            };
+
+            struct AutoPchOptions {
+                /// Minimum fraction of the package's TUs that must include a header.
+                double min_fraction = 0.5;
+
+                size_t max_headers = 32;
+
+                /// The header set is only rewritten once the selection differs
+                /// from the previous one by more than this (Jaccard distance).
+                double recompute_threshold = 0.25;
+
+                /// Packages with fewer TUs don't benefit from a PCH.
+                size_t min_translation_units = 3;
+            };
+
+            /// Extracts the `#include` directives of a source file.
+            std::vector<IncludeDirective> scan_includes(const std::string& source);
+
+            /// Finds which of a translation unit's recorded headers an include
+            /// directive resolved to, or null.
+            const std::string* resolve_include(const IncludeDirective& directive, const std::vector<std::string>& headers);
+
+            /// Whether a header lives outside the project or in its vendored
+            /// dependencies, so it rarely changes.
+            bool is_stable_header(const std::filesystem::path& header, const std::filesystem::path& project_root);
+
+            /// Ranks the headers included directly by `tus`, best candidate first.
+            std::vector<Candidate> rank_candidates(
+                const std::vector<TranslationUnit>& tus,
+                const AutoPchOptions& options = {});
+
+            /// Regenerates `package_dir/auto_pch.hpp` from the latest inclusion
+            /// statistics. Returns the path of the header to precompile, or an
+            /// empty string when the package should not use one.
+            std::string update_auto_pch(
+                const std::filesystem::path& package_dir,
+                const std::vector<TranslationUnit>& tus,
+                const AutoPchOptions& options = {});
+
+            /// Writes `package_dir/pch.hpp` forwarding to a user supplied header,
+            /// so the precompiled output never lands in the source tree.
+            std::string write_pch_wrapper(
+                const std::filesystem::path& package_dir,
+                const std::filesystem::path& header);
+        } // namespace pch
+    } // namespace build
+} // namespace muuk
+
+#endif // BUILD_AUTO_PCH_H
@@ -3,12 +3,16 @@
 #define BUILD_BACKEND_H
 
 #include <filesystem>
+#include <string>
+#include <unordered_map>
 
 #include <nlohmann/json.hpp>
 
+#include "build/executor.hpp"
 #include "build/manager.hpp"
 #include "build/targets.hpp"
 #include "compiler.hpp"
+#include "rustify.hpp"
 
 namespace muuk {
     namespace build {
@@ -19,6 +23,16 @@ namespace muuk {
             const std::string archiver_;
             const std::string linker_;
 
+            /// Command prefixed to every compile edge (e.g. `muuk cc-wrap --`)
+            std::string compiler_launcher_;
+
+            /// Command prefixed to every compile and link edge, before the
+            /// compiler launcher (e.g. `muuk exec --stats <file> --`)
+            std::string command_launcher_;
+
+            /// Appended to every `compile` edge (e.g. `-ftime-trace`)
+            std::string extra_cflags_;
+
         public:
             virtual ~BuildBackend() = default;
 
@@ -36,12 +50,39 @@ namespace muuk {
             virtual void generate_build_file(
                 const std::string& profile)
                 = 0;
+
+            void set_compiler_launcher(const std::string& launcher) {
+                compiler_launcher_ = launcher;
+            }
+
+            void set_command_launcher(const std::string& launcher) {
+                command_launcher_ = launcher;
+            }
+
+            void set_extra_cflags(const std::string& flags) {
+                extra_cflags_ = flags;
+            }
         };
 
         class NinjaBackend : public BuildBackend {
         private:
             std::filesystem::path build_dir_;
 
+            /// Critical path weight of each output. Ninja starts ready edges
+            /// in manifest order, so heavier edges are written first.
+            std::unordered_map<std::string, double> priorities_;
+
+            /// Resource pool of each pooled output, and the depth of each
+            /// pool, from the native build graph
+            std::unordered_map<std::string, std::string> pools_;
+            std::unordered_map<std::string, size_t> pool_depths_;
+
+            /// Profile of the build, for the post-link edges
+            const BuildProfile* profile_ = nullptr;
+
+            /// Order-only inputs of every C and C++ compile edge
+            std::vector<std::string> generated_headers_;
+
         public:
             NinjaBackend(
                 const BuildManager& build_manager,
@@ -57,11 +98,66 @@ namespace muuk {
             std::string generate_rule(const ArchiveTarget& target) const;
             std::string generate_rule(const LinkTarget& target) const;
             std::string generate_rule(const ExternalTarget& target) const;
+            std::string generate_rule(const PrecompiledHeaderTarget& target) const;
+
+            /// `  pool = <pool>` for a pooled output
+            std::string pool_binding(const std::string& output) const;
 
             void generate_build_rules(std::ostringstream& out) const;
             void write_header(std::ostringstream& out, std::string profile) const;
         };
 
+        /// Builds the targets in-process with `build::Executor` instead of
+        /// writing a `build.ninja`. Commands mirror the Ninja backend's rules.
+        class NativeBackend : public BuildBackend {
+        private:
+            std::filesystem::path build_dir_;
+            BuildGraph graph_;
+
+            std::string profile_cflags_;
+            std::string profile_aflags_;
+            std::string profile_lflags_;
+
+            /// `BuildProfile::dwp`
+            std::string dwp_;
+
+            const BuildProfile* profile_ = nullptr;
+
+            /// `BuildManager::get_generated_headers`
+            std::vector<std::string> generated_headers_;
+
+        public:
+            NativeBackend(
+                const BuildManager& build_manager,
+                const Compiler compiler,
+                const std::string& archiver,
+                const std::string& linker);
+
+            /// Builds the graph of `profile`. Nothing is written to disk.
+            void generate_build_file(
+                const std::string& profile) override;
+
+            /// `generate_build_file` without the progress output. Edge
+            /// priorities come from the durations logged by previous builds.
+            void build_graph(const std::string& profile);
+
+            const BuildGraph& graph() const { return graph_; }
+
+            /// Brings `target` (a link target's name or an output, all
+            /// targets if empty) up to date.
+            Result<ExecutorStats> execute(const std::string& target, size_t jobs);
+
+        private:
+            void add_edge(const CompilationTarget& target);
+            void add_edge(const ArchiveTarget& target);
+            void add_edge(const LinkTarget& target);
+            void add_edge(const ExternalTarget& target);
+            void add_edge(const PrecompiledHeaderTarget& target);
+
+            /// `modules/` relative to the build directory, as in `build.ninja`
+            std::string module_dir() const;
+        };
+
         class CompileCommandsBackend : public BuildBackend {
         private:
             std::filesystem::path build_dir_;
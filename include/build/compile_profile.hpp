@@ -0,0 +1,61 @@
+#pragma once
+#ifndef BUILD_COMPILE_PROFILE_H
+#define BUILD_COMPILE_PROFILE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "build/executor.hpp"
+#include "compiler.hpp"
+#include "rustify.hpp"
+
+namespace muuk {
+    namespace build {
+        /// Time spent on one header, template or function, summed over every
+        /// translation unit.
+        struct ProfileCost {
+            std::string name;
+            int64_t total_us = 0;
+            size_t count = 0;
+        };
+
+        /// Totals of the `-ftime-trace` files of a build.
+        struct CompileProfile {
+            size_t translation_units = 0;
+            int64_t frontend_us = 0;
+            int64_t backend_us = 0;
+
+            /// Total time of each translation unit
+            std::unordered_map<std::string, ProfileCost> units;
+
+            /// Parsing each header, including the headers it includes
+            std::unordered_map<std::string, ProfileCost> headers;
+
+            /// Each instantiation, and each template over all its arguments
+            std::unordered_map<std::string, ProfileCost> instantiations;
+            std::unordered_map<std::string, ProfileCost> templates;
+
+            /// Code generation and optimization of each function
+            std::unordered_map<std::string, ProfileCost> functions;
+        };
+
+        /// Flags that make `compiler` profile each translation unit. Only Clang
+        /// writes a trace that `add_time_trace` can read.
+        std::string compile_profile_flags(const Compiler& compiler);
+
+        /// Adds the Clang `-ftime-trace` JSON of `unit` to `profile`.
+        Result<void> add_time_trace(CompileProfile& profile, const std::string& unit, const std::string& trace);
+
+        /// The `top` most expensive entries of each kind, as text.
+        std::string format_compile_profile(const CompileProfile& profile, size_t top);
+
+        /// Collects the trace next to the object of every compile edge in
+        /// `graph` and writes the report to `build_dir / compile_profile.txt`.
+        Result<std::string> write_compile_profile(const BuildGraph& graph, const std::filesystem::path& build_dir);
+    } // namespace build
+} // namespace muuk
+
+#endif // BUILD_COMPILE_PROFILE_H
@@ -0,0 +1,41 @@
+#pragma once
+#ifndef BUILD_DEPS_H
+#define BUILD_DEPS_H
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "build/manager.hpp"
+
+namespace muuk {
+    namespace build {
+        /// Maps a compiled output (as written in `build.ninja`) to the headers
+        /// it was compiled against during the previous build.
+        using HeaderDependencies = std::unordered_map<std::string, std::vector<std::string>>;
+
+        /// Parses a Makefile-style depfile (as written by `-MD -MF`) and returns
+        /// every prerequisite of its first target.
+        std::vector<std::string> parse_depfile(const std::string& contents);
+
+        /// Parses the output of `ninja -t deps`.
+        HeaderDependencies parse_ninja_deps_output(const std::string& output);
+
+        /// Parses Ninja's binary deps log (`.ninja_deps`, versions 3 and 4)
+        /// without running `ninja`. Paths are as Ninja recorded them.
+        HeaderDependencies read_ninja_deps_log(const std::string& contents);
+
+        /// Loads the header dependencies recorded for the compilation targets
+        /// of the previous build in `build_dir`. Header paths are made absolute.
+        ///
+        /// Ninja's deps log and the native executor's are read first;
+        /// targets missing from both fall back to a `<output>.d` depfile next
+        /// to the object.
+        HeaderDependencies load_header_dependencies(
+            const BuildManager& build_manager,
+            const std::filesystem::path& build_dir);
+    } // namespace build
+} // namespace muuk
+
+#endif // BUILD_DEPS_H
@@ -0,0 +1,190 @@
+#pragma once
+#ifndef BUILD_EXECUTOR_H
+#define BUILD_EXECUTOR_H
+
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "rustify.hpp"
+
+namespace muuk {
+    namespace build {
+        /// Header dependencies recorded by the native executor.
+        const std::string DEPS_LOG_FILE = ".muuk_deps";
+
+        /// Command hashes and timings of the edges run by the native executor.
+        const std::string BUILD_LOG_FILE = ".muuk_log";
+
+        /// Pool of the link edges when LTO is on (`lto-jobs` deep).
+        const std::string LTO_LINK_POOL = "lto_link";
+
+        /// Pool of the other link edges and of BOLT, sized by memory.
+        const std::string LINK_POOL = "link_pool";
+
+        /// Pool of precompiled headers and of sources marked `pool = "heavy"`.
+        const std::string HEAVY_POOL = "heavy";
+
+        /// Inputs and flags longer than this go in a response file. Below
+        /// the 8191 characters `cmd /c` takes, and far below Linux's 128 KiB
+        /// limit on the `/bin/sh -c` argument.
+        constexpr size_t RSPFILE_THRESHOLD = 8000;
+
+        /// How an edge reports the headers it read.
+        enum class DepsFormat {
+            None,
+            /// A Makefile style depfile (`-MD -MF`)
+            Gcc,
+            /// `/showIncludes` lines on stdout
+            Msvc,
+        };
+
+        /// A command producing `outputs` from `inputs`. Paths are relative to
+        /// the build directory, like in `build.ninja`.
+        struct BuildEdge {
+            /// Rule the command was derived from (e.g. `compile`, `link`)
+            std::string rule;
+
+            std::vector<std::string> outputs;
+            std::vector<std::string> inputs;
+
+            /// Inputs that aren't on the command line (module interfaces, PCHs)
+            std::vector<std::string> implicit_inputs;
+
+            std::string command;
+            std::string description;
+
+            /// Written before the command runs, which reads it as `@rspfile`,
+            /// and removed once it succeeds
+            std::string rspfile;
+            std::string rspfile_content;
+
+            std::string depfile;
+            DepsFormat deps = DepsFormat::None;
+
+            /// Among ready edges, higher priorities start first.
+            double priority = 0.0;
+
+            /// Limits how many edges of the same pool run at once, see
+            /// `BuildGraph::pools`
+            std::string pool;
+        };
+
+        struct BuildGraph {
+            std::vector<BuildEdge> edges;
+
+            /// Pool name -> depth, like Ninja's `pool` declarations
+            std::unordered_map<std::string, size_t> pools;
+
+            /// Short target names (e.g. `muuk`) -> outputs
+            std::unordered_map<std::string, std::vector<std::string>> aliases;
+        };
+
+        /// File modification time, in the file clock's ticks.
+        using FileTime = int64_t;
+
+        constexpr FileTime MISSING_FILE = std::numeric_limits<FileTime>::min();
+
+        /// Returns `MISSING_FILE` if the file doesn't exist.
+        FileTime file_time(const std::filesystem::path& path);
+
+        /// Headers of each output, as of its last successful build.
+        class DepsLog {
+        public:
+            struct Entry {
+                /// Output mtime when the dependencies were recorded
+                FileTime mtime = 0;
+                std::vector<std::string> deps;
+            };
+
+            /// Loads the log, compacting it if it grew too much.
+            void load(const std::filesystem::path& path);
+
+            std::optional<Entry> lookup(const std::string& output) const;
+
+            /// Updates an entry and appends it to the log on disk.
+            void record(const std::string& output, FileTime mtime, std::vector<std::string> deps);
+
+            const std::unordered_map<std::string, Entry>& entries() const { return entries_; }
+
+        private:
+            std::filesystem::path path_;
+            std::unordered_map<std::string, Entry> entries_;
+            mutable std::mutex mutex_;
+        };
+
+        /// The command and timings of each output's last build. The first
+        /// five columns match `.ninja_log` (v5).
+        class BuildLog {
+        public:
+            struct Entry {
+                std::string output;
+
+                /// Milliseconds since the start of the build that ran it
+                int64_t start_ms = 0;
+                int64_t end_ms = 0;
+
+                /// Output mtime after the command ran
+                FileTime mtime = 0;
+
+                std::string command_hash;
+                long max_rss_kb = 0;
+            };
+
+            void load(const std::filesystem::path& path);
+
+            std::optional<Entry> lookup(const std::string& output) const;
+
+            /// Updates an entry and appends it to the log on disk.
+            void record(Entry entry);
+
+            const std::unordered_map<std::string, Entry>& entries() const { return entries_; }
+
+        private:
+            std::filesystem::path path_;
+            std::unordered_map<std::string, Entry> entries_;
+            mutable std::mutex mutex_;
+        };
+
+        std::string hash_command(const std::string& command);
+
+        struct ExecutorOptions {
+            /// Concurrent commands, 0 for one per hardware thread
+            size_t jobs = 0;
+
+            /// Outputs or aliases to bring up to date, all edges if empty
+            std::vector<std::string> targets;
+        };
+
+        struct ExecutorStats {
+            size_t ran = 0;
+            size_t up_to_date = 0;
+        };
+
+        /// Runs a build graph in-process on a work-stealing pool.
+        ///
+        /// An edge is evaluated once everything producing its inputs is done.
+        /// It reruns when an output is missing, its command changed, or any
+        /// input (including recorded headers) is newer than the output was
+        /// after its last run. Comparing against the recorded mtime gives
+        /// restat for free: an edge that leaves its output untouched doesn't
+        /// dirty the edges depending on it.
+        class Executor {
+        public:
+            Executor(std::filesystem::path build_dir, BuildGraph graph);
+
+            Result<ExecutorStats> run(const ExecutorOptions& options);
+
+        private:
+            std::filesystem::path build_dir_;
+            BuildGraph graph_;
+        };
+    } // namespace build
+} // namespace muuk
+
+#endif // BUILD_EXECUTOR_H
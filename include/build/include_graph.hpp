@@ -0,0 +1,65 @@
+#pragma once
+#ifndef BUILD_INCLUDE_GRAPH_H
+#define BUILD_INCLUDE_GRAPH_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "build/auto_pch.hpp"
+
+namespace muuk {
+    namespace build {
+        struct HeaderCost {
+            /// Absolute path of the header
+            std::string path;
+
+            /// Outside the project or under `deps/`
+            bool stable = false;
+
+            std::uintmax_t size = 0;
+
+            /// The header and every header it includes, transitively
+            std::uintmax_t transitive_size = 0;
+
+            /// Files (sources and headers) that include it directly
+            size_t includers = 0;
+
+            /// Translation units that are rebuilt when it changes
+            size_t translation_units = 0;
+            double fraction = 0.0;
+
+            /// Bytes parsed because of the header across the whole build:
+            /// `translation_units * transitive_size`
+            std::uintmax_t cost = 0;
+        };
+
+        struct IncludeReport {
+            size_t translation_units = 0;
+
+            /// Most expensive first
+            std::vector<HeaderCost> headers;
+        };
+
+        /// Reads a file, or returns an empty string.
+        using FileReader = std::function<std::string(const std::string&)>;
+
+        /// Rebuilds the include graph of `tus` from their recorded headers and
+        /// the `#include` directives of every file.
+        IncludeReport analyze_includes(
+            const std::vector<pch::TranslationUnit>& tus,
+            const FileReader& read_file);
+
+        /// The most expensive headers, the ones whose edits rebuild the most
+        /// translation units, and the ones included by at least
+        /// `widespread_fraction` of them.
+        std::string format_include_report(const IncludeReport& report, size_t top, double widespread_fraction = 0.8);
+
+        nlohmann::json include_report_json(const IncludeReport& report);
+    } // namespace build
+} // namespace muuk
+
+#endif // BUILD_INCLUDE_GRAPH_H
@@ -0,0 +1,53 @@
+#pragma once
+#ifndef BUILD_ISA_H
+#define BUILD_ISA_H
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "rustify.hpp"
+
+namespace muuk {
+    namespace build {
+        namespace isa {
+            /// Validates a library's `isa_levels` and orders them from the
+            /// baseline up. Only the x86-64 micro-architecture levels are known.
+            Result<std::vector<std::string>> sort_levels(const std::vector<std::string>& levels);
+
+            /// The object of `object` compiled for `level`: `a.cpp.o` becomes
+            /// `a.cpp.x86-64-v3.o`.
+            std::string variant_object(const std::string& object, const std::string& level);
+
+            /// The ISPC `--target` closest to `level`, e.g. `avx2-i32x8`.
+            std::string ispc_target(const std::string& level);
+
+            /// Appended to the symbols of a variant: `.x86_64_v3`
+            std::string symbol_suffix(const std::string& level);
+
+            /// C source that defines each symbol as an ifunc. The resolver
+            /// picks the highest level the CPU supports, among the levels in
+            /// `defined` (one set per level, baseline first) that define it.
+            std::string dispatch_source(const std::vector<std::string>& levels, const std::vector<std::set<std::string>>& defined);
+
+            struct ArchiveOptions {
+                std::string compiler;
+                std::string archiver;
+                std::string output;
+
+                /// Baseline first
+                std::vector<std::string> levels;
+
+                /// Variant objects, plus any object shared by all levels
+                std::vector<std::string> objects;
+            };
+
+            /// Archives the variants of a multi-ISA library (`muuk isa-archive`).
+            /// The symbols of each variant get its `symbol_suffix`, and a
+            /// generated dispatch object defines the original names.
+            Result<void> archive(const ArchiveOptions& options);
+        } // namespace isa
+    } // namespace build
+} // namespace muuk
+
+#endif // BUILD_ISA_H
@@ -0,0 +1,24 @@
+#pragma once
+#ifndef BUILD_LINKER_H
+#define BUILD_LINKER_H
+
+#include <string>
+#include <vector>
+
+#include "compiler.hpp"
+#include "rustify.hpp"
+
+namespace muuk {
+    namespace build {
+        /// Whether `compiler` can link with `-fuse-ld=<linker>`. Probed once
+        /// per linker and cached for the rest of the process.
+        bool linker_available(const Compiler& compiler, const std::string& linker);
+
+        /// Link flags for a profile's `linker` key: `mold`, `lld`, `gold`, or
+        /// `auto` for the fastest one installed. Empty when the default linker
+        /// is used.
+        Result<std::vector<std::string>> linker_flags(const Compiler& compiler, const std::string& linker);
+    } // namespace build
+} // namespace muuk
+
+#endif // BUILD_LINKER_H
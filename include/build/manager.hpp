@@ -15,6 +15,48 @@ namespace muuk {
             std::vector<std::string> aflags;
             std::vector<std::string> lflags;
             std::vector<std::string> defines;
+
+            /// Profile wide unity build defaults. Packages may override them.
+            bool unity = false;
+            size_t unity_batch = 0;
+
+            /// Packs the split DWARF of each linked binary into `<binary>.dwp`
+            /// with this tool (`split-debuginfo = "packed"`)
+            std::string dwp;
+
+            /// Concurrent LTO links, 0 when LTO is off. Each one already uses
+            /// every core (`lto-jobs`)
+            size_t lto_jobs = 0;
+
+            /// Post-link code layout from the `muuk pgo` training runs:
+            /// `bolt` or `symbol-order` (`layout`)
+            std::string layout;
+
+            /// `<executable>.fdata` BOLT profiles recorded by `muuk pgo`
+            std::string bolt_data;
+
+            /// Depth overrides of the resource pools, e.g. `link_pool` (`pools`)
+            std::unordered_map<std::string, size_t> pools;
+
+            /// `thin` archives only store the paths of their objects, `none`
+            /// links the objects of libraries directly. Empty for full
+            /// archives (`archives`)
+            std::string archives;
+
+            /// Appended to the cflags of the packages under `deps/`
+            /// (`dependency-debug`)
+            std::vector<std::string> dependency_cflags;
+        };
+
+        /// A dependency archive shared between projects through the artifact cache.
+        struct PrebuiltLibrary {
+            std::string key;
+
+            /// Archive path relative to the project root
+            std::string archive;
+
+            /// Restored from the cache, so the package is neither compiled nor archived
+            bool restored = false;
         };
 
         /// Contains each of the targets to be built.
@@ -23,12 +65,22 @@ namespace muuk {
             std::vector<ArchiveTarget> archive_targets;
             std::vector<ExternalTarget> external_targets;
             std::vector<LinkTarget> link_targets;
+            std::vector<PrecompiledHeaderTarget> pch_targets;
 
             std::unordered_map<std::string, std::string> object_registry;
             std::unordered_map<std::string, std::string> library_registry;
 
+            /// Package id (e.g. `library.fmt`) -> index into `pch_targets`
+            std::unordered_map<std::string, size_t> pch_registry;
+
             std::unordered_map<std::string, BuildProfile> profiles;
 
+            /// Package id (e.g. `library.fmt`) -> cached archive
+            std::unordered_map<std::string, PrebuiltLibrary> prebuilt_libraries;
+
+            /// Archive path -> objects, for libraries linked without an archive
+            std::unordered_map<std::string, std::vector<std::string>> object_libraries;
+
         public:
             void add_compilation_target(
                 const std::string src,
@@ -36,10 +88,17 @@ namespace muuk {
                 const CompilationFlags compilation_flags,
                 const CompilationUnitType compilation_unit_type = CompilationUnitType::Source);
 
+            void add_pch_target(
+                const std::string& package_id,
+                const std::string header,
+                const std::string pch,
+                const CompilationFlags compilation_flags);
+
             void add_archive_target(
                 const std::string lib,
                 const std::vector<std::string> objs,
-                const std::vector<std::string> aflags);
+                const std::vector<std::string> aflags,
+                const std::vector<std::string> isa_levels = {});
 
             void add_external_target(
                 const std::string& type_,
@@ -68,6 +127,28 @@ namespace muuk {
             std::vector<LinkTarget>& get_link_targets();
             const std::vector<LinkTarget>& get_link_targets() const;
 
+            const std::vector<PrecompiledHeaderTarget>& get_pch_targets() const;
+
+            /// Headers generated by compilation targets (ISPC). Every C and
+            /// C++ source waits for them, as any of them may include one.
+            std::vector<std::string> get_generated_headers() const;
+
+            /// Finds the precompiled header registered for a package (e.g. `build.muuk`).
+            const PrecompiledHeaderTarget* find_pch_target(const std::string& package_id) const;
+
+            void add_prebuilt_library(const std::string& package_id, PrebuiltLibrary library);
+
+            const PrebuiltLibrary* find_prebuilt_library(const std::string& package_id) const;
+
+            const std::unordered_map<std::string, PrebuiltLibrary>& get_prebuilt_libraries() const;
+
+            /// Registers a library whose objects are linked directly, in place
+            /// of the archive `lib` (`archives = "none"`).
+            void add_object_library(const std::string& lib, std::vector<std::string> objs);
+
+            /// The objects linked in place of the archive `lib`, if it isn't built.
+            const std::vector<std::string>* find_object_library(const std::string& lib) const;
+
             CompilationTarget* find_compilation_target(
                 const std::string& key,
                 const std::string& value);
@@ -8,11 +8,24 @@
 #include <toml.hpp>
 
 #include "build/manager.hpp"
+#include "build/pgo.hpp"
 #include "build/targets.hpp"
 #include "compiler.hpp"
 
 namespace muuk {
     namespace build {
+        struct ParseOptions {
+            /// Precompile the headers most translation units of a package share.
+            bool auto_pch = false;
+
+            /// Link dependency archives from the shared artifact cache.
+            bool artifact_cache = false;
+
+            /// `Instrument` registers the profile under
+            /// `pgo::instrumented_profile` too, for `muuk pgo`
+            pgo::Stage pgo = pgo::Stage::Optimize;
+        };
+
         std::tuple<std::string, std::string, std::string> get_profile_flag_strings(
             const BuildManager& manager,
             const std::string& profile);
@@ -21,14 +34,16 @@ namespace muuk {
             BuildManager& build_manager,
             const Compiler compiler,
             const std::filesystem::path& build_dir,
-            const std::string& profile);
+            const std::string& profile,
+            const ParseOptions& options = {});
 
         void parse_compilation_targets(
             BuildManager& build_manager,
             const muuk::Compiler compiler,
             const std::filesystem::path& build_dir,
+            const toml::value& muuk_file,
             const std::string& profile,
-            const toml::value& muuk_file);
+            const ParseOptions& options = {});
 
         void parse_libraries(
             BuildManager& build_manager,
@@ -0,0 +1,82 @@
+#pragma once
+#ifndef BUILD_PGO_H
+#define BUILD_PGO_H
+
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "build/manager.hpp"
+#include "compiler.hpp"
+#include "rustify.hpp"
+
+namespace muuk {
+    namespace build {
+        namespace pgo {
+            enum class Stage {
+                /// Optimize with the merged profile of `pgo/`, if there is one
+                Optimize,
+                /// Instrumented build in `build/<profile>-pgo-gen`
+                Instrument,
+            };
+
+            /// The profile name, and build directory, of the instrumented build
+            std::string instrumented_profile(const std::string& profile);
+
+            /// Where the instrumented binaries write their raw profiles.
+            std::filesystem::path raw_profile_dir(const std::string& profile);
+
+            /// The merged profile of `profile`, kept next to `muuk.toml` so it
+            /// can be committed: `pgo/<profile>.profdata` for Clang, a
+            /// directory of `.gcda` files for GCC.
+            std::filesystem::path profile_data(const Compiler& compiler, const std::string& profile);
+
+            /// Hottest functions first, for the linker (`layout = "symbol-order"`)
+            std::filesystem::path symbol_order_file(const std::string& profile);
+
+            /// `<executable>.fdata` BOLT profiles (`layout = "bolt"`)
+            std::filesystem::path bolt_profile_dir(const std::string& profile);
+
+            /// Adds the flags of `stage` to `build_profile`. Optimizing without
+            /// a merged profile adds nothing.
+            Result<void> add_flags(BuildProfile& build_profile, const Compiler& compiler, const std::string& profile, Stage stage);
+
+            /// Runs a training command against the instrumented build. Paths
+            /// under `build/<profile>/` are redirected to it, and
+            /// `{build_dir}` is replaced with its directory.
+            std::string training_command(const std::string& command, const std::string& profile);
+
+            /// Merges the raw profiles of the training runs into
+            /// `profile_data`, replacing the previous one.
+            Result<std::filesystem::path> merge_profiles(const Compiler& compiler, const std::string& profile);
+
+            /// Mangled names of the functions that ran, by descending entry
+            /// count, from `llvm-profdata show --all-functions`.
+            std::vector<std::string> hottest_functions(const std::string& profdata_show);
+
+            /// Writes `symbol_order_file` from the merged Clang profile.
+            Result<std::filesystem::path> write_symbol_order(const Compiler& compiler, const std::string& profile);
+
+            /// Instruments each executable with `llvm-bolt`, runs `train` with
+            /// the instrumented binaries in place of the originals, and merges
+            /// what they recorded into `bolt_profile_dir`.
+            Result<void> record_bolt_profiles(
+                const std::vector<std::filesystem::path>& executables,
+                const std::string& profile,
+                const std::function<Result<void>()>& train);
+
+            /// Rewrites `input` to `output` with the layout recorded in `fdata`.
+            std::string bolt_command(const std::string& input, const std::string& output, const std::string& fdata);
+
+            /// The BOLT profile of a linked executable, or an empty string.
+            std::string bolt_profile(const BuildProfile& build_profile, const std::string& output);
+
+            /// Sources edited after the profile was merged. Their counters no
+            /// longer match the code.
+            std::vector<std::string> stale_sources(const BuildManager& build_manager, const std::filesystem::path& data);
+        } // namespace pgo
+    } // namespace build
+} // namespace muuk
+
+#endif // BUILD_PGO_H
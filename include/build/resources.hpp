@@ -0,0 +1,57 @@
+#pragma once
+#ifndef BUILD_RESOURCES_H
+#define BUILD_RESOURCES_H
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+
+#include "build/manager.hpp"
+
+namespace muuk {
+    namespace build {
+        /// Memory a link or BOLT edge may need, in MiB
+        constexpr size_t LINK_JOB_MEMORY_MB = 2048;
+
+        /// Memory a heavy (template-heavy, generated) translation unit may need, in MiB
+        constexpr size_t HEAVY_JOB_MEMORY_MB = 4096;
+
+        /// Memory a compile is assumed to need before a build has logged any, in MiB
+        constexpr size_t COMPILE_JOB_MEMORY_MB = 1024;
+
+        /// Physical memory available to muuk, in MiB: the smaller of the
+        /// machine's and the cgroup's limit. 0 if unknown.
+        size_t total_memory_mb();
+
+        /// Memory not in use by other processes, in MiB: `MemAvailable`
+        /// capped by the cgroup's limit. The total where that isn't known.
+        size_t available_memory_mb();
+
+        /// CPUs muuk may run on: the online ones in its affinity mask,
+        /// capped by the cgroup's CPU quota. At least one.
+        size_t available_cpus();
+
+        /// Peak memory of a typical compile in the previous builds of
+        /// `build_dir` (from `.muuk_log`), in MiB. 0 without history.
+        size_t compile_memory_mb(const std::filesystem::path& build_dir);
+
+        /// Jobs for `cpus` CPUs, when each one needs `job_memory_mb` of
+        /// `memory_mb`. Unknown (0) memory doesn't limit them.
+        size_t jobs_within(size_t cpus, size_t memory_mb, size_t job_memory_mb);
+
+        /// `-j auto` for the build in `build_dir`
+        size_t auto_jobs(const std::filesystem::path& build_dir);
+
+        /// How many jobs needing `job_memory_mb` each fit in `memory_mb`, at
+        /// least one. 0 (no limit) if the memory is unknown.
+        size_t pool_depth(size_t memory_mb, size_t job_memory_mb);
+
+        /// Depth of each resource pool: `link_pool` and `heavy` sized by
+        /// memory, `lto_link` by `lto-jobs`. The profile's `pools` take
+        /// precedence. Pools without a limit are left out.
+        std::unordered_map<std::string, size_t> resource_pools(const BuildProfile* build_profile, size_t memory_mb);
+    } // namespace build
+} // namespace muuk
+
+#endif // BUILD_RESOURCES_H
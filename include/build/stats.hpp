@@ -0,0 +1,67 @@
+#pragma once
+#ifndef BUILD_STATS_H
+#define BUILD_STATS_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rustify.hpp"
+
+namespace muuk {
+    namespace build {
+        /// Resource usage of the commands run through `muuk exec`.
+        const std::string STATS_FILE = ".muuk_stats";
+
+        /// What one compile or link used, as reported by `wait4`.
+        struct CommandStats {
+            /// Output of the command, relative to the build directory
+            std::string output;
+
+            /// File name of the tool that ran, e.g. `g++`
+            std::string tool;
+
+            int32_t exit_code = 0;
+            int64_t wall_ms = 0;
+            int64_t user_ms = 0;
+            int64_t sys_ms = 0;
+            int64_t max_rss_kb = 0;
+            int64_t in_blocks = 0;
+            int64_t out_blocks = 0;
+        };
+
+        /// One record of `.muuk_stats`: a version byte, the counters in
+        /// little endian, then the tool and the output, each prefixed by
+        /// their 16-bit length.
+        std::string encode_stats(const CommandStats& stats);
+
+        /// The records of `.muuk_stats`, in file order. A record cut short
+        /// (an interrupted write) ends the list.
+        std::vector<CommandStats> decode_stats(const std::string& contents);
+
+        /// The last record of each output, in file order.
+        std::vector<CommandStats> latest_stats(const std::vector<CommandStats>& records);
+
+        std::vector<CommandStats> load_stats(const std::filesystem::path& file);
+
+        /// Rewrites `file` with only the last record of each output, so it
+        /// doesn't grow with every build.
+        void compact_stats(const std::filesystem::path& file);
+
+        /// The output (`-o`, `/Fo`, `/OUT:`) and tool of a compile or link
+        /// command. The tool behind `muuk cc-wrap --` is the compiler.
+        std::pair<std::string, std::string> describe_command(const std::vector<std::string>& command);
+
+        /// Runs `command` (`muuk exec`), passing its output through, and
+        /// appends what it used to `stats_file`. Returns its exit code.
+        Result<int> exec(const std::filesystem::path& stats_file, const std::vector<std::string>& command);
+
+        /// The heaviest commands by CPU time and by peak memory, and the
+        /// totals of each tool (`muuk stats`).
+        std::string format_stats(const std::vector<CommandStats>& stats, size_t top);
+    } // namespace build
+} // namespace muuk
+
+#endif // BUILD_STATS_H
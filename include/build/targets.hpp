@@ -11,6 +11,8 @@ namespace muuk {
         enum class CompilationUnitType {
             Module,
             Source,
+            /// ISPC kernel, compiled into an object and a C/C++ header
+            Ispc,
             Count
         };
 
@@ -56,6 +58,33 @@ namespace muuk {
 
             /// Indicates whether the target is a module or a source file.
             CompilationUnitType compilation_unit_type;
+
+            /// Header force-included in front of the source when a PCH is in use.
+            std::string pch_header;
+
+            /// Precompiled header the target is compiled against (empty if none).
+            std::string pch;
+
+            /// Header written next to the object, e.g. `kernels_ispc.h` (ISPC only).
+            std::string generated_header;
+
+            /// Resource pool of the compile edge, `heavy` or empty (`pool`)
+            std::string pool;
+        };
+
+        /// A header precompiled once per package and shared by all of its
+        /// C++ translation units.
+        class PrecompiledHeaderTarget : public BuildTarget {
+        public:
+            PrecompiledHeaderTarget(
+                std::string header,
+                std::string pch,
+                CompilationFlags compilation_flags);
+
+            virtual ~PrecompiledHeaderTarget() = default;
+
+            /// Header that gets precompiled and force-included.
+            std::string header;
         };
 
         class ArchiveTarget : public BuildTarget {
@@ -63,8 +92,13 @@ namespace muuk {
             ArchiveTarget(
                 std::string lib,
                 std::vector<std::string> objs,
-                std::vector<std::string> aflags);
+                std::vector<std::string> aflags,
+                std::vector<std::string> isa_levels = {});
             virtual ~ArchiveTarget() = default;
+
+            /// ISA levels the objects were compiled for, baseline first. The
+            /// archive then dispatches between them at load time.
+            std::vector<std::string> isa_levels;
         };
 
         class ExternalTarget : public BuildTarget {
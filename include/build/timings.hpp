@@ -0,0 +1,101 @@
+#pragma once
+#ifndef BUILD_TIMINGS_H
+#define BUILD_TIMINGS_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "build/executor.hpp"
+#include "rustify.hpp"
+
+namespace muuk {
+    namespace build {
+        /// A line of `.ninja_log` or `.muuk_log`.
+        struct LogEntry {
+            /// Milliseconds since the start of the build that ran it
+            int64_t start_ms = 0;
+            int64_t end_ms = 0;
+
+            std::string output;
+        };
+
+        /// Parses a `.ninja_log` (v5 and later) or `.muuk_log`, in file order.
+        std::vector<LogEntry> parse_build_log(const std::string& contents);
+
+        /// Milliseconds each output took to build, last time it was built.
+        using EdgeDurations = std::unordered_map<std::string, int64_t>;
+
+        /// Reads the durations recorded by Ninja and by the native executor in
+        /// `build_dir`. The native executor's entries win.
+        EdgeDurations load_edge_durations(const std::filesystem::path& build_dir);
+
+        /// The duration of every edge, in milliseconds. Edges without history
+        /// get the mean duration of their rule, or of every edge.
+        std::vector<double> estimate_durations(const BuildGraph& graph, const EdgeDurations& durations);
+
+        /// The critical path weight of every edge: its duration plus that of
+        /// the longest chain of edges waiting on its outputs.
+        std::vector<double> critical_path_weights(const BuildGraph& graph, const std::vector<double>& durations);
+
+        /// Sets each edge's priority to its critical path weight, so the edges
+        /// heading the longest chains start first.
+        void assign_priorities(BuildGraph& graph, const EdgeDurations& durations);
+
+        /// The entries of the last build in a log. A build starts wherever the
+        /// end times go back, as each build counts from zero.
+        std::vector<LogEntry> last_build_entries(const std::vector<LogEntry>& entries);
+
+        struct TimedEdge {
+            std::string output;
+            std::string rule;
+
+            /// File name of the archive or binary the edge ends up in
+            std::string group;
+
+            int64_t start_ms = 0;
+            int64_t end_ms = 0;
+
+            /// Row of the edge in the trace; edges in a lane never overlap
+            size_t lane = 0;
+        };
+
+        struct TimingReport {
+            /// By start time
+            std::vector<TimedEdge> edges;
+
+            int64_t wall_ms = 0;
+
+            /// Sum of every edge's duration
+            int64_t total_ms = 0;
+            size_t lanes = 0;
+
+            /// Indices into `edges`, from the first edge to the last to finish
+            std::vector<size_t> critical_path;
+
+            /// Mean number of running edges in each slice of `bucket_ms`
+            std::vector<double> parallelism;
+            int64_t bucket_ms = 1;
+        };
+
+        /// Matches the log entries of a build to the edges of its graph.
+        TimingReport analyze_timings(const BuildGraph& graph, const std::vector<LogEntry>& entries);
+
+        /// The report in the Trace Event Format read by `chrome://tracing` and
+        /// Perfetto.
+        std::string format_chrome_trace(const TimingReport& report);
+
+        std::string format_timings_html(const TimingReport& report, const std::string& title);
+
+        /// Writes `timings.html` and `trace.json` to `build_dir`, for the last
+        /// build recorded in `build_dir / log_file`.
+        Result<void> write_timings_report(
+            const BuildGraph& graph,
+            const std::filesystem::path& build_dir,
+            const std::string& log_file);
+    } // namespace build
+} // namespace muuk
+
+#endif // BUILD_TIMINGS_H
@@ -0,0 +1,63 @@
+#pragma once
+#ifndef BUILD_WATCH_H
+#define BUILD_WATCH_H
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "rustify.hpp"
+
+namespace muuk {
+    namespace build {
+        /// How long the files have to stay untouched before a burst of
+        /// changes (a `git checkout`, a formatter) is acted on.
+        constexpr std::chrono::milliseconds WATCH_QUIET_PERIOD { 300 };
+
+        struct WatchChanges {
+            /// A `muuk.toml` changed, so the lock file is stale
+            bool manifests = false;
+
+            /// A source or header was added or removed (or a directory
+            /// was), so the `sources` globs may expand differently
+            bool directories = false;
+
+            /// Every changed path, sorted
+            std::vector<std::string> paths;
+
+            bool empty() const { return !manifests && !directories && paths.empty(); }
+        };
+
+        /// Reports changes to the files of a build, through inotify.
+        /// Directories are watched rather than files, so editors that save
+        /// by renaming a new file over the old one are seen too.
+        class Watcher {
+        public:
+            Watcher();
+            ~Watcher();
+
+            Watcher(const Watcher&) = delete;
+            Watcher& operator=(const Watcher&) = delete;
+
+            /// Watches the directories of `files` (absolute paths), instead of
+            /// the previous ones. Edits to `files`, and sources or headers
+            /// appearing next to them, are reported.
+            Result<void> watch(const std::vector<std::string>& files);
+
+            /// Blocks until something relevant changes, then keeps collecting
+            /// changes until none arrives for `quiet`.
+            Result<WatchChanges> wait(std::chrono::milliseconds quiet = WATCH_QUIET_PERIOD);
+
+        private:
+            int fd_ = -1;
+
+            /// Directory of each watch descriptor
+            std::unordered_map<int, std::string> dirs_;
+            std::unordered_set<std::string> files_;
+        };
+    } // namespace build
+} // namespace muuk
+
+#endif // BUILD_WATCH_H
@@ -0,0 +1,51 @@
+#pragma once
+#ifndef CACHE_COMPILER_CACHE_H
+#define CACHE_COMPILER_CACHE_H
+
+#include <string>
+#include <vector>
+
+namespace muuk {
+    namespace cache {
+        /// A GCC/Clang style compiler command, as seen by `muuk cc-wrap`.
+        struct CompilerInvocation {
+            std::vector<std::string> args;
+
+            std::string source;
+            std::string output;
+
+            /// `-MF` target, empty if no depfile is written
+            std::string depfile;
+
+            /// Precompiled headers passed with `-include-pch`
+            std::vector<std::string> pch_inputs;
+
+            bool cacheable = false;
+
+            /// Why the command can't be cached
+            std::string reason;
+        };
+
+        /// The compiler and its version banner, so upgrading the toolchain
+        /// invalidates everything built with the old one.
+        std::string compiler_identity(const std::string& compiler);
+
+        CompilerInvocation parse_invocation(const std::vector<std::string>& args);
+
+        /// The command that preprocesses the source to stdout instead of compiling it.
+        std::vector<std::string> preprocessor_args(const CompilerInvocation& invocation);
+
+        /// The arguments that influence the object file, without input and output paths.
+        std::vector<std::string> normalized_flags(const CompilerInvocation& invocation);
+
+        /// The flags that compile the source on another machine, without
+        /// input, output and depfile flags. With `preprocessed`, the flags
+        /// only the preprocessor reads are dropped as well.
+        std::vector<std::string> remote_compile_flags(const CompilerInvocation& invocation, bool preprocessed);
+
+        /// Writes a Makefile style depfile for `target`.
+        std::string format_depfile(const std::string& target, const std::vector<std::string>& deps);
+    } // namespace cache
+} // namespace muuk
+
+#endif // CACHE_COMPILER_CACHE_H
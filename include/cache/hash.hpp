@@ -0,0 +1,45 @@
+#pragma once
+#ifndef CACHE_HASH_H
+#define CACHE_HASH_H
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+#include "rustify.hpp"
+
+namespace muuk {
+    namespace cache {
+        /// Incremental SHA-256, used to derive content addresses.
+        class Sha256 {
+        public:
+            Sha256();
+
+            Sha256& update(const void* data, size_t size);
+            Sha256& update(std::string_view data);
+
+            /// Hashes a length prefixed field, so concatenated fields
+            /// can't collide (`"ab" + "c"` vs `"a" + "bc"`).
+            Sha256& field(std::string_view data);
+
+            /// Finishes the hash. The object must not be updated afterwards.
+            std::string hex_digest();
+
+        private:
+            void compress(const uint8_t* block);
+
+            std::array<uint32_t, 8> state_;
+            std::array<uint8_t, 64> buffer_;
+            size_t buffer_size_ = 0;
+            uint64_t total_size_ = 0;
+        };
+
+        std::string sha256_hex(std::string_view data);
+
+        Result<std::string> sha256_file(const std::filesystem::path& path);
+    } // namespace cache
+} // namespace muuk
+
+#endif // CACHE_HASH_H
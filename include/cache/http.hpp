@@ -0,0 +1,102 @@
+#pragma once
+#ifndef CACHE_HTTP_H
+#define CACHE_HTTP_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+
+#include "rustify.hpp"
+
+namespace muuk {
+    namespace cache {
+        /// A plain `http://host[:port][/prefix]` URL.
+        struct Url {
+            std::string host;
+            uint16_t port = 80;
+
+            /// Path prepended to every request, without a trailing '/'
+            std::string prefix;
+        };
+
+        Result<Url> parse_url(const std::string& url);
+
+        struct HttpRequest {
+            std::string method;
+            std::string path;
+            std::map<std::string, std::string> headers;
+            std::string body;
+        };
+
+        struct HttpResponse {
+            int status = 0;
+            std::map<std::string, std::string> headers;
+            std::string body;
+        };
+
+        /// A minimal HTTP/1.1 client keeping a single connection alive between
+        /// requests. Every network operation is bounded by `timeout`.
+        ///
+        /// Not thread safe; use one client per thread.
+        class HttpClient {
+        public:
+            HttpClient(Url url, std::chrono::milliseconds timeout);
+            ~HttpClient();
+
+            HttpClient(const HttpClient&) = delete;
+            HttpClient& operator=(const HttpClient&) = delete;
+
+            /// `path` is relative to the URL's prefix, e.g. `/cas/<hash>`.
+            Result<HttpResponse> request(const std::string& method, const std::string& path, const std::string& body = "");
+
+        private:
+            Result<void> connect();
+            void disconnect();
+            Result<HttpResponse> exchange(const std::string& request, bool head);
+
+            Url url_;
+            std::chrono::milliseconds timeout_;
+            intptr_t socket_ = -1;
+        };
+
+        /// A blocking HTTP/1.1 server answering requests from a fixed pool
+        /// of worker threads. Connections beyond what the pool can queue are
+        /// rejected with `503`.
+        class HttpServer {
+        public:
+            using Handler = std::function<HttpResponse(const HttpRequest&)>;
+
+            HttpServer(std::string bind_address, uint16_t port, size_t threads, Handler handler);
+            ~HttpServer();
+
+            HttpServer(const HttpServer&) = delete;
+            HttpServer& operator=(const HttpServer&) = delete;
+
+            /// Binds the listening socket. Port 0 picks a free port.
+            Result<void> listen();
+
+            /// The bound port, valid after `listen()`.
+            uint16_t port() const { return port_; }
+
+            /// Serves requests until `stop()` is called.
+            void serve();
+
+            void stop();
+
+        private:
+            void handle_connection(intptr_t client);
+
+            std::string bind_address_;
+            uint16_t port_;
+            size_t threads_;
+            Handler handler_;
+            intptr_t listener_ = -1;
+            std::atomic<bool> stopping_ = false;
+        };
+    } // namespace cache
+} // namespace muuk
+
+#endif // CACHE_HTTP_H
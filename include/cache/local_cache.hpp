@@ -0,0 +1,61 @@
+#pragma once
+#ifndef CACHE_LOCAL_CACHE_H
+#define CACHE_LOCAL_CACHE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#include "rustify.hpp"
+
+namespace muuk {
+    namespace cache {
+        /// Default size limit of the local cache (5 GiB).
+        constexpr std::uintmax_t DEFAULT_CACHE_SIZE = 5ull * 1024 * 1024 * 1024;
+
+        /// `$MUUK_CACHE_DIR`, otherwise `~/.cache/muuk` (`%LOCALAPPDATA%\muuk` on Windows).
+        std::filesystem::path default_cache_dir();
+
+        /// `$MUUK_CACHE_SIZE` (bytes, with an optional K/M/G suffix), otherwise `DEFAULT_CACHE_SIZE`.
+        std::uintmax_t default_cache_size();
+
+        /// A content-addressed store on disk.
+        ///
+        /// An entry is a set of files sharing a key, e.g. `<key>.o`, `<key>.d`,
+        /// stored under `objects/<first two hex digits>/`. Entries are written
+        /// atomically, so concurrent builds can share a cache. Hits refresh the
+        /// entry's mtime, and the least recently used entries are evicted once
+        /// a shard grows past its share of the size limit.
+        class LocalCache {
+        public:
+            LocalCache(
+                std::filesystem::path root = default_cache_dir(),
+                std::uintmax_t max_size = default_cache_size());
+
+            const std::filesystem::path& root() const { return root_; }
+
+            bool contains(const std::string& key, const std::string& name) const;
+
+            /// Copies a cached file to `destination`.
+            bool fetch(const std::string& key, const std::string& name, const std::filesystem::path& destination) const;
+
+            std::optional<std::string> read(const std::string& key, const std::string& name) const;
+
+            Result<void> store(const std::string& key, const std::string& name, const std::filesystem::path& source);
+
+            Result<void> write(const std::string& key, const std::string& name, const std::string& contents);
+
+            /// Evicts least recently used entries of the key's shard if it is over budget.
+            void evict(const std::string& key);
+
+        private:
+            std::filesystem::path entry_path(const std::string& key, const std::string& name) const;
+
+            std::filesystem::path root_;
+            std::uintmax_t max_size_;
+        };
+    } // namespace cache
+} // namespace muuk
+
+#endif // CACHE_LOCAL_CACHE_H
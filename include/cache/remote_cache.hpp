@@ -0,0 +1,67 @@
+#pragma once
+#ifndef CACHE_REMOTE_CACHE_H
+#define CACHE_REMOTE_CACHE_H
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "cache/http.hpp"
+#include "rustify.hpp"
+
+namespace muuk {
+    namespace cache {
+        /// The files of a cache entry, by name (`o`, `d`, `stderr`, ...).
+        using EntryFiles = std::map<std::string, std::string>;
+
+        struct RemoteCacheOptions {
+            std::string url;
+
+            std::chrono::milliseconds timeout { 2000 };
+
+            /// Concurrent connections used to transfer the files of an entry
+            size_t max_connections = 4;
+
+            /// Only read from the cache, e.g. on developer machines
+            bool read_only = false;
+        };
+
+        /// `$MUUK_REMOTE_CACHE`, `$MUUK_REMOTE_CACHE_TIMEOUT` (ms),
+        /// `$MUUK_REMOTE_CACHE_JOBS` and `$MUUK_REMOTE_CACHE_READONLY`.
+        /// Returns nothing if no remote cache is configured.
+        std::optional<RemoteCacheOptions> remote_cache_options_from_env();
+
+        /// A cache shared over HTTP, using the layout of bazel-remote:
+        ///
+        /// - `GET/PUT /cas/<sha256>`: a blob, addressed by the hash of its contents
+        /// - `GET/PUT /ac/<key>`: an entry, listing `<name>\t<sha256>` per file
+        ///
+        /// Files are transferred in parallel over up to `max_connections`
+        /// connections, and every request is bounded by `timeout`.
+        class RemoteCache {
+        public:
+            static Result<RemoteCache> connect(const RemoteCacheOptions& options);
+
+            /// Returns nothing on a miss or if any file of the entry is missing.
+            Result<std::optional<EntryFiles>> fetch(const std::string& key);
+
+            /// Uploads the files first, so a published entry is always complete.
+            Result<void> upload(const std::string& key, const EntryFiles& files);
+
+            bool read_only() const { return options_.read_only; }
+
+        private:
+            RemoteCache(Url url, RemoteCacheOptions options);
+
+            Url url_;
+            RemoteCacheOptions options_;
+
+            /// Reused for the requests made from the calling thread
+            std::unique_ptr<HttpClient> client_;
+        };
+    } // namespace cache
+} // namespace muuk
+
+#endif // CACHE_REMOTE_CACHE_H
@@ -8,12 +8,69 @@
 #include "rustify.hpp"
 
 namespace muuk {
+    struct BuildOptions {
+        std::string target_build;
+        std::string compiler;
+        std::string profile;
+        std::string jobs;
+
+        /// Derive a precompiled header per package from the previous build's
+        /// header dependencies (`--auto-pch`).
+        bool auto_pch = false;
+
+        /// Route compile edges through `muuk cc-wrap` (`--cache`).
+        bool compile_cache = false;
+
+        /// HTTP cache shared through `muuk cc-wrap` (`--remote-cache`).
+        /// Implies `compile_cache`.
+        std::string remote_cache;
+
+        /// Link dependency archives prebuilt by any project on this machine
+        /// (`--artifact-cache`).
+        bool artifact_cache = false;
+
+        /// Comma separated `muuk worker` URLs compile edges are sent to
+        /// through `muuk cc-wrap` (`--workers`).
+        std::string workers;
+
+        /// Ship headers once per worker instead of preprocessed sources
+        /// (`--pump`).
+        bool pump = false;
+
+        /// `ninja`, or `native` to run the graph in-process (`--executor`).
+        std::string executor = "ninja";
+
+        /// Report where the build's time went (`--timings`).
+        bool timings = false;
+
+        /// Run compiles and links through `muuk exec`, recording their CPU
+        /// time and peak memory (`--stats`).
+        bool stats = false;
+
+        /// Aggregate the compiler's per translation unit time traces
+        /// (`--compile-profile`).
+        bool compile_profile = false;
+
+        /// Build the instrumented variant of the profile into
+        /// `build/<profile>-pgo-gen` (set by `muuk pgo`).
+        bool pgo_instrument = false;
+
+        /// Regenerate the lock file before building. `--watch` turns it off
+        /// when no manifest changed and no source was added or removed.
+        bool refresh_lock = true;
+    };
+
     Result<void> build_cmd(
-        const std::string& target_build,
-        const std::string& compiler,
-        const std::string& profile,
-        const toml::value& config,
-        const std::string& jobs);
+        const BuildOptions& options,
+        const toml::value& config);
+
+    /// Builds, then rebuilds whenever a manifest, source or recorded header
+    /// changes (`muuk build --watch`). `script`, from `[scripts]`, runs
+    /// after each successful build.
+    Result<void> watch_cmd(
+        const BuildOptions& options,
+        const std::string& script,
+        const toml::value& config);
 }
 
 #endif // MUUK_BUILDER_H
@@ -0,0 +1,28 @@
+#pragma once
+#ifndef CACHE_SERVER_HPP
+#define CACHE_SERVER_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "rustify.hpp"
+
+namespace muuk {
+    struct CacheServerOptions {
+        /// Directory the blobs are stored in
+        std::string dir;
+
+        std::string bind = "127.0.0.1";
+        uint16_t port = 8080;
+        size_t threads = 8;
+
+        /// Size limit of the stored blobs, in bytes
+        std::uintmax_t max_size = 0;
+    };
+
+    /// Serves a directory as a remote compilation cache (`muuk cache-server`),
+    /// speaking the `/cas` and `/ac` protocol of `cache::RemoteCache`.
+    Result<void> cache_server(const CacheServerOptions& options);
+}
+
+#endif // CACHE_SERVER_HPP
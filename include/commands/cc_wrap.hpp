@@ -0,0 +1,17 @@
+#pragma once
+#ifndef CC_WRAP_HPP
+#define CC_WRAP_HPP
+
+#include <string>
+#include <vector>
+
+#include "rustify.hpp"
+
+namespace muuk {
+    /// Runs a compiler command through the local compilation cache, and
+    /// compiles misses on a `muuk worker` when `$MUUK_WORKERS` is set.
+    /// Returns the exit code of the (possibly skipped) compiler.
+    Result<int> cc_wrap(const std::vector<std::string>& command);
+}
+
+#endif // CC_WRAP_HPP
@@ -0,0 +1,26 @@
+#pragma once
+#ifndef HEADERS_HPP
+#define HEADERS_HPP
+
+#include <string>
+
+#include <toml.hpp>
+
+#include "rustify.hpp"
+
+namespace muuk {
+    struct HeadersOptions {
+        std::string compiler;
+        std::string profile;
+
+        /// Rows printed per section
+        size_t top = 20;
+    };
+
+    /// Ranks headers by their cost to the build, from the header dependencies
+    /// of the last build (`muuk headers`). The full data is written to
+    /// `build/<profile>/headers.json`.
+    Result<void> headers_cmd(const HeadersOptions& options, const toml::value& config);
+}
+
+#endif // HEADERS_HPP
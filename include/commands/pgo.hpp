@@ -0,0 +1,18 @@
+#pragma once
+#ifndef PGO_HPP
+#define PGO_HPP
+
+#include <toml.hpp>
+
+#include "commands/build.hpp"
+#include "rustify.hpp"
+
+namespace muuk {
+    /// Builds an instrumented variant of the profile, runs the `train`
+    /// commands of `[pgo]`, merges their profiles into `pgo/` and rebuilds
+    /// the profile with them (`muuk pgo`). Later builds of the profile keep
+    /// using the merged profile.
+    Result<void> pgo_cmd(const BuildOptions& options, const toml::value& config);
+}
+
+#endif // PGO_HPP
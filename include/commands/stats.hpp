@@ -0,0 +1,25 @@
+#pragma once
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <string>
+
+#include <toml.hpp>
+
+#include "rustify.hpp"
+
+namespace muuk {
+    struct StatsOptions {
+        std::string profile;
+
+        /// Rows printed per section
+        size_t top = 20;
+    };
+
+    /// Ranks the compiles and links of the profile by CPU time and peak
+    /// memory, from the records `muuk build --stats` left in
+    /// `build/<profile>/.muuk_stats` (`muuk stats`).
+    Result<void> stats_cmd(const StatsOptions& options, const toml::value& config);
+}
+
+#endif // STATS_HPP
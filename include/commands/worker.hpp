@@ -0,0 +1,29 @@
+#pragma once
+#ifndef WORKER_HPP
+#define WORKER_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "rustify.hpp"
+
+namespace muuk {
+    struct WorkerOptions {
+        /// Directory for shipped headers and in-flight jobs
+        std::string dir;
+
+        std::string bind = "127.0.0.1";
+        uint16_t port = 3633;
+
+        /// Concurrent compiles, 0 for one per hardware thread
+        size_t threads = 0;
+
+        /// Size limit of the shipped headers, in bytes
+        std::uintmax_t max_size = 0;
+    };
+
+    /// Compiles translation units sent by `muuk cc-wrap` (`muuk worker`).
+    Result<void> worker(const WorkerOptions& options);
+}
+
+#endif // WORKER_HPP
@@ -0,0 +1,50 @@
+#pragma once
+#ifndef DIST_CLIENT_H
+#define DIST_CLIENT_H
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "cache/compiler_cache.hpp"
+#include "rustify.hpp"
+#include "util.hpp"
+
+namespace muuk {
+    namespace dist {
+        struct DistOptions {
+            /// `http://host:port` of each `muuk worker`
+            std::vector<std::string> workers;
+
+            /// Ship the project's headers once per worker instead of a
+            /// preprocessed translation unit per compile.
+            bool pump = false;
+
+            /// Headers under this directory are shipped in pump mode. The
+            /// others (system and toolchain headers) must exist on the worker.
+            std::string project_root;
+
+            /// Bound on each network operation, the remote compile included
+            std::chrono::milliseconds timeout { 300000 };
+        };
+
+        /// `$MUUK_WORKERS` (comma separated URLs), `$MUUK_WORKERS_PUMP`,
+        /// `$MUUK_PROJECT_ROOT` and `$MUUK_WORKERS_TIMEOUT` (ms). Returns
+        /// nothing if no worker is configured.
+        std::optional<DistOptions> dist_options_from_env();
+
+        /// Compiles `invocation` on one of the workers, picked by output so
+        /// the same object keeps going to the same worker. Writes the object
+        /// and the depfile locally.
+        ///
+        /// Returns an error if no worker could take the job, in which case
+        /// the caller compiles locally. A compile that ran but failed is not
+        /// an error; its exit code and diagnostics are returned.
+        Result<util::process::Output> compile_remote(
+            const DistOptions& options,
+            const cache::CompilerInvocation& invocation);
+    } // namespace dist
+} // namespace muuk
+
+#endif // DIST_CLIENT_H
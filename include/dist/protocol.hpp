@@ -0,0 +1,38 @@
+#pragma once
+#ifndef DIST_PROTOCOL_H
+#define DIST_PROTOCOL_H
+
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rustify.hpp"
+
+namespace muuk {
+    namespace dist {
+        /// Bumped whenever the messages change.
+        constexpr const char* PROTOCOL_VERSION = "muuk-dist-1";
+
+        /// The named values of a message. A name may repeat (e.g. `arg`).
+        using Fields = std::vector<std::pair<std::string, std::string>>;
+
+        /// Serializes each field as `<name>\t<size>\n<bytes>`, so values may
+        /// hold binary data such as object files.
+        std::string encode_fields(const Fields& fields);
+
+        Result<Fields> decode_fields(const std::string& message);
+
+        /// The first value of `name`.
+        std::optional<std::string> find_field(const Fields& fields, const std::string& name);
+
+        /// Every value of `name`, in order.
+        std::vector<std::string> find_fields(const Fields& fields, const std::string& name);
+
+        /// Workers only run compilers named like `g++`, `clang++-17` or `cc`,
+        /// looked up on their own `PATH`.
+        bool is_allowed_compiler(const std::string& compiler);
+    } // namespace dist
+} // namespace muuk
+
+#endif // DIST_PROTOCOL_H
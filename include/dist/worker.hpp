@@ -0,0 +1,64 @@
+#pragma once
+#ifndef DIST_WORKER_H
+#define DIST_WORKER_H
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "cache/http.hpp"
+#include "cache/local_cache.hpp"
+#include "commands/worker.hpp"
+#include "rustify.hpp"
+
+namespace muuk {
+    namespace dist {
+        /// Compiles jobs sent by `dist::compile_remote` over HTTP:
+        ///
+        /// - `POST /compile`: a job (see `dist/protocol.hpp`), answered with
+        ///   its exit code, output and object
+        /// - `POST /missing`: which of the listed file hashes aren't stored yet
+        /// - `PUT /files/<sha256>`: stores a project file for pump mode jobs
+        ///
+        /// Jobs are refused with `409` if the worker's compiler reports a
+        /// different version than the client's, or lacks a system header.
+        class Worker {
+        public:
+            explicit Worker(WorkerOptions options);
+
+            /// Binds the listening socket. Port 0 picks a free port.
+            Result<void> listen();
+
+            uint16_t port() const { return server_.port(); }
+
+            /// Serves jobs until `stop()` is called.
+            void serve();
+
+            void stop();
+
+            cache::HttpResponse handle(const cache::HttpRequest& request);
+
+        private:
+            cache::HttpResponse compile(const std::string& body, const std::filesystem::path& job_dir);
+
+            /// `compiler_identity` of a local compiler, computed once.
+            std::string identity(const std::string& compiler);
+
+            WorkerOptions options_;
+            std::filesystem::path root_;
+            cache::LocalCache files_;
+
+            std::mutex identities_mutex_;
+            std::map<std::string, std::string> identities_;
+
+            std::atomic<uint64_t> next_job_ = 0;
+
+            cache::HttpServer server_;
+        };
+    } // namespace dist
+} // namespace muuk
+
+#endif // DIST_WORKER_H
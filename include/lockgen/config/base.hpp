@@ -1,5 +1,7 @@
 #pragma once
 
+#include <map>
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -82,6 +84,9 @@ namespace muuk {
             std::string path;
             std::unordered_set<std::string> cflags;
 
+            /// Resource pool of its compile edge (`pool`), defaults to the package's
+            std::string pool;
+
             toml::value serialize() const;
 
             // source_file(std::string p, const std::vector<std::string>& f) :
@@ -274,7 +279,14 @@ namespace muuk {
             // CXX_Standard cxx_standard;
             // C_Standard c_standard;
             OptimizationLevel optimization_level;
-            bool lto = false;
+
+            /// Empty when off, otherwise `fat` (`lto = true`) or `thin`
+            std::string lto;
+            /// GCC `-flto-partition` (`lto-partition`)
+            std::string lto_partition;
+            /// Concurrent LTO links (`lto-jobs`)
+            std::optional<int64_t> lto_jobs;
+
             bool debug = false;
             bool rpath = false;
             bool debug_assertions = false; // -DNDEBUG
@@ -296,12 +308,48 @@ namespace muuk {
 
         void serialize(const Sanitizers& sanitizers, toml::value& out);
 
+        /// Unity (jumbo) build settings. Unset values fall back to the profile.
+        struct Unity {
+            std::optional<bool> enabled; // `unity`
+            std::optional<int64_t> batch; // `unity_batch`
+        };
+
+        void load(Unity& unity, const toml::value& v);
+
+        void serialize(const Unity& unity, toml::value& out);
+
+        /// Debug info layout, used when `debug` is on. Empty values keep the
+        /// compiler's defaults.
+        struct DebugInfo {
+            std::string split; // `split-debuginfo`
+            std::string compress; // `compress-debug`
+            std::string dependencies; // `dependency-debug`
+        };
+
+        void load(DebugInfo& debug_info, const toml::value& v);
+
+        void serialize(const DebugInfo& debug_info, toml::value& out);
+
         struct ProfileConfig : BaseConfig<ProfileConfig> {
             std::string name;
             std::vector<std::string> inherits;
 
             Settings settings;
             Sanitizers sanitizers;
+            Unity unity;
+            DebugInfo debug_info;
+
+            /// `mold`, `lld`, `gold` or `auto` (`linker`)
+            std::string linker;
+
+            /// Post-link code layout, `bolt` or `symbol-order` (`layout`)
+            std::string layout;
+
+            /// `full`, `thin` or `none` (`archives`)
+            std::string archives;
+
+            /// Resource pool depths, e.g. `link_pool = 2` (`pools`)
+            std::map<std::string, int64_t> pools;
 
             void load(
                 const toml::value& v,
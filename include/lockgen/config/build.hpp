@@ -17,6 +17,11 @@ namespace muuk {
             std::unordered_set<std::string> profiles;
             std::unordered_set<std::shared_ptr<Dependency>> all_dependencies_array;
 
+            /// Header precompiled for the build's sources.
+            std::string pch;
+
+            Unity unity;
+
             static constexpr bool enable_compilers = false;
             static constexpr bool enable_platforms = false;
 
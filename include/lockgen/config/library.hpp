@@ -2,6 +2,7 @@
 
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 #include <toml.hpp>
 
@@ -15,6 +16,17 @@ namespace muuk {
             std::string version;
             std::unordered_set<std::string> profiles;
 
+            /// Header precompiled for the library's sources.
+            std::string pch;
+
+            Unity unity;
+
+            /// Compiled once per level, dispatched between at load time (`isa_levels`)
+            std::vector<std::string> isa_levels;
+
+            /// ISPC kernels (`ispc`)
+            std::vector<source_file> ispc;
+
             muuk::LinkType link_type = muuk::LinkType::STATIC;
 
             static constexpr bool enable_compilers = false;
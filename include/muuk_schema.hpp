@@ -96,6 +96,7 @@ namespace muuk {
                     TomlTable({
                         {"path", { true, TomlType::String } },
                         {"cflags", { false, TomlArray { TomlType::String } } },
+                        {"pool", { false, TomlType::String } },
                     })
                 }}}},
             { "libs", { false, TomlArray {
@@ -111,7 +112,13 @@ namespace muuk {
             { "cflags", { false, TomlArray { TomlType::String } } },
             { "libflags", { false, TomlArray { TomlType::String } } },
             { "lflags", { false, TomlArray { TomlType::String } } },
-            { "system_include", { false, TomlArray { TomlType::String } } }
+            { "system_include", { false, TomlArray { TomlType::String } } },
+            { "pch", { false, TomlType::String } },
+            { "unity", { false, TomlType::Boolean } },
+            { "unity_batch", { false, TomlType::Integer } },
+            { "pool", { false, TomlType::String } },
+            { "isa_levels", { false, TomlArray { TomlType::String } } },
+            { "ispc", { false, TomlArray { TomlType::String } } }
         };
 
         const SchemaMap build_schema = {
@@ -120,6 +127,10 @@ namespace muuk {
                 { "cflags", { false, TomlArray{TomlType::String} } },
                 { "system_include", { false, TomlArray{TomlType::String} } },
                 { "link", { false, TomlType::String } },
+                { "pch", { false, TomlType::String } },
+                { "unity", { false, TomlType::Boolean } },
+                { "unity_batch", { false, TomlType::Integer } },
+                { "pool", { false, TomlType::String } },
                 { "dependencies", { false, TomlTable({}) } }
             })}}
         }; 
@@ -161,7 +172,21 @@ namespace muuk {
                     {"default", {false, TomlType::Boolean}},
                     {"inherits", {false, TomlArray{TomlType::String}}},
                     {"include", {false, TomlArray{TomlType::String}}},
-                    {"cflags", {false, TomlArray{TomlType::String}}}
+                    {"cflags", {false, TomlArray{TomlType::String}}},
+                    {"unity", {false, TomlType::Boolean}},
+                    {"unity_batch", {false, TomlType::Integer}},
+                    {"linker", {false, TomlType::String}},
+                    {"layout", {false, TomlType::String}},
+                    {"archives", {false, TomlType::String}},
+                    {"pools", {false, TomlTable({
+                        {"*", {false, TomlType::Integer}}
+                    })}},
+                    {"lto", {false, TomlUnionTypes{TomlType::Boolean, TomlType::String}}},
+                    {"lto-partition", {false, TomlType::String}},
+                    {"lto-jobs", {false, TomlType::Integer}},
+                    {"split-debuginfo", {false, TomlType::String}},
+                    {"compress-debug", {false, TomlType::String}},
+                    {"dependency-debug", {false, TomlType::String}}
                 })}}
             })}},
         
@@ -192,6 +217,11 @@ namespace muuk {
                         {"defines", {false, TomlArray{TomlType::String}}}
                     })}
                 }}}
+            })}},
+
+            {"pgo", {false, TomlTable({
+                {"profile", {false, TomlType::String}},
+                {"train", {false, TomlArray{TomlType::String}}}
             })}}
         };
 
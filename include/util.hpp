@@ -29,6 +29,10 @@ namespace util {
         std::string sanitize_path(const std::string& input);
 
         std::string escape_drive_letter(const std::string& path);
+
+        /// Writes `contents` to `path` unless the file already holds exactly that,
+        /// so generated sources don't trigger rebuilds when nothing changed.
+        void write_if_changed(const std::string& path, const std::string& contents);
     }
 
     // ==========================
@@ -58,6 +62,47 @@ namespace util {
         Result<void> download_file(const std::string& url, const std::string& output_file);
     }
 
+    // ==========================
+    //  Process Utilities
+    // ==========================
+    namespace process {
+        struct Output {
+            int exit_code = -1;
+            std::string out;
+            std::string err;
+
+            /// Peak resident set size of the command in KiB (0 if unknown)
+            long max_rss_kb = 0;
+
+            /// CPU time in user and kernel mode, in milliseconds, and blocks
+            /// read and written by the file system (0 if unknown)
+            long user_ms = 0;
+            long sys_ms = 0;
+            long in_blocks = 0;
+            long out_blocks = 0;
+        };
+
+        /// Quotes an argument for the platform shell.
+        std::string quote(const std::string& arg);
+
+        /// Replaces each `@file` argument with the arguments in the response
+        /// file, read the way GCC and Clang read them.
+        std::vector<std::string> expand_response_files(const std::vector<std::string>& args);
+
+        /// Runs `args` and captures stdout and stderr. Unlike `command_line`,
+        /// nothing is logged, so it is safe to call from build edges.
+        Result<Output> run(const std::vector<std::string>& args, const std::string& cwd = "");
+
+        /// Runs a command line through the platform shell (`/bin/sh -c`, `cmd /c`).
+        Result<Output> run_shell(const std::string& command, const std::string& cwd = "");
+
+        /// Absolute path of the running muuk executable.
+        std::string current_executable();
+
+        /// Sets an environment variable inherited by the commands muuk starts.
+        void set_env(const std::string& name, const std::string& value);
+    }
+
     std::string trim_whitespace(const std::string& str);
 
     // ==========================
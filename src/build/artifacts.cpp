@@ -0,0 +1,70 @@
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "build/artifacts.hpp"
+#include "build/manager.hpp"
+#include "cache/local_cache.hpp"
+#include "logger.hpp"
+
+namespace fs = std::filesystem;
+
+namespace muuk {
+    namespace build {
+        /// Records which cache entry an archive was restored from or stored as.
+        static fs::path key_file(const fs::path& archive) {
+            return archive.string() + ".key";
+        }
+
+        static std::string read_key(const fs::path& archive) {
+            std::ifstream in(key_file(archive));
+            std::string key;
+            std::getline(in, key);
+            return key;
+        }
+
+        static void write_key(const fs::path& archive, const std::string& key) {
+            std::ofstream out(key_file(archive), std::ios::trunc);
+            out << key << "\n";
+        }
+
+        fs::path artifact_cache_dir() {
+            return cache::default_cache_dir() / "artifacts";
+        }
+
+        bool restore_prebuilt_library(const std::string& key, const fs::path& archive) {
+            cache::LocalCache artifacts(artifact_cache_dir());
+            if (!artifacts.contains(key, "lib"))
+                return false;
+
+            std::error_code ec;
+            if (fs::exists(archive, ec) && read_key(archive) == key)
+                return true;
+
+            fs::create_directories(archive.parent_path(), ec);
+            if (!artifacts.fetch(key, "lib", archive))
+                return false;
+
+            write_key(archive, key);
+            return true;
+        }
+
+        void store_prebuilt_libraries(const BuildManager& build_manager) {
+            cache::LocalCache artifacts(artifact_cache_dir());
+
+            for (const auto& [package_id, library] : build_manager.get_prebuilt_libraries()) {
+                if (library.restored || !fs::exists(library.archive))
+                    continue;
+
+                if (auto stored = artifacts.store(library.key, "lib", library.archive); !stored) {
+                    muuk::logger::warn("Failed to cache '{}': {}", package_id, stored.error().message);
+                    continue;
+                }
+
+                write_key(library.archive, library.key);
+                artifacts.evict(library.key);
+                muuk::logger::info("Cached prebuilt archive for '{}'", package_id);
+            }
+        }
+    } // namespace build
+} // namespace muuk
@@ -0,0 +1,275 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "build/auto_pch.hpp"
+#include "buildconfig.h"
+#include "logger.hpp"
+#include "util.hpp"
+
+namespace fs = std::filesystem;
+
+namespace muuk {
+    namespace build {
+        namespace pch {
+            std::vector<IncludeDirective> scan_includes(const std::string& source) {
+                std::vector<IncludeDirective> includes;
+                std::istringstream stream(source);
+                std::string line;
+
+                while (std::getline(stream, line)) {
+                    size_t i = line.find_first_not_of(" \t");
+                    if (i == std::string::npos || line[i] != '#')
+                        continue;
+
+                    i = line.find_first_not_of(" \t", i + 1);
+                    if (i == std::string::npos || line.compare(i, 7, "include") != 0)
+                        continue;
+
+                    i = line.find_first_not_of(" \t", i + 7);
+                    if (i == std::string::npos || (line[i] != '<' && line[i] != '"'))
+                        continue;
+
+                    const bool angled = line[i] == '<';
+                    const auto end = line.find(angled ? '>' : '"', i + 1);
+                    if (end == std::string::npos || end == i + 1)
+                        continue;
+
+                    includes.push_back({ line.substr(i + 1, end - i - 1), angled });
+                }
+
+                return includes;
+            }
+
+            /// Headers outside of the project (toolchain, system) and vendored
+            /// dependencies rarely change, so they are safe to precompile.
+            bool is_stable_header(const fs::path& header, const fs::path& project_root) {
+                const auto relative = header.lexically_relative(project_root);
+                if (relative.empty() || *relative.begin() == "..")
+                    return true;
+                return *relative.begin() == DEPENDENCY_FOLDER;
+            }
+
+            static std::string read_file(const fs::path& path) {
+                std::ifstream in(path);
+                std::stringstream buffer;
+                buffer << in.rdbuf();
+                return buffer.str();
+            }
+
+            const std::string* resolve_include(const IncludeDirective& directive, const std::vector<std::string>& headers) {
+                const auto spelling = fs::path(directive.spelling).lexically_normal().generic_string();
+                if (spelling.starts_with(".."))
+                    return nullptr;
+
+                const std::string suffix = "/" + spelling;
+                for (const auto& header : headers)
+                    if (header.ends_with(suffix))
+                        return &header;
+
+                return nullptr;
+            }
+
+            std::vector<Candidate> rank_candidates(const std::vector<TranslationUnit>& tus, const AutoPchOptions& options) {
+                if (tus.empty())
+                    return {};
+
+                const auto project_root = fs::current_path();
+
+                // Header -> indices of the TUs that include it (directly or not)
+                std::unordered_map<std::string, std::vector<size_t>> users;
+                std::unordered_map<std::string, Candidate> direct;
+
+                for (size_t i = 0; i < tus.size(); ++i) {
+                    const auto& tu = tus[i];
+
+                    for (const auto& header : tu.headers) {
+                        auto& tu_list = users[header];
+                        if (tu_list.empty() || tu_list.back() != i)
+                            tu_list.push_back(i);
+                    }
+
+                    for (const auto& directive : scan_includes(read_file(tu.source))) {
+                        const auto* resolved = resolve_include(directive, tu.headers);
+                        if (!resolved || direct.contains(*resolved))
+                            continue;
+
+                        if (!is_stable_header(*resolved, project_root))
+                            continue;
+
+                        Candidate candidate;
+                        candidate.path = *resolved;
+                        candidate.include = directive.angled
+                            ? "<" + directive.spelling + ">"
+                            : "\"" + *resolved + "\"";
+                        candidate.order = direct.size();
+                        direct.emplace(*resolved, std::move(candidate));
+                    }
+                }
+
+                const auto total = static_cast<double>(tus.size());
+
+                auto file_size = [](const std::string& path) -> std::uintmax_t {
+                    std::error_code ec;
+                    const auto size = fs::file_size(path, ec);
+                    return ec ? 0 : size;
+                };
+
+                // Only headers shared by enough TUs contribute to a candidate's cost
+                std::vector<std::pair<const std::string*, const std::vector<size_t>*>> common;
+                for (const auto& [header, tu_list] : users)
+                    if (tu_list.size() / total >= options.min_fraction)
+                        common.emplace_back(&header, &tu_list);
+
+                std::vector<Candidate> ranked;
+                for (auto& [path, candidate] : direct) {
+                    const auto& tu_list = users[path];
+                    candidate.tu_count = tu_list.size();
+                    candidate.fraction = tu_list.size() / total;
+
+                    if (candidate.fraction < options.min_fraction)
+                        continue;
+
+                    // A header only ever seen in TUs that include the candidate
+                    // is most likely pulled in by it.
+                    candidate.cost = file_size(path);
+                    for (const auto& [header, header_users] : common) {
+                        if (*header == path)
+                            continue;
+                        if (std::includes(tu_list.begin(), tu_list.end(), header_users->begin(), header_users->end()))
+                            candidate.cost += file_size(*header);
+                    }
+
+                    candidate.score = candidate.fraction * static_cast<double>(candidate.cost);
+                    ranked.push_back(candidate);
+                }
+
+                std::sort(ranked.begin(), ranked.end(), [](const Candidate& a, const Candidate& b) {
+                    if (a.score != b.score)
+                        return a.score > b.score;
+                    return a.path < b.path;
+                });
+
+                return ranked;
+            }
+
+            static std::vector<std::string> load_previous_selection(const fs::path& state_path) {
+                if (!fs::exists(state_path))
+                    return {};
+
+                try {
+                    const auto state = nlohmann::json::parse(read_file(state_path));
+                    return state.value("headers", std::vector<std::string> {});
+                } catch (const std::exception& e) {
+                    muuk::logger::warn("Ignoring unreadable auto PCH state '{}': {}", state_path.string(), e.what());
+                    return {};
+                }
+            }
+
+            /// Jaccard distance between two header selections.
+            static double selection_shift(const std::vector<std::string>& previous, const std::vector<std::string>& current) {
+                const std::set<std::string> a(previous.begin(), previous.end());
+                const std::set<std::string> b(current.begin(), current.end());
+
+                size_t shared = 0;
+                for (const auto& header : a)
+                    shared += b.count(header);
+
+                const size_t combined = a.size() + b.size() - shared;
+                return combined == 0 ? 0.0 : 1.0 - static_cast<double>(shared) / combined;
+            }
+
+            std::string update_auto_pch(const fs::path& package_dir, const std::vector<TranslationUnit>& tus, const AutoPchOptions& options) {
+                const auto header_path = package_dir / AUTO_PCH_HEADER;
+                const auto state_path = package_dir / AUTO_PCH_STATE;
+
+                // No statistics yet (e.g. a clean build): keep whatever we had.
+                if (tus.empty())
+                    return fs::exists(header_path) ? header_path.generic_string() : "";
+
+                if (tus.size() < options.min_translation_units)
+                    return "";
+
+                auto ranked = rank_candidates(tus, options);
+                if (ranked.size() > options.max_headers)
+                    ranked.resize(options.max_headers);
+
+                std::sort(ranked.begin(), ranked.end(), [](const Candidate& a, const Candidate& b) {
+                    return a.order < b.order;
+                });
+
+                std::vector<std::string> selected;
+                for (const auto& candidate : ranked)
+                    selected.push_back(candidate.include);
+
+                const auto previous = load_previous_selection(state_path);
+                const double shift = selection_shift(previous, selected);
+
+                if (!previous.empty() && fs::exists(header_path) && shift <= options.recompute_threshold) {
+                    muuk::logger::info(
+                        "Auto PCH for '{}' is up to date ({:.0f}% drift).",
+                        package_dir.generic_string(),
+                        shift * 100);
+                    return header_path.generic_string();
+                }
+
+                if (selected.empty()) {
+                    fs::remove(header_path);
+                    fs::remove(state_path);
+                    return "";
+                }
+
+                fs::create_directories(package_dir);
+
+                std::ostringstream header;
+                header << "// Generated by `muuk build --auto-pch`. Do not edit.\n"
+                       << "// Headers included by at least " << static_cast<int>(options.min_fraction * 100)
+                       << "% of this package's translation units.\n\n";
+                for (const auto& include : selected)
+                    header << "#include " << include << "\n";
+
+                // An unchanged header set must not invalidate the PCH
+                util::file_system::write_if_changed(header_path.string(), header.str());
+
+                nlohmann::json state;
+                state["headers"] = selected;
+                state["translation_units"] = tus.size();
+                state["candidates"] = nlohmann::json::array();
+                for (const auto& candidate : ranked)
+                    state["candidates"].push_back({
+                        { "include", candidate.include },
+                        { "fraction", candidate.fraction },
+                        { "cost", candidate.cost },
+                    });
+
+                util::file_system::write_if_changed(state_path.string(), state.dump(4));
+
+                muuk::logger::info(
+                    "Regenerated auto PCH '{}' with {} headers.",
+                    header_path.generic_string(),
+                    selected.size());
+
+                return header_path.generic_string();
+            }
+
+            std::string write_pch_wrapper(const fs::path& package_dir, const fs::path& header) {
+                fs::create_directories(package_dir);
+
+                const auto wrapper = package_dir / "pch.hpp";
+                util::file_system::write_if_changed(
+                    wrapper.string(),
+                    "// Generated by muuk. Do not edit.\n#include \""
+                        + fs::absolute(header).lexically_normal().generic_string() + "\"\n");
+
+                return wrapper.generic_string();
+            }
+        } // namespace pch
+    } // namespace build
+} // namespace muuk
@@ -54,6 +54,10 @@ namespace muuk {
             json compile_commands = json::array();
 
             for (const auto& target : build_manager.get_compilation_targets()) {
+                // Not C or C++, clangd can't use them
+                if (target.compilation_unit_type == CompilationUnitType::Ispc)
+                    continue;
+
                 json entry;
                 entry["directory"] = fs::absolute(build_dir_).string();
                 entry["file"] = target.inputs[0];
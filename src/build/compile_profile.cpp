@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+
+#include "build/compile_profile.hpp"
+#include "build/executor.hpp"
+#include "compiler.hpp"
+#include "logger.hpp"
+#include "rustify.hpp"
+#include "util.hpp"
+
+namespace fs = std::filesystem;
+
+namespace muuk {
+    namespace build {
+        std::string compile_profile_flags(const Compiler& compiler) {
+            if (compiler == Compiler::Clang)
+                return "-ftime-trace";
+            if (compiler == Compiler::GCC)
+                return "-ftime-report";
+            return "";
+        }
+
+        static void add_cost(std::unordered_map<std::string, ProfileCost>& costs, const std::string& name, int64_t us) {
+            auto& cost = costs[name];
+            cost.name = name;
+            cost.total_us += us;
+            ++cost.count;
+        }
+
+        /// `ns::vector<int>` and `ns::vector<char>` are both `ns::vector<$>`.
+        static std::string template_name(const std::string& instantiation) {
+            const auto open = instantiation.find('<');
+            return open == std::string::npos ? instantiation : instantiation.substr(0, open) + "<$>";
+        }
+
+        Result<void> add_time_trace(CompileProfile& profile, const std::string& unit, const std::string& trace) {
+            const auto json = nlohmann::json::parse(trace, nullptr, false);
+            if (json.is_discarded() || !json.contains("traceEvents") || !json["traceEvents"].is_array())
+                return Err("'{}' is not a -ftime-trace file.", unit);
+
+            ++profile.translation_units;
+
+            for (const auto& event : json["traceEvents"]) {
+                if (event.value("ph", "") != "X" || !event.contains("dur"))
+                    continue;
+
+                const auto name = event.value("name", "");
+                const auto us = event["dur"].get<int64_t>();
+                const auto detail = event.contains("args") ? event["args"].value("detail", "") : "";
+
+                if (name == "ExecuteCompiler")
+                    add_cost(profile.units, unit, us);
+                else if (name == "Frontend")
+                    profile.frontend_us += us;
+                else if (name == "Backend")
+                    profile.backend_us += us;
+                else if (name == "Source" && !detail.empty())
+                    add_cost(profile.headers, detail, us);
+                else if ((name == "InstantiateClass" || name == "InstantiateFunction") && !detail.empty()) {
+                    add_cost(profile.instantiations, detail, us);
+                    add_cost(profile.templates, template_name(detail), us);
+                } else if ((name == "CodeGen Function" || name == "OptFunction") && !detail.empty())
+                    add_cost(profile.functions, detail, us);
+            }
+
+            return {};
+        }
+
+        static void format_section(
+            std::ostringstream& out,
+            const std::string& title,
+            const std::unordered_map<std::string, ProfileCost>& costs,
+            size_t top) {
+            std::vector<const ProfileCost*> sorted;
+            for (const auto& [_, cost] : costs)
+                sorted.push_back(&cost);
+            std::sort(sorted.begin(), sorted.end(), [](const ProfileCost* a, const ProfileCost* b) {
+                return a->total_us != b->total_us ? a->total_us > b->total_us : a->name < b->name;
+            });
+            sorted.resize(std::min(sorted.size(), top));
+
+            out << "\n" << title << ":\n";
+            for (const auto* cost : sorted)
+                out << fmt::format(
+                    "  {:>8} ms  {:>5}x  {:>6} ms avg  {}\n",
+                    cost->total_us / 1000,
+                    cost->count,
+                    cost->total_us / 1000 / static_cast<int64_t>(cost->count),
+                    cost->name);
+        }
+
+        std::string format_compile_profile(const CompileProfile& profile, size_t top) {
+            std::ostringstream out;
+            out << fmt::format(
+                "{} translation units: {} ms in the frontend, {} ms in the backend\n",
+                profile.translation_units,
+                profile.frontend_us / 1000,
+                profile.backend_us / 1000);
+
+            format_section(out, "Slowest translation units", profile.units, top);
+            format_section(out, "Most expensive headers (including their own includes)", profile.headers, top);
+            format_section(out, "Most expensive template instantiations", profile.instantiations, top);
+            format_section(out, "Most expensive templates (all instantiations)", profile.templates, top);
+            format_section(out, "Most expensive function code generation", profile.functions, top);
+            return out.str();
+        }
+
+        Result<std::string> write_compile_profile(const BuildGraph& graph, const fs::path& build_dir) {
+            CompileProfile profile;
+
+            for (const auto& edge : graph.edges) {
+                if (edge.rule != "compile" || edge.outputs.empty())
+                    continue;
+
+                // Clang writes the trace next to the object: `x.o` -> `x.json`
+                const auto trace_path = build_dir / fs::path(edge.outputs[0]).replace_extension(".json");
+                std::ifstream in(trace_path);
+                if (!in)
+                    continue;
+
+                std::stringstream trace;
+                trace << in.rdbuf();
+                if (auto added = add_time_trace(profile, edge.outputs[0], trace.str()); !added)
+                    muuk::logger::warn(added.error().message);
+            }
+
+            if (profile.translation_units == 0)
+                return Err("No -ftime-trace files found in '{}'. Only Clang writes them.", build_dir.generic_string());
+
+            const auto report = format_compile_profile(profile, 15);
+            util::file_system::write_if_changed((build_dir / "compile_profile.txt").string(), report);
+            return report;
+        }
+    } // namespace build
+} // namespace muuk
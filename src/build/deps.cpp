@@ -0,0 +1,257 @@
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "build/deps.hpp"
+#include "build/executor.hpp"
+#include "build/manager.hpp"
+#include "logger.hpp"
+#include "util.hpp"
+
+namespace fs = std::filesystem;
+
+namespace muuk {
+    namespace build {
+        /// Splits a depfile into whitespace separated tokens, honoring the
+        /// escapes GCC, Clang and Ninja emit (`\ `, `\#`, `$$` and `\` + newline).
+        static std::vector<std::string> tokenize_depfile(const std::string& contents) {
+            std::vector<std::string> tokens;
+            std::string current;
+
+            auto flush = [&]() {
+                if (!current.empty()) {
+                    tokens.push_back(current);
+                    current.clear();
+                }
+            };
+
+            for (size_t i = 0; i < contents.size(); ++i) {
+                const char c = contents[i];
+                const char next = i + 1 < contents.size() ? contents[i + 1] : '\0';
+
+                if (c == '\\' && (next == '\n' || next == '\r')) {
+                    // Line continuation
+                    flush();
+                    ++i;
+                    if (next == '\r' && i + 1 < contents.size() && contents[i + 1] == '\n')
+                        ++i;
+                } else if (c == '\\' && (next == ' ' || next == '#')) {
+                    current += next;
+                    ++i;
+                } else if (c == '$' && next == '$') {
+                    current += '$';
+                    ++i;
+                } else if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+                    flush();
+                } else {
+                    current += c;
+                }
+            }
+            flush();
+
+            return tokens;
+        }
+
+        std::vector<std::string> parse_depfile(const std::string& contents) {
+            std::vector<std::string> deps;
+            bool in_prerequisites = false;
+
+            for (const auto& token : tokenize_depfile(contents)) {
+                const bool ends_rule = token.back() == ':';
+
+                if (!in_prerequisites) {
+                    // Everything up to the first `target:` is the target list
+                    if (ends_rule || token == ":")
+                        in_prerequisites = true;
+                    continue;
+                }
+
+                // `-MP` appends phony rules for every header; stop at the first one.
+                if (ends_rule)
+                    break;
+
+                deps.push_back(token);
+            }
+
+            return deps;
+        }
+
+        HeaderDependencies parse_ninja_deps_output(const std::string& output) {
+            HeaderDependencies deps;
+            std::istringstream stream(output);
+            std::string line;
+            std::vector<std::string>* current = nullptr;
+
+            while (std::getline(stream, line)) {
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+
+                if (line.empty()) {
+                    current = nullptr;
+                    continue;
+                }
+
+                if (line[0] == ' ' || line[0] == '\t') {
+                    if (current)
+                        current->push_back(util::trim_whitespace(line));
+                    continue;
+                }
+
+                // e.g. `foo.o: #deps 2, deps mtime 123 (VALID)`
+                const auto marker = line.find(": #deps");
+                if (marker == std::string::npos) {
+                    current = nullptr;
+                    continue;
+                }
+
+                // Stale entries describe a build that no longer matches the sources
+                if (line.find("(STALE)") != std::string::npos) {
+                    current = nullptr;
+                    continue;
+                }
+
+                current = &deps[line.substr(0, marker)];
+            }
+
+            return deps;
+        }
+
+        HeaderDependencies read_ninja_deps_log(const std::string& contents) {
+            static const std::string signature = "# ninjadeps\n";
+
+            auto read_u32 = [&contents](size_t offset) {
+                uint32_t value = 0;
+                std::memcpy(&value, contents.data() + offset, sizeof(value));
+                return value;
+            };
+
+            HeaderDependencies deps;
+            if (contents.size() < signature.size() + 4 || contents.compare(0, signature.size(), signature) != 0)
+                return deps;
+
+            // Version 3 has 32 bit mtimes, version 4 (Ninja 1.10+) 64 bit ones
+            const auto version = read_u32(signature.size());
+            if (version != 3 && version != 4)
+                return deps;
+            const size_t header_ints = version == 4 ? 3 : 2;
+
+            std::vector<std::string> paths;
+            std::unordered_map<uint32_t, std::vector<uint32_t>> records;
+
+            // A truncated record ends the log, as it does for Ninja
+            size_t offset = signature.size() + 4;
+            while (offset + 4 <= contents.size()) {
+                auto size = read_u32(offset);
+                const bool is_deps = size >> 31;
+                size &= 0x7FFFFFFF;
+                offset += 4;
+
+                if (offset + size > contents.size() || size % 4 != 0 || size < 4)
+                    break;
+
+                if (is_deps) {
+                    if (size < header_ints * 4)
+                        break;
+
+                    std::vector<uint32_t> ids;
+                    for (size_t i = header_ints; i < size / 4; ++i)
+                        ids.push_back(read_u32(offset + i * 4));
+
+                    // Later records of an output replace earlier ones
+                    records[read_u32(offset)] = std::move(ids);
+                } else {
+                    // The path is padded with up to three NULs, then checksummed
+                    auto path_size = size - 4;
+                    while (path_size > 0 && contents[offset + path_size - 1] == '\0')
+                        --path_size;
+
+                    if (~read_u32(offset + size - 4) != paths.size())
+                        break;
+                    paths.push_back(contents.substr(offset, path_size));
+                }
+
+                offset += size;
+            }
+
+            for (const auto& [output, ids] : records) {
+                if (output >= paths.size())
+                    continue;
+
+                auto& headers = deps[paths[output]];
+                for (const auto id : ids)
+                    if (id < paths.size())
+                        headers.push_back(paths[id]);
+            }
+
+            return deps;
+        }
+
+        static std::string normalize_output(const std::string& path) {
+            return fs::path(path).lexically_normal().generic_string();
+        }
+
+        static std::string absolute_header(const fs::path& build_dir, const std::string& header) {
+            fs::path path(header);
+            if (path.is_relative())
+                path = fs::absolute(build_dir / path);
+            return path.lexically_normal().generic_string();
+        }
+
+        HeaderDependencies load_header_dependencies(const BuildManager& build_manager, const fs::path& build_dir) {
+            HeaderDependencies recorded;
+
+            if (std::ifstream in(build_dir / ".ninja_deps", std::ios::binary); in) {
+                std::stringstream contents;
+                contents << in.rdbuf();
+
+                for (auto& [target, headers] : read_ninja_deps_log(contents.str()))
+                    recorded[normalize_output(target)] = std::move(headers);
+            }
+
+            // Recorded by `--executor native`
+            if (fs::exists(build_dir / DEPS_LOG_FILE)) {
+                DepsLog deps_log;
+                deps_log.load(build_dir / DEPS_LOG_FILE);
+
+                for (const auto& [target, entry] : deps_log.entries())
+                    recorded.try_emplace(normalize_output(target), entry.deps);
+            }
+
+            HeaderDependencies result;
+
+            for (const auto& target : build_manager.get_compilation_targets()) {
+                std::vector<std::string> headers;
+
+                auto it = recorded.find(normalize_output(target.output));
+                if (it != recorded.end()) {
+                    headers = it->second;
+                } else {
+                    // Paths in the manifest are relative to the build directory
+                    const auto depfile = build_dir / (target.output + ".d");
+                    if (!fs::exists(depfile))
+                        continue;
+
+                    std::ifstream in(depfile);
+                    std::stringstream buffer;
+                    buffer << in.rdbuf();
+                    headers = parse_depfile(buffer.str());
+                }
+
+                auto& entry = result[target.output];
+                for (const auto& header : headers) {
+                    // The source file itself is listed first in depfiles
+                    const auto path = absolute_header(build_dir, header);
+                    if (path != fs::path(target.input).lexically_normal().generic_string())
+                        entry.push_back(path);
+                }
+            }
+
+            muuk::logger::info("Loaded header dependencies for {} compilation targets.", result.size());
+            return result;
+        }
+    } // namespace build
+} // namespace muuk
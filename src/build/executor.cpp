@@ -0,0 +1,606 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/core.h>
+#include <fmt/format.h>
+
+#include "build/deps.hpp"
+#include "build/executor.hpp"
+#include "cache/hash.hpp"
+#include "logger.hpp"
+#include "rustify.hpp"
+#include "util.hpp"
+
+namespace fs = std::filesystem;
+
+namespace muuk {
+    namespace build {
+        /// Logs are compacted on load once they hold this many stale records.
+        static constexpr size_t COMPACTION_SLACK = 1000;
+
+        /// Prefix of the `/showIncludes` lines of an English MSVC.
+        static constexpr std::string_view MSVC_INCLUDE_PREFIX = "Note: including file:";
+
+        static std::vector<std::string> split_tabs(const std::string& line) {
+            std::vector<std::string> fields;
+            size_t start = 0;
+            while (true) {
+                const auto tab = line.find('\t', start);
+                fields.push_back(line.substr(start, tab - start));
+                if (tab == std::string::npos)
+                    return fields;
+                start = tab + 1;
+            }
+        }
+
+        static FileTime parse_time(const std::string& field) {
+            return std::strtoll(field.c_str(), nullptr, 10);
+        }
+
+        /// Rewrites a log atomically through a temporary file.
+        static void rewrite_log(const fs::path& path, const std::string& contents) {
+            const auto temp = path.string() + ".tmp";
+            {
+                std::ofstream out(temp, std::ios::trunc);
+                out << contents;
+            }
+
+            std::error_code ec;
+            fs::rename(temp, path, ec);
+        }
+
+        FileTime file_time(const fs::path& path) {
+            std::error_code ec;
+            const auto time = fs::last_write_time(path, ec);
+            return ec ? MISSING_FILE : static_cast<FileTime>(time.time_since_epoch().count());
+        }
+
+        std::string hash_command(const std::string& command) {
+            return cache::sha256_hex(command).substr(0, 16);
+        }
+
+        /// Like Ninja, a response file is part of the command it feeds.
+        static std::string hash_edge(const BuildEdge& edge) {
+            return hash_command(edge.rspfile.empty() ? edge.command : edge.command + ";rspfile=" + edge.rspfile_content);
+        }
+
+        void DepsLog::load(const fs::path& path) {
+            std::lock_guard lock(mutex_);
+            path_ = path;
+            entries_.clear();
+
+            std::ifstream in(path);
+            size_t records = 0;
+
+            // `<output>\t<mtime>\t<dep>\t<dep>...`, the last record of an output wins
+            for (std::string line; std::getline(in, line);) {
+                if (line.empty() || line[0] == '#')
+                    continue;
+
+                auto fields = split_tabs(line);
+                if (fields.size() < 2)
+                    continue;
+
+                Entry entry;
+                entry.mtime = parse_time(fields[1]);
+                entry.deps.assign(std::make_move_iterator(fields.begin() + 2), std::make_move_iterator(fields.end()));
+                entries_[fields[0]] = std::move(entry);
+                ++records;
+            }
+            in.close();
+
+            if (records <= entries_.size() + COMPACTION_SLACK)
+                return;
+
+            std::ostringstream contents;
+            contents << "# muuk deps v1\n";
+            for (const auto& [output, entry] : entries_) {
+                contents << output << '\t' << entry.mtime;
+                for (const auto& dep : entry.deps)
+                    contents << '\t' << dep;
+                contents << '\n';
+            }
+            rewrite_log(path, contents.str());
+        }
+
+        std::optional<DepsLog::Entry> DepsLog::lookup(const std::string& output) const {
+            std::lock_guard lock(mutex_);
+            auto it = entries_.find(output);
+            if (it == entries_.end())
+                return std::nullopt;
+            return it->second;
+        }
+
+        void DepsLog::record(const std::string& output, FileTime mtime, std::vector<std::string> deps) {
+            std::string line = output + '\t' + std::to_string(mtime);
+            for (const auto& dep : deps)
+                line += '\t' + dep;
+            line += '\n';
+
+            std::lock_guard lock(mutex_);
+            entries_[output] = { mtime, std::move(deps) };
+
+            std::ofstream out(path_, std::ios::app);
+            out << line;
+        }
+
+        void BuildLog::load(const fs::path& path) {
+            std::lock_guard lock(mutex_);
+            path_ = path;
+            entries_.clear();
+
+            std::ifstream in(path);
+            size_t records = 0;
+            std::unordered_map<std::string, size_t> last_record;
+
+            // `<start>\t<end>\t<mtime>\t<output>\t<hash>\t<max rss>`
+            for (std::string line; std::getline(in, line);) {
+                if (line.empty() || line[0] == '#')
+                    continue;
+
+                const auto fields = split_tabs(line);
+                if (fields.size() < 5)
+                    continue;
+
+                Entry entry;
+                entry.start_ms = parse_time(fields[0]);
+                entry.end_ms = parse_time(fields[1]);
+                entry.mtime = parse_time(fields[2]);
+                entry.output = fields[3];
+                entry.command_hash = fields[4];
+                if (fields.size() > 5)
+                    entry.max_rss_kb = std::strtol(fields[5].c_str(), nullptr, 10);
+
+                last_record[entry.output] = records++;
+                entries_[entry.output] = std::move(entry);
+            }
+            in.close();
+
+            if (records <= entries_.size() + COMPACTION_SLACK && records > 0)
+                return;
+
+            // Keep the order of the records, so the timings report can
+            // still find the last build at the end
+            std::vector<const Entry*> sorted;
+            for (const auto& [_, entry] : entries_)
+                sorted.push_back(&entry);
+            std::sort(sorted.begin(), sorted.end(), [&last_record](const Entry* a, const Entry* b) {
+                return last_record.at(a->output) < last_record.at(b->output);
+            });
+
+            std::ostringstream contents;
+            contents << "# muuk log v1\n";
+            for (const auto* entry : sorted)
+                contents << entry->start_ms << '\t' << entry->end_ms << '\t' << entry->mtime << '\t'
+                         << entry->output << '\t' << entry->command_hash << '\t' << entry->max_rss_kb << '\n';
+            rewrite_log(path, contents.str());
+        }
+
+        std::optional<BuildLog::Entry> BuildLog::lookup(const std::string& output) const {
+            std::lock_guard lock(mutex_);
+            auto it = entries_.find(output);
+            if (it == entries_.end())
+                return std::nullopt;
+            return it->second;
+        }
+
+        void BuildLog::record(Entry entry) {
+            const auto line = fmt::format(
+                "{}\t{}\t{}\t{}\t{}\t{}\n",
+                entry.start_ms,
+                entry.end_ms,
+                entry.mtime,
+                entry.output,
+                entry.command_hash,
+                entry.max_rss_kb);
+
+            std::lock_guard lock(mutex_);
+            entries_[entry.output] = std::move(entry);
+
+            std::ofstream out(path_, std::ios::app);
+            out << line;
+        }
+
+        /// Removes the `/showIncludes` lines from `output`, returning the headers.
+        static std::vector<std::string> extract_msvc_includes(std::string& output) {
+            std::vector<std::string> includes;
+            std::string filtered;
+            std::istringstream stream(output);
+
+            for (std::string line; std::getline(stream, line);) {
+                if (line.starts_with(MSVC_INCLUDE_PREFIX)) {
+                    includes.push_back(util::trim_whitespace(line.substr(MSVC_INCLUDE_PREFIX.size())));
+                    continue;
+                }
+                filtered += line + "\n";
+            }
+
+            output = std::move(filtered);
+            return includes;
+        }
+
+        Executor::Executor(fs::path build_dir, BuildGraph graph) :
+            build_dir_(std::move(build_dir)), graph_(std::move(graph)) { }
+
+        Result<ExecutorStats> Executor::run(const ExecutorOptions& options) {
+            const auto& edges = graph_.edges;
+            const size_t edge_count = edges.size();
+
+            std::unordered_map<std::string, size_t> producer;
+            for (size_t i = 0; i < edge_count; ++i)
+                for (const auto& output : edges[i].outputs)
+                    if (!producer.emplace(output, i).second)
+                        return Err("Multiple rules generate '{}'", output);
+
+            // Edges reachable from the requested targets
+            std::vector<size_t> stack;
+            if (options.targets.empty()) {
+                for (size_t i = 0; i < edge_count; ++i)
+                    stack.push_back(i);
+            } else {
+                for (const auto& target : options.targets) {
+                    std::vector<std::string> outputs = { target };
+                    if (auto alias = graph_.aliases.find(target); alias != graph_.aliases.end())
+                        outputs = alias->second;
+
+                    for (const auto& output : outputs) {
+                        auto it = producer.find(output);
+                        if (it == producer.end())
+                            return Err("Unknown target '{}'", target);
+                        stack.push_back(it->second);
+                    }
+                }
+            }
+
+            std::vector<char> needed(edge_count, 0);
+            while (!stack.empty()) {
+                const auto edge = stack.back();
+                stack.pop_back();
+                if (needed[edge])
+                    continue;
+                needed[edge] = 1;
+
+                for (const auto* list : { &edges[edge].inputs, &edges[edge].implicit_inputs })
+                    for (const auto& input : *list)
+                        if (auto it = producer.find(input); it != producer.end())
+                            stack.push_back(it->second);
+            }
+
+            std::vector<size_t> pending(edge_count, 0);
+            std::vector<std::vector<size_t>> consumers(edge_count);
+            size_t total = 0;
+
+            for (size_t i = 0; i < edge_count; ++i) {
+                if (!needed[i])
+                    continue;
+                ++total;
+
+                for (const auto* list : { &edges[i].inputs, &edges[i].implicit_inputs })
+                    for (const auto& input : *list)
+                        if (auto it = producer.find(input); it != producer.end()) {
+                            ++pending[i];
+                            consumers[it->second].push_back(i);
+                        }
+            }
+
+            DepsLog deps_log;
+            deps_log.load(build_dir_ / DEPS_LOG_FILE);
+
+            BuildLog build_log;
+            build_log.load(build_dir_ / BUILD_LOG_FILE);
+
+            const size_t worker_count = std::max<size_t>(
+                1,
+                options.jobs > 0 ? options.jobs : std::thread::hardware_concurrency());
+
+            // Each worker owns a queue sorted by ascending priority. Workers take
+            // from the back of their own queue first, then from the others'.
+            struct Queue {
+                std::mutex mutex;
+                std::deque<size_t> edges;
+            };
+            std::vector<std::unique_ptr<Queue>> queues;
+            for (size_t i = 0; i < worker_count; ++i)
+                queues.push_back(std::make_unique<Queue>());
+
+            std::mutex state_mutex;
+            std::condition_variable wake;
+            size_t queued = 0;
+            size_t remaining = total;
+            bool failed = false;
+            std::string failure;
+
+            // Edges running in each pool. A worker waits for a free slot, like
+            // Ninja holding back the edges of a full pool.
+            std::unordered_map<std::string, size_t> pool_usage;
+            std::condition_variable pool_released;
+
+            std::mutex print_mutex;
+            std::atomic<size_t> finished = 0;
+            std::atomic<size_t> ran = 0;
+
+            const auto build_start = std::chrono::steady_clock::now();
+            auto elapsed_ms = [&build_start]() {
+                return std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - build_start)
+                    .count();
+            };
+
+            auto push = [&](size_t worker, size_t edge) {
+                {
+                    auto& queue = *queues[worker];
+                    std::lock_guard lock(queue.mutex);
+                    auto position = std::upper_bound(
+                        queue.edges.begin(),
+                        queue.edges.end(),
+                        edges[edge].priority,
+                        [&](double priority, size_t other) { return priority < edges[other].priority; });
+                    queue.edges.insert(position, edge);
+                }
+                {
+                    std::lock_guard lock(state_mutex);
+                    ++queued;
+                }
+                wake.notify_one();
+            };
+
+            auto take = [&](size_t worker) -> std::optional<size_t> {
+                for (size_t i = 0; i < worker_count; ++i) {
+                    auto& queue = *queues[(worker + i) % worker_count];
+                    std::lock_guard lock(queue.mutex);
+                    if (queue.edges.empty())
+                        continue;
+
+                    const auto edge = queue.edges.back();
+                    queue.edges.pop_back();
+
+                    std::lock_guard state_lock(state_mutex);
+                    --queued;
+                    return edge;
+                }
+                return std::nullopt;
+            };
+
+            auto fail = [&](const std::string& message) {
+                std::lock_guard lock(state_mutex);
+                if (!failed)
+                    failure = message;
+                failed = true;
+                wake.notify_all();
+                pool_released.notify_all();
+            };
+
+            /// Marks an edge as done and queues the consumers it unblocked.
+            auto complete = [&](size_t worker, size_t edge) {
+                std::vector<size_t> ready;
+                {
+                    std::lock_guard lock(state_mutex);
+                    --remaining;
+                    for (const auto consumer : consumers[edge])
+                        if (--pending[consumer] == 0)
+                            ready.push_back(consumer);
+                    if (remaining == 0)
+                        wake.notify_all();
+                }
+
+                ++finished;
+                for (const auto consumer : ready)
+                    push(worker, consumer);
+            };
+
+            /// Returns why the edge must run, or nothing if it is up to date.
+            auto dirty_reason = [&](const BuildEdge& edge) -> Result<std::optional<std::string>> {
+                for (const auto& output : edge.outputs)
+                    if (file_time(build_dir_ / output) == MISSING_FILE)
+                        return std::optional<std::string>("output " + output + " is missing");
+
+                const auto log_entry = build_log.lookup(edge.outputs.front());
+                if (!log_entry)
+                    return std::optional<std::string>("no build log entry");
+                if (log_entry->command_hash != hash_edge(edge))
+                    return std::optional<std::string>("command changed");
+
+                FileTime newest = MISSING_FILE;
+                for (const auto* list : { &edge.inputs, &edge.implicit_inputs }) {
+                    for (const auto& input : *list) {
+                        const auto time = file_time(build_dir_ / input);
+                        if (time == MISSING_FILE) {
+                            if (!producer.contains(input))
+                                return Err("'{}', needed by '{}', is missing and no known rule can make it", input, edge.outputs.front());
+                            return std::optional<std::string>("input " + input + " is missing");
+                        }
+                        newest = std::max(newest, time);
+                    }
+                }
+
+                if (edge.deps != DepsFormat::None) {
+                    const auto recorded = deps_log.lookup(edge.outputs.front());
+                    if (!recorded)
+                        return std::optional<std::string>("no recorded dependencies");
+
+                    for (const auto& dep : recorded->deps) {
+                        const auto time = file_time(build_dir_ / dep);
+                        if (time == MISSING_FILE)
+                            return std::optional<std::string>("dependency " + dep + " is missing");
+                        newest = std::max(newest, time);
+                    }
+                }
+
+                if (newest > log_entry->mtime)
+                    return std::optional<std::string>("an input is newer than the output");
+
+                return std::optional<std::string> {};
+            };
+
+            auto execute = [&](size_t worker, size_t edge_index) {
+                const auto& edge = edges[edge_index];
+
+                auto reason = dirty_reason(edge);
+                if (!reason) {
+                    fail(reason.error().message);
+                    return;
+                }
+
+                if (!*reason) {
+                    complete(worker, edge_index);
+                    return;
+                }
+
+                for (const auto& output : edge.outputs) {
+                    std::error_code ec;
+                    fs::create_directories((build_dir_ / output).parent_path(), ec);
+                }
+
+                {
+                    std::lock_guard lock(print_mutex);
+                    fmt::print("[{}/{}] {}\n", ran + 1, total, edge.description);
+                    std::fflush(stdout);
+                }
+                muuk::logger::trace("Running '{}' ({})", edge.outputs.front(), **reason);
+
+                // An edge that leaves its output untouched records the newest
+                // input instead, so it isn't dirty again on the next run
+                FileTime newest_input = MISSING_FILE;
+                for (const auto* list : { &edge.inputs, &edge.implicit_inputs })
+                    for (const auto& input : *list)
+                        newest_input = std::max(newest_input, file_time(build_dir_ / input));
+
+                const auto pool = graph_.pools.find(edge.pool);
+                const bool pooled = !edge.pool.empty() && pool != graph_.pools.end() && pool->second > 0;
+                if (pooled) {
+                    std::unique_lock lock(state_mutex);
+                    pool_released.wait(lock, [&] { return pool_usage[edge.pool] < pool->second || failed; });
+                    if (failed)
+                        return;
+                    ++pool_usage[edge.pool];
+                }
+
+                // Kept after a failure, to rerun the command by hand
+                if (!edge.rspfile.empty())
+                    std::ofstream(build_dir_ / edge.rspfile, std::ios::binary) << edge.rspfile_content;
+
+                const auto start_ms = elapsed_ms();
+                auto result = util::process::run_shell(edge.command, build_dir_.string());
+                const auto end_ms = elapsed_ms();
+                ++ran;
+
+                if (pooled) {
+                    {
+                        std::lock_guard lock(state_mutex);
+                        --pool_usage[edge.pool];
+                    }
+                    pool_released.notify_all();
+                }
+
+                if (!result || result->exit_code != 0) {
+                    std::lock_guard lock(print_mutex);
+                    fmt::print("FAILED: {}\n{}\n", fmt::join(edge.outputs, " "), edge.command);
+                    if (result)
+                        fmt::print("{}{}", result->out, result->err);
+                    else
+                        fmt::print("{}\n", result.error().message);
+                    std::fflush(stdout);
+
+                    fail(fmt::format("'{}' failed", edge.outputs.front()));
+                    return;
+                }
+
+                if (!edge.rspfile.empty()) {
+                    std::error_code ec;
+                    fs::remove(build_dir_ / edge.rspfile, ec);
+                }
+
+                std::vector<std::string> deps;
+                if (edge.deps == DepsFormat::Msvc) {
+                    deps = extract_msvc_includes(result->out);
+                } else if (edge.deps == DepsFormat::Gcc && !edge.depfile.empty()) {
+                    std::ifstream in(build_dir_ / edge.depfile);
+                    std::stringstream contents;
+                    contents << in.rdbuf();
+                    deps = parse_depfile(contents.str());
+                }
+
+                for (const auto& dep : deps)
+                    newest_input = std::max(newest_input, file_time(build_dir_ / dep));
+
+                for (const auto& output : edge.outputs) {
+                    BuildLog::Entry entry;
+                    entry.output = output;
+                    entry.start_ms = start_ms;
+                    entry.end_ms = end_ms;
+                    entry.mtime = std::max(file_time(build_dir_ / output), newest_input);
+                    entry.command_hash = hash_edge(edge);
+                    entry.max_rss_kb = result->max_rss_kb;
+                    build_log.record(std::move(entry));
+                }
+
+                if (edge.deps != DepsFormat::None)
+                    deps_log.record(edge.outputs.front(), std::max(file_time(build_dir_ / edge.outputs.front()), newest_input), std::move(deps));
+
+                if (!result->out.empty() || !result->err.empty()) {
+                    std::lock_guard lock(print_mutex);
+                    fmt::print("{}{}", result->out, result->err);
+                    std::fflush(stdout);
+                }
+
+                complete(worker, edge_index);
+            };
+
+            // Seed the queues round robin with the edges that are ready right away
+            std::vector<size_t> initial;
+            for (size_t i = 0; i < edge_count; ++i)
+                if (needed[i] && pending[i] == 0)
+                    initial.push_back(i);
+            for (size_t i = 0; i < initial.size(); ++i)
+                push(i % worker_count, initial[i]);
+
+            std::vector<std::thread> workers;
+            for (size_t worker = 0; worker < worker_count; ++worker) {
+                workers.emplace_back([&, worker] {
+                    while (true) {
+                        {
+                            std::unique_lock lock(state_mutex);
+                            wake.wait(lock, [&] { return queued > 0 || remaining == 0 || failed; });
+                            if (remaining == 0 || failed)
+                                return;
+                        }
+
+                        if (auto edge = take(worker))
+                            execute(worker, *edge);
+                    }
+                });
+            }
+
+            for (auto& thread : workers)
+                thread.join();
+
+            if (failed)
+                return Err("Build stopped: {}", failure);
+
+            if (remaining != 0)
+                return Err("Build stopped: {} edges could not be scheduled (dependency cycle?)", remaining);
+
+            ExecutorStats stats;
+            stats.ran = ran;
+            stats.up_to_date = finished - ran;
+
+            if (stats.ran == 0)
+                fmt::print("muuk: no work to do.\n");
+
+            return stats;
+        }
+    } // namespace build
+} // namespace muuk
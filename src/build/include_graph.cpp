@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <filesystem>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+
+#include "build/auto_pch.hpp"
+#include "build/include_graph.hpp"
+
+namespace fs = std::filesystem;
+
+namespace muuk {
+    namespace build {
+        /// A quoted include is looked up next to the including file first.
+        static const std::string* resolve(
+            const pch::IncludeDirective& directive,
+            const std::string& includer,
+            const std::vector<std::string>& headers,
+            const std::unordered_set<std::string>& header_set) {
+            if (!directive.angled) {
+                const auto sibling = (fs::path(includer).parent_path() / directive.spelling).lexically_normal().generic_string();
+                if (auto it = header_set.find(sibling); it != header_set.end())
+                    return &*it;
+            }
+
+            return pch::resolve_include(directive, headers);
+        }
+
+        IncludeReport analyze_includes(const std::vector<pch::TranslationUnit>& tus, const FileReader& read_file) {
+            IncludeReport report;
+            report.translation_units = tus.size();
+
+            std::unordered_map<std::string, size_t> index;
+            std::vector<HeaderCost> headers;
+            std::vector<std::vector<size_t>> includes;
+            std::vector<std::unordered_set<std::string>> includers;
+
+            auto header_index = [&](const std::string& path) {
+                auto [it, inserted] = index.try_emplace(path, headers.size());
+                if (inserted) {
+                    HeaderCost header;
+                    header.path = path;
+                    headers.push_back(std::move(header));
+                    includes.emplace_back();
+                    includers.emplace_back();
+                }
+                return it->second;
+            };
+
+            // A header's includes are resolved against the first translation
+            // unit that pulls it in
+            std::vector<bool> scanned;
+
+            for (const auto& tu : tus) {
+                const std::unordered_set<std::string> header_set(tu.headers.begin(), tu.headers.end());
+
+                for (const auto& path : header_set)
+                    ++headers[header_index(path)].translation_units;
+                scanned.resize(headers.size(), false);
+
+                for (const auto& directive : pch::scan_includes(read_file(tu.source)))
+                    if (const auto* resolved = resolve(directive, tu.source, tu.headers, header_set))
+                        includers[header_index(*resolved)].insert(tu.source);
+
+                for (const auto& path : tu.headers) {
+                    const auto i = header_index(path);
+                    if (scanned[i])
+                        continue;
+                    scanned[i] = true;
+
+                    const auto contents = read_file(path);
+                    headers[i].size = contents.size();
+
+                    for (const auto& directive : pch::scan_includes(contents)) {
+                        const auto* resolved = resolve(directive, path, tu.headers, header_set);
+                        if (!resolved || *resolved == path)
+                            continue;
+
+                        const auto included = header_index(*resolved);
+                        includes[i].push_back(included);
+                        includers[included].insert(path);
+                    }
+                }
+            }
+
+            const auto project_root = fs::current_path();
+            std::vector<size_t> seen(headers.size(), headers.size());
+
+            for (size_t i = 0; i < headers.size(); ++i) {
+                auto& header = headers[i];
+
+                // Everything reachable from the header, counted once
+                std::vector<size_t> stack = { i };
+                seen[i] = i;
+                while (!stack.empty()) {
+                    const auto current = stack.back();
+                    stack.pop_back();
+                    header.transitive_size += headers[current].size;
+
+                    for (const auto included : includes[current])
+                        if (seen[included] != i) {
+                            seen[included] = i;
+                            stack.push_back(included);
+                        }
+                }
+
+                header.stable = pch::is_stable_header(header.path, project_root);
+                header.includers = includers[i].size();
+                header.fraction = tus.empty() ? 0.0 : static_cast<double>(header.translation_units) / static_cast<double>(tus.size());
+                header.cost = header.transitive_size * header.translation_units;
+            }
+
+            std::sort(headers.begin(), headers.end(), [](const HeaderCost& a, const HeaderCost& b) {
+                return a.cost != b.cost ? a.cost > b.cost : a.path < b.path;
+            });
+            report.headers = std::move(headers);
+            return report;
+        }
+
+        static std::string format_bytes(std::uintmax_t bytes) {
+            if (bytes >= 1024 * 1024)
+                return fmt::format("{:.1f}M", static_cast<double>(bytes) / (1024.0 * 1024.0));
+            if (bytes >= 1024)
+                return fmt::format("{:.1f}K", static_cast<double>(bytes) / 1024.0);
+            return std::to_string(bytes);
+        }
+
+        static void format_section(std::ostringstream& out, const std::string& title, const std::vector<const HeaderCost*>& headers, size_t top) {
+            out << "\n"
+                << title << ":\n"
+                << fmt::format("  {:>9} {:>6} {:>9} {:>9} {:>9}  {}\n", "cost", "TUs", "includers", "size", "with deps", "header");
+
+            for (size_t i = 0; i < headers.size() && i < top; ++i) {
+                const auto& header = *headers[i];
+                out << fmt::format(
+                    "  {:>9} {:>5.0f}% {:>9} {:>9} {:>9}  {}\n",
+                    format_bytes(header.cost),
+                    header.fraction * 100.0,
+                    header.includers,
+                    format_bytes(header.size),
+                    format_bytes(header.transitive_size),
+                    header.path);
+            }
+        }
+
+        std::string format_include_report(const IncludeReport& report, size_t top, double widespread_fraction) {
+            std::ostringstream out;
+            out << report.headers.size() << " headers in " << report.translation_units << " translation units\n";
+
+            std::vector<const HeaderCost*> by_cost;
+            for (const auto& header : report.headers)
+                by_cost.push_back(&header);
+            format_section(out, "Most expensive headers (bytes parsed across the build)", by_cost, top);
+
+            // Editing a system header is not something to optimize for
+            std::vector<const HeaderCost*> by_rebuilds;
+            for (const auto& header : report.headers)
+                if (!header.stable)
+                    by_rebuilds.push_back(&header);
+            std::stable_sort(by_rebuilds.begin(), by_rebuilds.end(), [](const HeaderCost* a, const HeaderCost* b) {
+                return a->translation_units > b->translation_units;
+            });
+            format_section(out, "Project headers whose edits rebuild the most translation units", by_rebuilds, top);
+
+            std::vector<const HeaderCost*> widespread;
+            for (const auto& header : report.headers)
+                if (header.fraction >= widespread_fraction)
+                    widespread.push_back(&header);
+            format_section(
+                out,
+                fmt::format(
+                    "Included by at least {:.0f}% of translation units (forward declaration or PCH candidates)",
+                    widespread_fraction * 100.0),
+                widespread,
+                top);
+
+            return out.str();
+        }
+
+        nlohmann::json include_report_json(const IncludeReport& report) {
+            nlohmann::json json;
+            json["translation_units"] = report.translation_units;
+            json["headers"] = nlohmann::json::array();
+
+            for (const auto& header : report.headers)
+                json["headers"].push_back({
+                    { "path", header.path },
+                    { "stable", header.stable },
+                    { "size", header.size },
+                    { "transitive_size", header.transitive_size },
+                    { "includers", header.includers },
+                    { "translation_units", header.translation_units },
+                    { "fraction", header.fraction },
+                    { "cost", header.cost },
+                });
+
+            return json;
+        }
+    } // namespace build
+} // namespace muuk
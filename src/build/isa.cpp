@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "build/isa.hpp"
+#include "buildconfig.h"
+#include "logger.hpp"
+#include "rustify.hpp"
+#include "util.hpp"
+
+namespace fs = std::filesystem;
+
+namespace muuk {
+    namespace build {
+        namespace isa {
+            struct Level {
+                std::string name;
+
+                /// ISPC target for the level
+                std::string ispc;
+
+                /// `__builtin_cpu_supports` features the level adds
+                std::vector<std::string> features;
+            };
+
+            /// Baseline first. Each level implies the ones before it.
+            static const std::vector<Level> KNOWN_LEVELS = {
+                { "x86-64", "sse2-i32x4", {} },
+                { "x86-64-v2", "sse4-i32x4", { "popcnt", "sse4.1", "sse4.2", "ssse3" } },
+                { "x86-64-v3", "avx2-i32x8", { "avx", "avx2", "bmi", "bmi2", "fma" } },
+                { "x86-64-v4", "avx512skx-x16", { "avx512f", "avx512bw", "avx512cd", "avx512dq", "avx512vl" } },
+            };
+
+            static size_t rank(const std::string& level) {
+                for (size_t i = 0; i < KNOWN_LEVELS.size(); ++i)
+                    if (KNOWN_LEVELS[i].name == level)
+                        return i;
+                return KNOWN_LEVELS.size();
+            }
+
+            Result<std::vector<std::string>> sort_levels(const std::vector<std::string>& levels) {
+                std::vector<std::string> sorted;
+                for (const auto& level : levels) {
+                    if (rank(level) == KNOWN_LEVELS.size())
+                        return Err("Unknown ISA level '{}'. Expected 'x86-64', 'x86-64-v2', 'x86-64-v3' or 'x86-64-v4'.", level);
+                    if (std::find(sorted.begin(), sorted.end(), level) == sorted.end())
+                        sorted.push_back(level);
+                }
+
+                std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+                    return rank(a) < rank(b);
+                });
+                return sorted;
+            }
+
+            std::string variant_object(const std::string& object, const std::string& level) {
+                return fs::path(object).replace_extension("." + level + OBJ_EXT).generic_string();
+            }
+
+            std::string ispc_target(const std::string& level) {
+                const auto i = rank(level);
+                return i < KNOWN_LEVELS.size() ? KNOWN_LEVELS[i].ispc : "";
+            }
+
+            std::string symbol_suffix(const std::string& level) {
+                auto suffix = "." + level;
+                std::replace(suffix.begin(), suffix.end(), '-', '_');
+                return suffix;
+            }
+
+            /// `__builtin_cpu_supports` checks for everything up to `level`
+            static std::string cpu_check(const std::string& level) {
+                std::vector<std::string> checks;
+                for (size_t i = 0; i <= rank(level) && i < KNOWN_LEVELS.size(); ++i)
+                    for (const auto& feature : KNOWN_LEVELS[i].features)
+                        checks.push_back("__builtin_cpu_supports(\"" + feature + "\")");
+                return checks.empty() ? "1" : fmt::format("{}", fmt::join(checks, " && "));
+            }
+
+            std::string dispatch_source(const std::vector<std::string>& levels, const std::vector<std::set<std::string>>& defined) {
+                std::set<std::string> symbols;
+                for (const auto& level_symbols : defined)
+                    symbols.insert(level_symbols.begin(), level_symbols.end());
+
+                std::ostringstream out;
+                out << "/* Generated by muuk. Do not edit. */\n\n"
+                    << "/* Resolvers run before constructors, so the CPU model is set up here. */\n"
+                    << "static int muuk_isa_level(void) {\n"
+                    << "    __builtin_cpu_init();\n";
+                for (size_t i = levels.size(); i-- > 1;)
+                    out << "    if (" << cpu_check(levels[i]) << ")\n"
+                        << "        return " << i << ";\n";
+                out << "    return 0;\n"
+                    << "}\n";
+
+                size_t index = 0;
+                for (const auto& symbol : symbols) {
+                    // Levels without the symbol fall back to the nearest one below
+                    std::vector<size_t> variants;
+                    for (size_t i = 0; i < levels.size() && i < defined.size(); ++i)
+                        if (defined[i].contains(symbol)) {
+                            out << "\nextern void muuk_isa_" << index << "_" << i << "(void) __asm__(\""
+                                << symbol << symbol_suffix(levels[i]) << "\");";
+                            variants.push_back(i);
+                        }
+
+                    out << "\nstatic void (*muuk_isa_resolve_" << index << "(void))(void) {\n"
+                        << "    switch (muuk_isa_level()) {\n";
+                    for (size_t level = levels.size(); level-- > 0;) {
+                        auto it = std::find_if(variants.rbegin(), variants.rend(), [level](size_t i) { return i <= level; });
+                        const size_t variant = it == variants.rend() ? variants.front() : *it;
+                        out << "    case " << level << ": return muuk_isa_" << index << "_" << variant << ";\n";
+                    }
+                    out << "    default: return muuk_isa_" << index << "_" << variants.front() << ";\n"
+                        << "    }\n"
+                        << "}\n"
+                        << "void muuk_isa_dispatch_" << index << "(void) __asm__(\"" << symbol
+                        << "\") __attribute__((ifunc(\"muuk_isa_resolve_" << index << "\")));\n";
+                    ++index;
+                }
+
+                return out.str();
+            }
+
+            struct Symbol {
+                std::string name;
+                char type;
+            };
+
+            /// Defined symbols of `object`, from `nm --defined-only -P`
+            static Result<std::vector<Symbol>> defined_symbols(const std::string& nm, const std::string& object) {
+                const auto output = util::process::run({ nm, "--defined-only", "-P", object });
+                if (!output)
+                    return Err(output);
+                if (output->exit_code != 0)
+                    return Err("{} failed on '{}':\n{}", nm, object, output->err);
+
+                std::vector<Symbol> symbols;
+                std::istringstream lines(output->out);
+                for (std::string line; std::getline(lines, line);) {
+                    std::istringstream fields(line);
+                    std::string name, type;
+                    if (fields >> name >> type && type.size() == 1)
+                        symbols.push_back({ name, type[0] });
+                }
+                return symbols;
+            }
+
+            static std::string binutil(const std::string& compiler, const std::string& tool) {
+                if (compiler.find("clang") != std::string::npos && util::command_line::command_exists("llvm-" + tool))
+                    return "llvm-" + tool;
+                return tool;
+            }
+
+            static Result<void> run_tool(const std::vector<std::string>& args) {
+                const auto output = util::process::run(args);
+                if (!output)
+                    return Err(output);
+                if (output->exit_code != 0)
+                    return Err("{} failed:\n{}{}", args.front(), output->out, output->err);
+                return {};
+            }
+
+            Result<void> archive(const ArchiveOptions& options) {
+                if (options.levels.empty())
+                    return Err("'{}' has no ISA levels to dispatch between.", options.output);
+
+                const auto nm = binutil(options.compiler, "nm");
+                const auto objcopy = binutil(options.compiler, "objcopy");
+                const fs::path work_dir = options.output + ".isa";
+
+                std::error_code ec;
+                fs::remove_all(work_dir, ec);
+
+                // Longest level first, so `x86-64` doesn't claim `x86-64-v3` objects
+                std::vector<size_t> by_length(options.levels.size());
+                for (size_t i = 0; i < by_length.size(); ++i)
+                    by_length[i] = i;
+                std::sort(by_length.begin(), by_length.end(), [&](size_t a, size_t b) {
+                    return options.levels[a].size() > options.levels[b].size();
+                });
+
+                std::vector<std::vector<std::string>> variants(options.levels.size());
+                std::vector<std::string> members;
+                for (const auto& object : options.objects) {
+                    auto level = std::find_if(by_length.begin(), by_length.end(), [&](size_t i) {
+                        return object.ends_with("." + options.levels[i] + OBJ_EXT);
+                    });
+
+                    if (level == by_length.end())
+                        members.push_back(object);
+                    else
+                        variants[*level].push_back(object);
+                }
+
+                std::vector<std::set<std::string>> dispatched(options.levels.size());
+                for (size_t i = 0; i < options.levels.size(); ++i) {
+                    const auto& level = options.levels[i];
+                    const auto level_dir = work_dir / level;
+                    fs::create_directories(level_dir, ec);
+
+                    // Functions, vtables, typeinfo and COMDAT group signatures
+                    // get the suffix, so no variant can bind to another's code.
+                    // Global data stays shared: higher levels only get weak copies.
+                    std::set<std::string> renamed;
+                    std::set<std::string> weakened;
+                    for (const auto& object : variants[i]) {
+                        auto symbols = defined_symbols(nm, object);
+                        if (!symbols)
+                            return Err(symbols);
+
+                        for (const auto& symbol : *symbols) {
+                            if (std::string("TWVuin").find(symbol.type) != std::string::npos)
+                                renamed.insert(symbol.name);
+                            if (symbol.type == 'T' || symbol.type == 'i')
+                                dispatched[i].insert(symbol.name);
+                            if (i > 0 && std::string("DBRGS").find(symbol.type) != std::string::npos)
+                                weakened.insert(symbol.name);
+                        }
+                    }
+
+                    const auto redefine_file = level_dir / "symbols.txt";
+                    std::ofstream redefine(redefine_file);
+                    for (const auto& symbol : renamed)
+                        redefine << symbol << " " << symbol << symbol_suffix(level) << "\n";
+                    redefine.close();
+
+                    for (size_t n = 0; n < variants[i].size(); ++n) {
+                        const auto& object = variants[i][n];
+                        const auto renamed_object = (level_dir / (std::to_string(n) + "_" + fs::path(object).filename().string())).string();
+
+                        std::vector<std::string> args = { objcopy, "--redefine-syms=" + redefine_file.string() };
+                        for (const auto& symbol : weakened)
+                            args.push_back("--weaken-symbol=" + symbol);
+                        args.push_back(object);
+                        args.push_back(renamed_object);
+
+                        if (auto result = run_tool(args); !result)
+                            return result;
+                        members.push_back(renamed_object);
+                    }
+                }
+
+                const auto dispatch_file = work_dir / "dispatch.c";
+                const auto dispatch_object = (work_dir / ("dispatch" + std::string(OBJ_EXT))).string();
+                std::ofstream(dispatch_file) << dispatch_source(options.levels, dispatched);
+
+                if (auto result = run_tool({ options.compiler, "-x", "c", "-O2", "-c", dispatch_file.string(), "-o", dispatch_object }); !result)
+                    return result;
+                members.push_back(dispatch_object);
+
+                fs::remove(options.output, ec);
+                std::vector<std::string> args = { options.archiver, "rcs", options.output };
+                args.insert(args.end(), members.begin(), members.end());
+                return run_tool(args);
+            }
+        } // namespace isa
+    } // namespace build
+} // namespace muuk
@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "build/linker.hpp"
+#include "compiler.hpp"
+#include "logger.hpp"
+#include "rustify.hpp"
+#include "util.hpp"
+
+namespace muuk {
+    namespace build {
+        /// Fastest first, as `auto` picks them
+        static const std::vector<std::string> KNOWN_LINKERS = { "mold", "lld", "gold" };
+
+        bool linker_available(const Compiler& compiler, const std::string& linker) {
+            static std::mutex mutex;
+            static std::map<std::pair<std::string, std::string>, bool> probed;
+
+            const auto key = std::make_pair(compiler.to_string(), linker);
+
+            std::lock_guard lock(mutex);
+            if (auto it = probed.find(key); it != probed.end())
+                return it->second;
+
+            // The driver only gets as far as asking the linker for its version
+            const auto output = util::process::run({ compiler.to_string(), "-fuse-ld=" + linker, "-Wl,--version" });
+            const bool available = output && output->exit_code == 0;
+
+            muuk::logger::info("Linker '{}' is {}available to {}.", linker, available ? "" : "not ", compiler.to_string());
+            return probed[key] = available;
+        }
+
+        Result<std::vector<std::string>> linker_flags(const Compiler& compiler, const std::string& linker) {
+            if (linker.empty() || linker == "default")
+                return std::vector<std::string> {};
+
+            if (linker != "auto" && std::find(KNOWN_LINKERS.begin(), KNOWN_LINKERS.end(), linker) == KNOWN_LINKERS.end())
+                return Err("Unknown linker '{}'. Expected 'mold', 'lld', 'gold' or 'auto'.", linker);
+
+            if (compiler == Compiler::MSVC) {
+                muuk::logger::warn("The 'linker' setting is ignored with MSVC.");
+                return std::vector<std::string> {};
+            }
+
+            std::string selected;
+            if (linker == "auto") {
+                for (const auto& candidate : KNOWN_LINKERS)
+                    if (linker_available(compiler, candidate)) {
+                        selected = candidate;
+                        break;
+                    }
+
+                if (selected.empty())
+                    return std::vector<std::string> {};
+            } else {
+                if (!linker_available(compiler, linker))
+                    return Err("Linker '{}' is not available to {}. Install it or use linker = \"auto\".", linker, compiler.to_string());
+                selected = linker;
+            }
+
+            std::vector<std::string> flags = { "-fuse-ld=" + selected };
+
+            // mold and lld use every core on their own; gold has to be asked
+            if (selected == "gold")
+                flags.push_back("-Wl,--threads");
+
+            return flags;
+        }
+    } // namespace build
+} // namespace muuk
@@ -25,13 +25,28 @@ namespace muuk {
             }
         }
 
-        void BuildManager::add_archive_target(const std::string lib, const std::vector<std::string> objs, const std::vector<std::string> aflags) {
+        void BuildManager::add_pch_target(const std::string& package_id, const std::string header, const std::string pch, const CompilationFlags compilation_flags) {
+            if (header.empty() || pch.empty()) {
+                muuk::logger::error("Precompiled header target must have a header and an output.");
+                return;
+            }
+
+            if (pch_registry.find(package_id) != pch_registry.end()) {
+                muuk::logger::warn("Package '{}' already has a precompiled header. Ignoring '{}'.", package_id, header);
+                return;
+            }
+
+            pch_registry[package_id] = pch_targets.size();
+            pch_targets.emplace_back(header, pch, compilation_flags);
+        }
+
+        void BuildManager::add_archive_target(const std::string lib, const std::vector<std::string> objs, const std::vector<std::string> aflags, const std::vector<std::string> isa_levels) {
             if (lib.empty() || objs.empty()) {
                 muuk::logger::trace("Skipping since Archive target must have a library name and at least one object file.\n");
                 return;
             }
             if (library_registry.find(lib) == library_registry.end()) {
-                archive_targets.emplace_back(lib, objs, aflags);
+                archive_targets.emplace_back(lib, objs, aflags, isa_levels);
                 library_registry[lib] = lib;
             }
         }
@@ -88,6 +103,51 @@ namespace muuk {
             return link_targets;
         }
 
+        const std::vector<PrecompiledHeaderTarget>& BuildManager::get_pch_targets() const {
+            return pch_targets;
+        }
+
+        std::vector<std::string> BuildManager::get_generated_headers() const {
+            std::vector<std::string> headers;
+            for (const auto& target : compilation_targets)
+                if (!target.generated_header.empty())
+                    headers.push_back(target.generated_header);
+            return headers;
+        }
+
+        const PrecompiledHeaderTarget* BuildManager::find_pch_target(const std::string& package_id) const {
+            auto it = pch_registry.find(package_id);
+            if (it == pch_registry.end())
+                return nullptr;
+            return &pch_targets[it->second];
+        }
+
+        void BuildManager::add_prebuilt_library(const std::string& package_id, PrebuiltLibrary library) {
+            prebuilt_libraries[package_id] = std::move(library);
+        }
+
+        const PrebuiltLibrary* BuildManager::find_prebuilt_library(const std::string& package_id) const {
+            auto it = prebuilt_libraries.find(package_id);
+            if (it == prebuilt_libraries.end())
+                return nullptr;
+            return &it->second;
+        }
+
+        const std::unordered_map<std::string, PrebuiltLibrary>& BuildManager::get_prebuilt_libraries() const {
+            return prebuilt_libraries;
+        }
+
+        void BuildManager::add_object_library(const std::string& lib, std::vector<std::string> objs) {
+            object_libraries[lib] = std::move(objs);
+        }
+
+        const std::vector<std::string>* BuildManager::find_object_library(const std::string& lib) const {
+            auto it = object_libraries.find(lib);
+            if (it == object_libraries.end())
+                return nullptr;
+            return &it->second;
+        }
+
         CompilationTarget* BuildManager::find_compilation_target(const std::string& key, const std::string& value) {
             auto it = std::find_if(
                 compilation_targets.begin(),
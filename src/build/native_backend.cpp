@@ -0,0 +1,338 @@
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "build/backend.hpp"
+#include "build/executor.hpp"
+#include "build/manager.hpp"
+#include "build/parser.hpp"
+#include "build/pgo.hpp"
+#include "build/resources.hpp"
+#include "build/targets.hpp"
+#include "build/timings.hpp"
+#include "logger.hpp"
+#include "util.hpp"
+
+namespace fs = std::filesystem;
+
+namespace muuk {
+    namespace build {
+        /// Joins the non-empty pieces of a command line with spaces.
+        static std::string join(const std::vector<std::string>& parts) {
+            std::string joined;
+            for (const auto& part : parts) {
+                if (part.empty())
+                    continue;
+                if (!joined.empty())
+                    joined += ' ';
+                joined += part;
+            }
+            return joined;
+        }
+
+        /// Moves `operands` to `<output>.rsp` when they are over
+        /// `RSPFILE_THRESHOLD`, and returns what stands for them on the command line.
+        static std::string spill(BuildEdge& edge, const std::string& operands) {
+            if (operands.size() <= RSPFILE_THRESHOLD)
+                return operands;
+
+            edge.rspfile = edge.outputs.front() + ".rsp";
+            edge.rspfile_content = operands;
+            return "@" + edge.rspfile;
+        }
+
+        NativeBackend::NativeBackend(
+            const BuildManager& build_manager,
+            const muuk::Compiler compiler,
+            const std::string& archiver,
+            const std::string& linker) :
+            BuildBackend(build_manager, compiler, archiver, linker) { }
+
+        std::string NativeBackend::module_dir() const {
+            return "../../" + util::file_system::to_unix_path((build_dir_ / "modules/").string());
+        }
+
+        void NativeBackend::generate_build_file(const std::string& profile) {
+            muuk::logger::info("");
+            muuk::logger::info("  Generating build graph for '{}'", profile);
+            muuk::logger::info("----------------------------------------");
+
+            build_graph(profile);
+
+            muuk::logger::info("Build graph has {} edges", graph_.edges.size());
+        }
+
+        void NativeBackend::build_graph(const std::string& profile) {
+            if (compiler_ != muuk::Compiler::MSVC
+                && compiler_ != muuk::Compiler::Clang
+                && compiler_ != muuk::Compiler::GCC) {
+                muuk::logger::error("Unsupported compiler: {}", compiler_.to_string());
+                throw std::invalid_argument("Unsupported compiler: " + compiler_.to_string());
+            }
+
+            build_dir_ = fs::path("build") / profile;
+            util::file_system::ensure_directory_exists((build_dir_ / "modules/").string());
+
+            std::tie(profile_cflags_, profile_aflags_, profile_lflags_)
+                = get_profile_flag_strings(build_manager, profile);
+
+            const auto* build_profile = build_manager.get_profile(profile);
+            profile_ = build_profile;
+            dwp_ = build_profile ? build_profile->dwp : "";
+            generated_headers_ = build_manager.get_generated_headers();
+
+            graph_ = {};
+            graph_.pools = resource_pools(build_profile, total_memory_mb());
+
+            for (const auto& target : build_manager.get_pch_targets())
+                add_edge(target);
+
+            for (const auto& target : build_manager.get_compilation_targets())
+                add_edge(target);
+
+            for (const auto& target : build_manager.get_archive_targets())
+                add_edge(target);
+
+            for (const auto& target : build_manager.get_external_targets())
+                add_edge(target);
+
+            for (const auto& target : build_manager.get_link_targets()) {
+                add_edge(target);
+
+                // Same aliases as the phony rules of `build.ninja`
+                // (e.g. `muuk.exe` -> `muuk`)
+                const auto short_name = fs::path(target.output).stem().string();
+                graph_.aliases[short_name].push_back(target.output);
+            }
+
+            assign_priorities(graph_, load_edge_durations(build_dir_));
+        }
+
+        void NativeBackend::add_edge(const CompilationTarget& target) {
+            const auto cflags = join(target.flags);
+            const auto& source = target.inputs[0];
+
+            if (target.compilation_unit_type == CompilationUnitType::Ispc) {
+                BuildEdge edge;
+                edge.rule = "ispc";
+                edge.outputs = { target.output, target.generated_header };
+                edge.inputs = { source };
+                edge.description = "Compiling ISPC kernel " + source;
+                edge.depfile = target.output + ".d";
+                edge.deps = DepsFormat::Gcc;
+
+                const auto ispc = join({ "ispc", source, "-o", compiler_ == muuk::Compiler::MSVC ? target.output : target.output + ".parts/kernel.o", "-h", target.generated_header, cflags, "-M -MF", edge.depfile, "-MT", target.output });
+                edge.command = compiler_ == muuk::Compiler::MSVC
+                    ? ispc
+                    : join({ "mkdir -p", target.output + ".parts", "&&", ispc, "&&", compiler_.to_string(), "-r -nostdlib", target.output + ".parts/*.o", "-o", target.output });
+
+                graph_.edges.push_back(std::move(edge));
+                return;
+            }
+
+            std::string module_output;
+            if (target.compilation_unit_type == CompilationUnitType::Module) {
+                module_output = util::file_system::to_unix_path(
+                    "../../" + (build_dir_ / "modules" / (target.logical_name + ".ifc")).string());
+
+                BuildEdge edge;
+                edge.rule = "compile_module";
+                edge.outputs = { module_output };
+                edge.inputs = { source };
+                edge.description = "Compiling C++ module " + source;
+                edge.pool = target.pool;
+
+                if (compiler_ == muuk::Compiler::MSVC) {
+                    edge.command = join({ compiler_.to_string(), "/std:c++20 /utf-8 /c", source, "/ifcOnly /ifcOutput", module_dir(), "/ifcSearchDir", module_dir(), cflags, profile_cflags_, "/showIncludes" });
+                    edge.deps = DepsFormat::Msvc;
+                } else {
+                    edge.depfile = module_output + ".d";
+                    edge.deps = DepsFormat::Gcc;
+                    if (compiler_ == muuk::Compiler::Clang)
+                        edge.command = join({ compiler_.to_string(), "-x c++-module -std=c++20 --precompile", "-fprebuilt-module-path=" + module_dir(), source, "-o", module_output, cflags, profile_cflags_, "-MD -MF", edge.depfile });
+                    else
+                        edge.command = join({ compiler_.to_string(), "-std=c++20 -fmodules-ts -c", source, "-o", module_output, "-fmodule-output=" + module_dir(), cflags, "-MD -MF", edge.depfile, "-Mno-modules" });
+                }
+
+                graph_.edges.push_back(std::move(edge));
+            }
+
+            BuildEdge edge;
+            edge.rule = "compile";
+            edge.outputs = { target.output };
+
+            // Clang compiles the object from the precompiled interface
+            const auto& input = compiler_ == muuk::Compiler::Clang && !module_output.empty()
+                ? module_output
+                : source;
+            edge.inputs = { input };
+            edge.description = "Compiling " + input;
+            edge.pool = target.pool;
+
+            if (!module_output.empty())
+                edge.implicit_inputs.push_back(module_output);
+
+            // No order-only inputs here, the generated headers are implicit
+            edge.implicit_inputs.insert(edge.implicit_inputs.end(), generated_headers_.begin(), generated_headers_.end());
+
+            for (const auto* dep : target.dependencies)
+                edge.implicit_inputs.push_back(util::file_system::to_unix_path(
+                    "../../" + (build_dir_ / "modules" / (dep->logical_name + ".ifc")).string()));
+
+            std::string pchflags;
+            if (!target.pch.empty()) {
+                edge.implicit_inputs.push_back(target.pch);
+                pchflags = compiler_ == muuk::Compiler::Clang
+                    ? "-include-pch " + target.pch
+                    : "-include " + target.pch_header + " -Winvalid-pch";
+            }
+
+            // Merged include lists can outgrow the command line
+            const auto compile_flags = spill(edge, cflags);
+
+            if (compiler_ == muuk::Compiler::MSVC) {
+                edge.command = join({ command_launcher_, compiler_.to_string(), "/c", input, "/Fo" + target.output, profile_cflags_, compile_flags, "/showIncludes", "/ifcSearchDir", module_dir(), extra_cflags_ });
+                edge.deps = DepsFormat::Msvc;
+            } else {
+                edge.depfile = target.output + ".d";
+                edge.command = join({ command_launcher_, compiler_launcher_, compiler_.to_string(), "-c", input, "-o", target.output, profile_cflags_, compile_flags, pchflags, extra_cflags_, "-MD -MF", edge.depfile });
+                edge.deps = DepsFormat::Gcc;
+            }
+
+            graph_.edges.push_back(std::move(edge));
+        }
+
+        void NativeBackend::add_edge(const PrecompiledHeaderTarget& target) {
+            BuildEdge edge;
+            edge.rule = "compile_pch";
+            edge.outputs = { target.output };
+            edge.inputs = { target.header };
+            edge.depfile = target.output + ".d";
+            edge.deps = DepsFormat::Gcc;
+            edge.command = join({ command_launcher_, compiler_.to_string(), "-x c++-header", target.header, "-o", target.output, profile_cflags_, join(target.flags), "-MD -MF", edge.depfile });
+            edge.description = "Precompiling " + target.header;
+            edge.pool = HEAVY_POOL;
+
+            graph_.edges.push_back(std::move(edge));
+        }
+
+        void NativeBackend::add_edge(const ArchiveTarget& target) {
+            BuildEdge edge;
+            edge.rule = "archive";
+            edge.outputs = { target.output };
+            edge.inputs = target.inputs;
+            edge.description = "Archiving " + target.output;
+
+            const auto inputs = spill(edge, join(target.inputs));
+            if (!target.isa_levels.empty()) {
+                edge.rule = "isa_archive";
+                edge.description = "Archiving " + target.output + " with runtime ISA dispatch";
+                edge.command = join({ util::process::quote(util::process::current_executable()), "isa-archive", "--compiler", compiler_.to_string(), "--archiver", archiver_, "--levels", fmt::format("{}", fmt::join(target.isa_levels, ",")), "-o", target.output, "--", inputs });
+            } else if (compiler_ == muuk::Compiler::MSVC) {
+                edge.command = join({ archiver_, "/OUT:" + target.output, inputs, join(target.flags), profile_aflags_ });
+            } else if (profile_ && profile_->archives == "thin") {
+                edge.rule = "thin_archive";
+                edge.command = join({ "rm -f", target.output, "&&", archiver_, "rcsT", target.output, inputs, join(target.flags), profile_aflags_ });
+            } else {
+                edge.command = join({ archiver_, "rcs", target.output, inputs, join(target.flags), profile_aflags_ });
+            }
+
+            graph_.edges.push_back(std::move(edge));
+        }
+
+        void NativeBackend::add_edge(const ExternalTarget& target) {
+            std::string cmake_build_type;
+            if (build_dir_.filename() == "release")
+                cmake_build_type = "Release";
+            else if (build_dir_.filename() == "debug")
+                cmake_build_type = "Debug";
+
+            BuildEdge configure;
+            configure.rule = "configure_external";
+            configure.outputs = { target.cache_file };
+            configure.inputs = { target.source_file };
+            configure.command = join({ "cmake -B", target.build_path, "-S", target.source_path, "-G Ninja", join(target.args), "-DCMAKE_BUILD_TYPE=" + cmake_build_type });
+            configure.description = "Configuring external project";
+            graph_.edges.push_back(std::move(configure));
+
+            BuildEdge build;
+            build.rule = "build_external";
+            build.outputs = { target.outputs[0] };
+            build.inputs = { target.cache_file };
+            build.command = join({ "ninja -C", target.build_path });
+            build.description = "Building external project";
+            graph_.edges.push_back(std::move(build));
+        }
+
+        void NativeBackend::add_edge(const LinkTarget& target) {
+            const bool msvc = compiler_ == muuk::Compiler::MSVC;
+
+            BuildEdge edge;
+            edge.outputs = { target.output };
+            edge.inputs = target.inputs;
+            edge.description = "Linking " + target.output;
+
+            // Objects and link flags, in a response file for large executables
+            const auto operands = spill(edge, target.link_type == BuildLinkType::STATIC
+                    ? join(target.inputs)
+                    : join({ join(target.inputs), join(target.flags) }));
+
+            switch (target.link_type) {
+            case BuildLinkType::STATIC:
+                edge.rule = "archive";
+                edge.description = "Archiving " + target.output;
+                edge.command = msvc
+                    ? join({ archiver_, "/OUT:" + target.output, operands, profile_aflags_ })
+                    : join({ archiver_, "rcs", target.output, operands, profile_aflags_ });
+                break;
+
+            case BuildLinkType::SHARED:
+                edge.rule = "link_shared";
+                edge.description = "Linking shared library " + target.output;
+                edge.command = msvc
+                    ? join({ command_launcher_, linker_, operands, "/DLL /OUT:" + target.output, profile_lflags_ })
+                    : join({ command_launcher_, compiler_.to_string(), "-shared", operands, "-o", target.output, profile_lflags_ });
+                break;
+
+            case BuildLinkType::EXECUTABLE:
+            default:
+                edge.rule = "link";
+                edge.command = msvc
+                    ? join({ command_launcher_, linker_, operands, "/OUT:" + target.output, profile_lflags_ })
+                    : join({ command_launcher_, linker_, operands, "-o", target.output, profile_lflags_ });
+                break;
+            }
+
+            if (target.link_type != BuildLinkType::STATIC)
+                edge.pool = graph_.pools.contains(LTO_LINK_POOL) ? LTO_LINK_POOL : LINK_POOL;
+
+            if (!msvc && !dwp_.empty() && target.link_type != BuildLinkType::STATIC)
+                edge.command += " && " + join({ dwp_, "-e", target.output, "-o", target.output + ".dwp" });
+
+            graph_.edges.push_back(std::move(edge));
+
+            const auto fdata = profile_ && target.link_type == BuildLinkType::EXECUTABLE ? pgo::bolt_profile(*profile_, target.output) : "";
+            if (!fdata.empty()) {
+                BuildEdge bolt;
+                bolt.rule = "bolt";
+                bolt.outputs = { target.output + ".bolt" };
+                bolt.inputs = { target.output };
+                bolt.implicit_inputs = { fdata };
+                bolt.command = pgo::bolt_command(target.output, target.output + ".bolt", fdata);
+                bolt.description = "Optimizing the layout of " + target.output;
+                bolt.pool = LINK_POOL;
+                graph_.edges.push_back(std::move(bolt));
+            }
+        }
+
+        Result<ExecutorStats> NativeBackend::execute(const std::string& target, size_t jobs) {
+            ExecutorOptions options;
+            options.jobs = jobs;
+            if (!target.empty())
+                options.targets.push_back(target);
+
+            Executor executor(build_dir_, graph_);
+            return executor.run(options);
+        }
+    } // namespace build
+} // namespace muuk
@@ -1,12 +1,17 @@
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
+#include <map>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "build/backend.hpp"
 #include "build/manager.hpp"
 #include "build/parser.hpp"
+#include "build/pgo.hpp"
 #include "build/targets.hpp"
 #include "logger.hpp"
 #include "util.hpp"
@@ -37,6 +42,22 @@ namespace muuk {
 
             spdlog::default_logger()->flush();
 
+            profile_ = build_manager.get_profile(profile);
+            generated_headers_ = build_manager.get_generated_headers();
+
+            NativeBackend graph_backend(build_manager, compiler_, archiver_, linker_);
+            graph_backend.build_graph(profile);
+
+            priorities_.clear();
+            pools_.clear();
+            pool_depths_ = graph_backend.graph().pools;
+            for (const auto& edge : graph_backend.graph().edges)
+                for (const auto& output : edge.outputs) {
+                    priorities_[output] = edge.priority;
+                    if (pool_depths_.contains(edge.pool))
+                        pools_[output] = edge.pool;
+                }
+
             const std::string ninja_file_ = (build_dir_ / "build.ninja").string();
 
             std::ostringstream output_stream;
@@ -55,9 +76,58 @@ namespace muuk {
             muuk::logger::info("Ninja build file '{}' generated successfully!", ninja_file_);
         }
 
+        /// The targets, heaviest critical path first.
+        template <typename Target>
+        static std::vector<const Target*> by_priority(
+            const std::vector<Target>& targets,
+            const std::unordered_map<std::string, double>& priorities) {
+            std::vector<const Target*> sorted;
+            for (const auto& target : targets)
+                sorted.push_back(&target);
+
+            auto priority = [&priorities](const Target* target) {
+                auto it = priorities.find(target->output);
+                return it == priorities.end() ? 0.0 : it->second;
+            };
+
+            std::stable_sort(sorted.begin(), sorted.end(), [&](const Target* a, const Target* b) {
+                return priority(a) > priority(b);
+            });
+            return sorted;
+        }
+
+        /// `rule`, or its `_rsp` variant when `operands` joined with spaces
+        /// are over `RSPFILE_THRESHOLD`. The native backend spills the same.
+        static std::string rule_for(const std::string& rule, const std::vector<std::string>& operands) {
+            size_t length = 0;
+            for (const auto& operand : operands)
+                if (!operand.empty())
+                    length += (length == 0 ? 0 : 1) + operand.size();
+            return length > RSPFILE_THRESHOLD ? rule + "_rsp" : rule;
+        }
+
+        std::string NinjaBackend::pool_binding(const std::string& output) const {
+            auto it = pools_.find(output);
+            return it == pools_.end() ? "" : "  pool = " + it->second + "\n";
+        }
+
         std::string NinjaBackend::generate_rule(const CompilationTarget& target) const {
             std::ostringstream rule;
 
+            if (target.compilation_unit_type == CompilationUnitType::Ispc) {
+                rule << "build " << target.output << " | " << target.generated_header << ": ispc "
+                     << util::file_system::escape_drive_letter(target.inputs[0]) << "\n"
+                     << "  ispc_header = " << target.generated_header << "\n";
+
+                if (!target.flags.empty()) {
+                    rule << "  cflags =";
+                    for (const auto& flag : target.flags)
+                        rule << " " << flag;
+                    rule << "\n";
+                }
+                return rule.str();
+            }
+
             const bool is_module = target.compilation_unit_type == CompilationUnitType::Module;
             std::string module_output;
             if (is_module) {
@@ -77,14 +147,16 @@ namespace muuk {
                         rule << " " << flag;
                     rule << "\n";
                 }
+                rule << pool_binding(module_output);
 
                 rule << "\n";
             }
 
+            const auto compile = rule_for("compile", target.flags);
             if (compiler_ == muuk::Compiler::Clang && is_module) {
-                rule << "build " << target.output << ": compile " << util::file_system::escape_drive_letter(module_output);
+                rule << "build " << target.output << ": " << compile << " " << util::file_system::escape_drive_letter(module_output);
             } else {
-                rule << "build " << target.output << ": compile " << util::file_system::escape_drive_letter(target.inputs[0]);
+                rule << "build " << target.output << ": " << compile << " " << util::file_system::escape_drive_letter(target.inputs[0]);
             }
 
             if (is_module)
@@ -96,6 +168,15 @@ namespace muuk {
                     rule << " ../../" << util::file_system::to_unix_path((build_dir_ / "modules" / (dep->logical_name + ".ifc")).string());
             }
 
+            if (!target.pch.empty())
+                rule << (target.dependencies.empty() ? " | " : " ") << target.pch;
+
+            if (!generated_headers_.empty()) {
+                rule << " ||";
+                for (const auto& header : generated_headers_)
+                    rule << " " << header;
+            }
+
             rule << "\n";
             if (!target.flags.empty()) {
                 rule << "  cflags =";
@@ -104,12 +185,41 @@ namespace muuk {
 
                 rule << "\n";
             }
+
+            if (!target.pch.empty()) {
+                // GCC picks up `<header>.gch` on its own when the header is force-included
+                if (compiler_ == muuk::Compiler::Clang)
+                    rule << "  pchflags = -include-pch " << target.pch << "\n";
+                else
+                    rule << "  pchflags = -include " << target.pch_header << " -Winvalid-pch\n";
+            }
+            rule << pool_binding(target.output);
+            return rule.str();
+        }
+
+        std::string NinjaBackend::generate_rule(const PrecompiledHeaderTarget& target) const {
+            std::ostringstream rule;
+            rule << "build " << target.output << ": compile_pch " << target.header << "\n";
+
+            if (!target.flags.empty()) {
+                rule << "  cflags =";
+                for (const auto& flag : target.flags)
+                    rule << " " << flag;
+                rule << "\n";
+            }
+            rule << pool_binding(target.output);
             return rule.str();
         }
 
         std::string NinjaBackend::generate_rule(const ArchiveTarget& target) const {
             std::ostringstream rule;
-            rule << "build " << target.output << ": archive";
+            std::string archive = "archive";
+            if (!target.isa_levels.empty())
+                archive = "isa_archive";
+            else if (profile_ && profile_->archives == "thin")
+                archive = "thin_archive";
+
+            rule << "build " << target.output << ": " << rule_for(archive, target.inputs);
             for (const auto& obj : target.inputs)
                 rule << " " << obj;
             rule << "\n";
@@ -120,6 +230,9 @@ namespace muuk {
                     rule << " " << flag;
                 rule << "\n";
             }
+
+            if (!target.isa_levels.empty())
+                rule << "  isa_levels = " << fmt::format("{}", fmt::join(target.isa_levels, ",")) << "\n";
             return rule.str();
         }
 
@@ -150,18 +263,22 @@ namespace muuk {
         std::string NinjaBackend::generate_rule(const LinkTarget& target) const {
             std::ostringstream rule;
 
+            auto operands = target.inputs;
+            if (target.link_type != BuildLinkType::STATIC)
+                operands.insert(operands.end(), target.flags.begin(), target.flags.end());
+
             switch (target.link_type) {
             case BuildLinkType::STATIC:
-                rule << "build " << target.output << ": archive";
+                rule << "build " << target.output << ": " << rule_for("archive", operands);
                 break;
 
             case BuildLinkType::SHARED:
-                rule << "build " << target.output << ": link_shared";
+                rule << "build " << target.output << ": " << rule_for("link_shared", operands);
                 break;
 
             case BuildLinkType::EXECUTABLE:
             default:
-                rule << "build " << target.output << ": link";
+                rule << "build " << target.output << ": " << rule_for("link", operands);
                 break;
             }
 
@@ -177,6 +294,16 @@ namespace muuk {
 
                 rule << "\n";
             }
+            rule << pool_binding(target.output);
+
+            // The BOLT-optimized binary is a separate output, the linked one
+            // stays untouched
+            if (const auto fdata = profile_ ? pgo::bolt_profile(*profile_, target.output) : "";
+                !fdata.empty() && target.link_type == BuildLinkType::EXECUTABLE)
+                rule << "build " << target.output << ".bolt: bolt " << target.output << " | " << fdata << "\n"
+                     << "  bolt_data = " << fdata << "\n"
+                     << pool_binding(target.output + ".bolt");
+
             return rule.str();
         }
 
@@ -192,7 +319,11 @@ namespace muuk {
             out << "# Toolchain Configuration\n"
                 << "cxx = " << compiler_.to_string() << "\n"
                 << "ar = " << archiver_ << "\n"
-                << "linker = " << linker_ << "\n\n";
+                << "linker = " << linker_ << "\n"
+                << "launcher = " << compiler_launcher_ << "\n"
+                << "exec = " << command_launcher_ << "\n"
+                << "muuk = " << util::process::quote(util::process::current_executable()) << "\n"
+                << "extra_cflags = " << extra_cflags_ << "\n\n";
 
             std::string module_dir = util::file_system::to_unix_path((build_dir_ / "modules/").string());
 
@@ -209,6 +340,16 @@ namespace muuk {
                 << "profile_aflags = " << profile_aflags << "\n"
                 << "profile_lflags = " << profile_lflags << "\n\n";
 
+            // Links, LTO links and heavy sources each get a bounded pool
+            // instead of sharing `-j`. The edges pick theirs in the build statements.
+            const auto* build_profile = build_manager.get_profile(profile);
+            const std::map<std::string, size_t> pools(pool_depths_.begin(), pool_depths_.end());
+            if (!pools.empty())
+                out << "# Resource Pools\n";
+            for (const auto& [name, depth] : pools)
+                out << "pool " << name << "\n"
+                    << "  depth = " << depth << "\n\n";
+
             out << "# ------------------------------------------------------------\n"
                 << "# Rules for Compiling C++ Modules\n"
                 << "# ------------------------------------------------------------\n";
@@ -219,7 +360,8 @@ namespace muuk {
                     << "  command = $cxx /std:c++20 /utf-8 /c $in /ifcOnly"
                     << " /ifcOutput "
                     << module_dir << " /ifcSearchDir "
-                    << module_dir << " $cflags $profile_cflags\n"
+                    << module_dir << " $cflags $profile_cflags /showIncludes\n"
+                    << "  deps = msvc\n"
                     << "  description = Compiling C++ module $in\n\n";
             } else if (compiler_ == muuk::Compiler::Clang) {
                 // Clang Compiler
@@ -227,13 +369,17 @@ namespace muuk {
                 out << "rule compile_module\n"
                     << "  command = $cxx -x c++-module -std=c++20 --precompile "
                     << "-fprebuilt-module-path=" << module_dir << " "
-                    << "$in -o $out $cflags $profile_cflags\n"
+                    << "$in -o $out $cflags $profile_cflags -MD -MF $out.d\n"
+                    << "  depfile = $out.d\n"
+                    << "  deps = gcc\n"
                     << "  description = Compiling C++ module $in\n\n";
             } else if (compiler_ == muuk::Compiler::GCC) {
                 // GCC Compiler
                 out << "rule compile_module\n"
                     << "  command = $cxx -std=c++20 -fmodules-ts -c $in -o $out -fmodule-output="
-                    << module_dir << " $cflags\n"
+                    << module_dir << " $cflags -MD -MF $out.d -Mno-modules\n"
+                    << "  depfile = $out.d\n"
+                    << "  deps = gcc\n"
                     << "  description = Compiling C++ module $in\n\n";
             } else {
                 muuk::logger::error("Unsupported compiler: {}", compiler_.to_string());
@@ -244,44 +390,109 @@ namespace muuk {
                 << "# Rules\n"
                 << "# ------------------------------------------------------------\n";
 
+            // Writes `name`, and `name_rsp` for the edges whose `spilled`
+            // part is over `RSPFILE_THRESHOLD`
+            auto write_rule = [&out](const std::string& name, const std::string& command, const std::string& spilled, const std::string& settings) {
+                auto rsp_command = command;
+                rsp_command.replace(rsp_command.find(spilled), spilled.size(), "@$out.rsp");
+
+                out << "rule " << name << "\n"
+                    << "  command = " << command << "\n"
+                    << settings << "\n"
+                    << "rule " << name << "_rsp\n"
+                    << "  command = " << rsp_command << "\n"
+                    << "  rspfile = $out.rsp\n"
+                    << "  rspfile_content = " << spilled << "\n"
+                    << settings << "\n";
+            };
+
             if (compiler_ == muuk::Compiler::MSVC) {
                 // MSVC (cl)
-                out << "rule compile\n"
-                    << "  command = $cxx /c $in"
-                    << " /Fo$out $profile_cflags $platform_cflags $cflags /showIncludes "
-                    << "/ifcSearchDir " << module_dir << "\n"
-                    << "  deps = msvc\n"
-                    << "  description = Compiling $in\n\n"
-
-                    << "rule archive\n"
-                    << "  command = $ar /OUT:$out $in $aflags $profile_aflags\n"
-                    << "  description = Archiving $out\n\n"
-
-                    << "rule link\n"
-                    << "  command = $linker $in /OUT:$out $lflags $profile_lflags $libraries\n"
-                    << "  description = Linking $out\n\n"
-
-                    << "rule link_shared\n"
-                    << "  command = $linker $in /DLL /OUT:$out $lflags $profile_lflags $libraries\n"
-                    << "  description = Linking shared library $out\n\n";
+                write_rule("compile",
+                    "$exec $cxx /c $in /Fo$out $profile_cflags $platform_cflags $cflags /showIncludes /ifcSearchDir " + module_dir + " $extra_cflags",
+                    "$cflags",
+                    "  deps = msvc\n"
+                    "  description = Compiling $in\n");
+
+                out << "rule ispc\n"
+                    << "  command = ispc $in -o $out -h $ispc_header $cflags -M -MF $out.d -MT $out\n"
+                    << "  depfile = $out.d\n"
+                    << "  deps = gcc\n"
+                    << "  description = Compiling ISPC kernel $in\n\n";
+
+                write_rule("archive",
+                    "$ar /OUT:$out $in $aflags $profile_aflags",
+                    "$in",
+                    "  description = Archiving $out\n");
+
+                write_rule("link",
+                    "$exec $linker $in $lflags /OUT:$out $profile_lflags $libraries",
+                    "$in $lflags",
+                    "  description = Linking $out\n");
+
+                write_rule("link_shared",
+                    "$exec $linker $in $lflags /DLL /OUT:$out $profile_lflags $libraries",
+                    "$in $lflags",
+                    "  description = Linking shared library $out\n");
 
             } else {
-                // MinGW or Clang on Windows / Unix
-                out << "rule compile\n"
-                    << "  command = $cxx -c $in -o $out $profile_cflags $platform_cflags $cflags\n"
-                    << "  description = Compiling $in\n\n"
-
-                    << "rule archive\n"
-                    << "  command = $ar rcs $out $in $aflags $profile_aflags\n"
-                    << "  description = Archiving $out\n\n"
+                // Packs the `.dwo` files of the linked objects next to the binary
+                const std::string dwp = build_profile && !build_profile->dwp.empty()
+                    ? " && " + build_profile->dwp + " -e $out -o $out.dwp"
+                    : "";
 
-                    << "rule link\n"
-                    << "  command = $linker $in -o $out $lflags $profile_lflags $libraries\n"
-                    << "  description = Linking $out\n\n"
-
-                    << "rule link_shared\n"
-                    << "  command = $cxx -shared $in -o $out $lflags $profile_lflags $libraries\n"
-                    << "  description = Linking shared library $out\n\n";
+                // MinGW or Clang on Windows / Unix
+                write_rule("compile",
+                    "$exec $launcher $cxx -c $in -o $out $profile_cflags $platform_cflags $cflags $pchflags $extra_cflags -MD -MF $out.d",
+                    "$cflags",
+                    "  depfile = $out.d\n"
+                    "  deps = gcc\n"
+                    "  description = Compiling $in\n");
+
+                write_rule("archive",
+                    "$ar rcs $out $in $aflags $profile_aflags",
+                    "$in",
+                    "  description = Archiving $out\n");
+
+                // Only the paths of the objects, rewritten from scratch since
+                // `ar` can't turn a full archive into a thin one
+                write_rule("thin_archive",
+                    "rm -f $out && $ar rcsT $out $in $aflags $profile_aflags",
+                    "$in",
+                    "  description = Archiving $out\n");
+
+                write_rule("link",
+                    "$exec $linker $in $lflags -o $out $profile_lflags $libraries" + dwp,
+                    "$in $lflags",
+                    "  description = Linking $out\n");
+
+                write_rule("link_shared",
+                    "$exec $cxx -shared $in $lflags -o $out $profile_lflags $libraries" + dwp,
+                    "$in $lflags",
+                    "  description = Linking shared library $out\n");
+
+                write_rule("isa_archive",
+                    "$muuk isa-archive --compiler $cxx --archiver $ar --levels $isa_levels -o $out -- $in",
+                    "$in",
+                    "  description = Archiving $out with runtime ISA dispatch\n");
+
+                out << "rule compile_pch\n"
+                    << "  command = $exec $cxx -x c++-header $in -o $out $profile_cflags $platform_cflags $cflags -MD -MF $out.d\n"
+                    << "  depfile = $out.d\n"
+                    << "  deps = gcc\n"
+                    << "  description = Precompiling $in\n\n"
+
+                    // One object per `--target`, merged into `$out`
+                    << "rule ispc\n"
+                    << "  command = mkdir -p $out.parts && ispc $in -o $out.parts/kernel.o -h $ispc_header $cflags -M -MF $out.d -MT $out"
+                    << " && $cxx -r -nostdlib $out.parts/*.o -o $out\n"
+                    << "  depfile = $out.d\n"
+                    << "  deps = gcc\n"
+                    << "  description = Compiling ISPC kernel $in\n\n"
+
+                    << "rule bolt\n"
+                    << "  command = " << pgo::bolt_command("$in", "$out", "$bolt_data") << "\n"
+                    << "  description = Optimizing the layout of $in\n\n";
             }
 
             std::string cmake_build_type;
@@ -308,8 +519,11 @@ namespace muuk {
             build_rules << "# ----------------------------------\n"
                         << "# Compililed Targets\n"
                         << "# ----------------------------------\n";
-            for (const auto& target : build_manager.get_compilation_targets())
-                build_rules << generate_rule(target);
+            for (const auto* target : by_priority(build_manager.get_pch_targets(), priorities_))
+                build_rules << generate_rule(*target);
+
+            for (const auto* target : by_priority(build_manager.get_compilation_targets(), priorities_))
+                build_rules << generate_rule(*target);
 
             build_rules << "\n";
 
@@ -317,8 +531,8 @@ namespace muuk {
             build_rules << "# ----------------------------------\n"
                         << "# Archived Targets\n"
                         << "# ----------------------------------\n";
-            for (const auto& target : build_manager.get_archive_targets())
-                build_rules << generate_rule(target);
+            for (const auto* target : by_priority(build_manager.get_archive_targets(), priorities_))
+                build_rules << generate_rule(*target);
 
             build_rules << "\n";
 
@@ -335,13 +549,13 @@ namespace muuk {
             build_rules << "# ----------------------------------\n"
                         << "# Link Targets\n"
                         << "# ----------------------------------\n";
-            for (const auto& target : build_manager.get_link_targets()) {
-                build_rules << generate_rule(target);
+            for (const auto* target : by_priority(build_manager.get_link_targets(), priorities_)) {
+                build_rules << generate_rule(*target);
 
                 // Generate phony alias
                 // (e.g. `muuk.exe` -> `muuk`)
-                std::string short_name = fs::path(target.output).stem().string();
-                phony_rules << "build " << short_name << ": phony " << target.output << "\n";
+                std::string short_name = fs::path(target->output).stem().string();
+                phony_rules << "build " << short_name << ": phony " << target->output << "\n";
             }
 
             build_rules << "\n"
@@ -1,5 +1,9 @@
+#include <algorithm>
 #include <filesystem>
+#include <map>
 #include <sstream>
+#include <string>
+#include <tuple>
 #include <unordered_map>
 #include <vector>
 
@@ -7,11 +11,20 @@
 #include <fmt/ranges.h>
 #include <toml.hpp>
 
+#include "build/artifacts.hpp"
+#include "build/auto_pch.hpp"
+#include "build/deps.hpp"
+#include "build/executor.hpp"
+#include "build/isa.hpp"
+#include "build/linker.hpp"
 #include "build/manager.hpp"
 #include "build/module_resolver.hpp"
 #include "build/parser.hpp"
+#include "build/pgo.hpp"
 #include "build/targets.hpp"
 #include "buildconfig.h"
+#include "cache/compiler_cache.hpp"
+#include "cache/hash.hpp"
 #include "compiler.hpp"
 #include "logger.hpp"
 #include "muuk.hpp"
@@ -24,13 +37,142 @@ namespace fs = std::filesystem;
 
 namespace muuk {
     namespace build {
+        /// Sources per unity translation unit when `unity_batch` isn't set.
+        static constexpr size_t DEFAULT_UNITY_BATCH = 16;
+
+        /// Bumped whenever the artifact key derivation changes.
+        static constexpr const char* ARTIFACT_CACHE_VERSION = "muuk-artifact-1";
+
         static constexpr std::string_view to_string(CompilationUnitType value) {
             constexpr std::array<std::string_view, static_cast<size_t>(CompilationUnitType::Count)> names = {
-                "module", "source"
+                "module", "source", "ispc"
             };
             return names.at(static_cast<size_t>(value));
         }
 
+        /// `lto = true | "fat" | "thin"`. Clang's ThinLTO keeps its cache in
+        /// `build/<profile>/thinlto-cache`, so unchanged modules aren't
+        /// optimized again on relink.
+        static Result<void> extract_lto(const std::string& profile, const toml::value& profile_entry, const muuk::Compiler compiler, BuildProfile& build_profile) {
+            std::string mode;
+            if (profile_entry.at("lto").is_boolean())
+                mode = profile_entry.at("lto").as_boolean() ? "fat" : "off";
+            else
+                mode = profile_entry.at("lto").as_string();
+
+            if (mode == "off")
+                return {};
+            if (mode != "fat" && mode != "thin")
+                return Err("Unknown 'lto' value '{}'. Expected true, false, 'fat' or 'thin'.", mode);
+
+            muuk::logger::info("{} LTO enabled for profile '{}'", mode, profile);
+            build_profile.lto_jobs = static_cast<size_t>(std::max<int64_t>(1, toml::try_find_or<int64_t>(profile_entry, "lto-jobs", 1)));
+
+            const auto partition = toml::try_find_or<std::string>(profile_entry, "lto-partition", "");
+            if (!partition.empty() && compiler.getType() != Compiler::Type::GCC)
+                muuk::logger::warn("'lto-partition' only applies to GCC.");
+
+            switch (compiler.getType()) {
+            case Compiler::Type::GCC:
+                // GCC has no ThinLTO, its default partitioned LTO is the
+                // closest. `auto` runs the partitions in parallel.
+                build_profile.cflags.push_back("-flto=auto");
+                build_profile.lflags.push_back("-flto=auto");
+                if (!partition.empty()) {
+                    if (partition != "balanced" && partition != "one" && partition != "max" && partition != "1to1" && partition != "none")
+                        return Err("Unknown 'lto-partition' value '{}'.", partition);
+                    build_profile.lflags.push_back("-flto-partition=" + partition);
+                }
+                break;
+
+            case Compiler::Type::Clang:
+                if (mode == "fat") {
+                    build_profile.cflags.push_back("-flto");
+                    build_profile.lflags.push_back("-flto");
+                    break;
+                }
+
+                build_profile.cflags.push_back("-flto=thin");
+                build_profile.lflags.push_back("-flto=thin");
+                {
+                    const auto cache_dir = "../../build/" + profile + "/thinlto-cache";
+#ifdef __APPLE__
+                    build_profile.lflags.push_back("-Wl,-cache_path_lto," + cache_dir);
+#else
+                    if (std::find(build_profile.lflags.begin(), build_profile.lflags.end(), "-fuse-ld=lld") != build_profile.lflags.end())
+                        build_profile.lflags.push_back("-Wl,--thinlto-cache-dir=" + cache_dir);
+                    else
+                        build_profile.lflags.push_back("-Wl,-plugin-opt,cache-dir=" + cache_dir);
+#endif
+                }
+                break;
+
+            case Compiler::Type::MSVC:
+                if (mode == "thin")
+                    muuk::logger::warn("MSVC has no ThinLTO, using /GL and /LTCG.");
+                build_profile.cflags.push_back("/GL");
+                build_profile.lflags.push_back("/LTCG");
+                break;
+            }
+
+            return {};
+        }
+
+        /// Split DWARF, compressed debug sections and reduced debug info for
+        /// dependencies. GCC and Clang only.
+        static Result<void> extract_debug_info(const toml::value& profile_entry, const muuk::Compiler compiler, BuildProfile& build_profile) {
+            const auto split = toml::try_find_or<std::string>(profile_entry, "split-debuginfo", "");
+            const auto compress = toml::try_find_or<std::string>(profile_entry, "compress-debug", "");
+            const auto dependencies = toml::try_find_or<std::string>(profile_entry, "dependency-debug", "");
+
+            if (split.empty() && compress.empty() && dependencies.empty())
+                return {};
+
+            if (compiler.getType() == Compiler::Type::MSVC) {
+                muuk::logger::warn("'split-debuginfo', 'compress-debug' and 'dependency-debug' are ignored for MSVC, which already keeps debug info in PDBs.");
+                return {};
+            }
+
+            if (split == "packed" || split == "unpacked") {
+                build_profile.cflags.push_back("-gsplit-dwarf");
+
+                // The index lets gdb find the `.dwo` files without reading them
+                // all. GNU ld can't build it.
+                for (const auto& flag : build_profile.lflags)
+                    if (flag == "-fuse-ld=gold" || flag == "-fuse-ld=lld" || flag == "-fuse-ld=mold") {
+                        build_profile.lflags.push_back("-Wl,--gdb-index");
+                        break;
+                    }
+
+                if (split == "packed") {
+                    if (util::command_line::command_exists("llvm-dwp"))
+                        build_profile.dwp = "llvm-dwp";
+                    else if (compiler.getType() == Compiler::Type::GCC && util::command_line::command_exists("dwp")) {
+                        // The binutils `dwp` only reads DWARF 4
+                        build_profile.dwp = "dwp";
+                        build_profile.cflags.push_back("-gdwarf-4");
+                    } else
+                        muuk::logger::warn("No 'dwp' tool was found, the split debug info will stay in '.dwo' files.");
+                }
+            } else if (!split.empty() && split != "off")
+                return Err("Unknown 'split-debuginfo' value '{}'. Expected 'off', 'unpacked' or 'packed'.", split);
+
+            if (compress == "zlib" || compress == "zstd") {
+                build_profile.cflags.push_back("-gz=" + compress);
+                build_profile.lflags.push_back("-gz=" + compress);
+            } else if (!compress.empty() && compress != "none")
+                return Err("Unknown 'compress-debug' value '{}'. Expected 'none', 'zlib' or 'zstd'.", compress);
+
+            if (dependencies == "minimal")
+                build_profile.dependency_cflags.push_back("-g1");
+            else if (dependencies == "none")
+                build_profile.dependency_cflags.push_back("-g0");
+            else if (!dependencies.empty() && dependencies != "full")
+                return Err("Unknown 'dependency-debug' value '{}'. Expected 'full', 'minimal' or 'none'.", dependencies);
+
+            return {};
+        }
+
         static Result<BuildProfile> extract_profile_flags(const std::string& profile, const muuk::Compiler compiler, const toml::value& muuk_file) {
             muuk::logger::info("Extracting profile-specific flags for profile '{}'", profile);
 
@@ -50,21 +192,6 @@ namespace muuk {
             build_profile.lflags = muuk::parse_array_as_vec(profile_entry, "lflags");
             build_profile.defines = muuk::parse_array_as_vec(profile_entry, "defines", "-D");
 
-            // --- Link Type Optimization ---
-            if (profile_entry.at("lto").as_boolean()) {
-                muuk::logger::info("LTO enabled for profile '{}'", profile);
-                switch (compiler.getType()) {
-                case Compiler::Type::GCC:
-                case Compiler::Type::Clang:
-                    build_profile.cflags.push_back("-flto");
-                    build_profile.lflags.push_back("-flto");
-                    break;
-                case Compiler::Type::MSVC:
-                    build_profile.cflags.push_back("/GL");
-                    build_profile.lflags.push_back("/LTCG");
-                    break;
-                }
-            }
 
             // --- Debug ---
             if (profile_entry.at("debug").as_boolean()) {
@@ -100,6 +227,71 @@ namespace muuk {
                 opt_lvl_from_string(profile_entry.at("opt-level").as_string()),
                 compiler.getType()));
 
+            // --- Unity Builds ---
+            if (profile_entry.contains("unity"))
+                build_profile.unity = profile_entry.at("unity").as_boolean();
+            if (profile_entry.contains("unity_batch"))
+                build_profile.unity_batch = static_cast<size_t>(profile_entry.at("unity_batch").as_integer());
+
+            // --- Linker ---
+            if (profile_entry.contains("linker")) {
+                auto linker = linker_flags(compiler, profile_entry.at("linker").as_string());
+                if (!linker)
+                    return Err(linker);
+                build_profile.lflags.insert(build_profile.lflags.end(), linker->begin(), linker->end());
+            }
+
+            // --- Code Layout ---
+            if (profile_entry.contains("layout")) {
+                const auto layout = profile_entry.at("layout").as_string();
+                if (layout != "bolt" && layout != "symbol-order")
+                    return Err("Unknown 'layout' value '{}'. Expected 'bolt' or 'symbol-order'.", layout);
+
+                if (compiler.getType() == Compiler::Type::MSVC) {
+                    muuk::logger::warn("The 'layout' setting is ignored with MSVC.");
+                } else {
+                    build_profile.layout = layout;
+
+                    // BOLT can only move functions around with relocations
+                    if (layout == "bolt")
+                        build_profile.lflags.push_back("-Wl,--emit-relocs");
+                }
+            }
+
+            // --- Resource Pools ---
+            if (profile_entry.contains("pools")) {
+                for (const auto& [name, depth] : profile_entry.at("pools").as_table()) {
+                    if (name != LINK_POOL && name != HEAVY_POOL)
+                        return Err("Unknown pool '{}' in 'pools'. Expected '{}' or '{}'.", name, LINK_POOL, HEAVY_POOL);
+                    if (!depth.is_integer() || depth.as_integer() < 1)
+                        return Err("The depth of pool '{}' must be a positive integer.", name);
+                    build_profile.pools[name] = static_cast<size_t>(depth.as_integer());
+                }
+            }
+
+            // --- Archives ---
+            if (profile_entry.contains("archives")) {
+                const auto archives = profile_entry.at("archives").as_string();
+                if (archives != "full" && archives != "thin" && archives != "none")
+                    return Err("Unknown 'archives' value '{}'. Expected 'full', 'thin' or 'none'.", archives);
+
+                if (archives == "thin" && compiler.getType() == Compiler::Type::MSVC)
+                    muuk::logger::warn("MSVC has no thin archives, building full ones.");
+                else if (archives != "full")
+                    build_profile.archives = archives;
+            }
+
+            // --- Link Time Optimization ---
+            if (auto lto = extract_lto(profile, profile_entry, compiler, build_profile); !lto)
+                return Err(lto);
+
+            // --- Debug Info ---
+            if (profile_entry.at("debug").as_boolean()) {
+                auto debug_info = extract_debug_info(profile_entry, compiler, build_profile);
+                if (!debug_info)
+                    return Err(debug_info);
+            }
+
             // --- Sanitizers ---
             if (profile_entry.contains("sanitizers") && profile_entry.at("sanitizers").is_array()) {
                 for (const auto& item : profile_entry.at("sanitizers").as_array()) {
@@ -187,6 +379,64 @@ namespace muuk {
             return extract_flags_by_key(package_table, "compiler", compiler.to_string());
         }
 
+        /// The normalized compilation flags of a `[library]` or `[build]` package.
+        static CompilationFlags get_compilation_flags(const toml::table& package_table, const muuk::Compiler compiler) {
+            auto cflags = muuk::parse_array_as_vec(package_table, "cflags");
+            auto iflags = muuk::parse_array_as_vec(package_table, "include", "-I../../");
+            auto defines = muuk::parse_array_as_vec(package_table, "defines", "-D");
+
+            // Extract platform-specific and compiler-specific flags
+            auto platform_cflags = extract_platform_flags(package_table);
+            auto compiler_cflags = extract_compiler_flags(package_table, compiler);
+
+            muuk::normalize_flags_inplace(cflags, compiler);
+            muuk::normalize_flags_inplace(iflags, compiler);
+            muuk::normalize_flags_inplace(defines, compiler);
+
+            muuk::normalize_flags_inplace(platform_cflags, compiler);
+            muuk::normalize_flags_inplace(compiler_cflags, compiler);
+
+            return {
+                cflags,
+                iflags,
+                defines,
+                platform_cflags,
+                compiler_cflags
+            };
+        }
+
+        /// Packages fetched into `deps/`, as opposed to the project's own.
+        static bool is_dependency_package(const toml::table& package_table) {
+            return util::file_system::to_unix_path(package_table.at("path").as_string()).starts_with(DEPENDENCY_FOLDER + "/");
+        }
+
+        /// A library's `isa_levels`, baseline first.
+        static Result<std::vector<std::string>> library_isa_levels(const toml::table& library_table, const muuk::Compiler compiler) {
+            const auto levels = muuk::parse_array_as_vec(library_table, "isa_levels");
+            if (levels.empty())
+                return levels;
+
+            // The dispatcher is made of ELF ifuncs
+#if defined(_WIN32) || defined(__APPLE__)
+            return Err("Runtime ISA dispatch needs ifunc support, which this platform doesn't have.");
+#endif
+            if (compiler == Compiler::MSVC)
+                return Err("Runtime ISA dispatch is not supported with MSVC.");
+
+            return isa::sort_levels(levels);
+        }
+
+        static bool matches_profile(const toml::table& package_table, const std::string& profile) {
+            if (!package_table.contains("profiles"))
+                return true;
+
+            for (const auto& p : package_table.at("profiles").as_array())
+                if (p.as_string() == profile)
+                    return true;
+
+            return false;
+        }
+
         inline std::pair<std::string, std::string> get_src_and_obj_paths(
             const toml::value& unit_entry,
             const fs::path& build_dir) {
@@ -206,6 +456,147 @@ namespace muuk {
             return { src_path, obj_path };
         }
 
+        struct UnityBatch {
+            /// Generated unity translation unit (absolute path)
+            std::string source;
+            std::string object;
+
+            /// Absolute paths of the sources it includes
+            std::vector<std::string> members;
+        };
+
+        struct UnityPlan {
+            std::vector<UnityBatch> batches;
+
+            /// Sources that are still compiled on their own
+            toml::array sources;
+        };
+
+        static bool is_cxx_source(const std::string& path) {
+            const auto ext = fs::path(path).extension().string();
+            return ext == ".cpp" || ext == ".cc" || ext == ".cxx" || ext == ".c++";
+        }
+
+        /// Splits a package's sources into unity batches. The plan only depends
+        /// on the lockfile, so archive and link targets can recompute the same
+        /// object list. Sources are bucketed by directory and sorted, so editing
+        /// a file only rebuilds its own batch.
+        static UnityPlan plan_unity_build(
+            const toml::value& package,
+            const fs::path& package_dir,
+            const fs::path& build_dir,
+            const BuildProfile* build_profile) {
+            UnityPlan plan;
+
+            if (!package.contains("sources"))
+                return plan;
+
+            const auto& sources = package.at("sources").as_array();
+
+            bool enabled = build_profile ? build_profile->unity : false;
+            size_t batch_size = build_profile && build_profile->unity_batch > 0
+                ? build_profile->unity_batch
+                : DEFAULT_UNITY_BATCH;
+
+            if (package.contains("unity"))
+                enabled = package.at("unity").as_boolean();
+            if (package.contains("unity_batch"))
+                batch_size = static_cast<size_t>(package.at("unity_batch").as_integer());
+
+            if (!enabled || batch_size < 2) {
+                plan.sources = sources;
+                return plan;
+            }
+
+            // Directory -> sources, ordered so the batches are deterministic
+            std::map<std::string, std::vector<const toml::value*>> buckets;
+
+            for (const auto& entry : sources) {
+                if (!entry.is_table() || !entry.contains("path"))
+                    continue;
+
+                const std::string raw_path = entry.at("path").as_string();
+
+                // Per-file flags can't be honoured inside a shared TU
+                const bool has_own_flags = entry.contains("cflags")
+                    && entry.at("cflags").is_array()
+                    && !entry.at("cflags").as_array().empty();
+
+                // Nor can a pool, it would hold back the whole batch
+                if (has_own_flags || entry.contains("pool") || !is_cxx_source(raw_path)) {
+                    plan.sources.push_back(entry);
+                    continue;
+                }
+
+                buckets[fs::path(raw_path).parent_path().generic_string()].push_back(&entry);
+            }
+
+            for (auto& [dir, entries] : buckets) {
+                std::sort(entries.begin(), entries.end(), [](const toml::value* a, const toml::value* b) {
+                    return a->at("path").as_string() < b->at("path").as_string();
+                });
+
+                std::string bucket_name = dir.empty() ? "root" : dir;
+                std::replace(bucket_name.begin(), bucket_name.end(), '/', '_');
+                bucket_name = util::file_system::sanitize_path(bucket_name);
+
+                for (size_t start = 0, index = 0; start < entries.size(); start += batch_size, ++index) {
+                    const size_t end = std::min(entries.size(), start + batch_size);
+
+                    if (end - start == 1) {
+                        plan.sources.push_back(*entries[start]);
+                        continue;
+                    }
+
+                    const auto unity_path = (package_dir / "unity" / (bucket_name + "_" + std::to_string(index) + ".cpp"))
+                                                .lexically_normal()
+                                                .generic_string();
+
+                    UnityBatch batch;
+                    batch.source = util::file_system::to_unix_path(fs::absolute(unity_path).string());
+                    batch.object = util::file_system::sanitize_path(
+                        util::file_system::to_unix_path(unity_path + OBJ_EXT, "../../"));
+
+                    for (size_t i = start; i < end; ++i)
+                        batch.members.push_back(get_src_and_obj_paths(*entries[i], build_dir).first);
+
+                    plan.batches.push_back(std::move(batch));
+                }
+            }
+
+            return plan;
+        }
+
+        static void write_unity_sources(const UnityPlan& plan) {
+            for (const auto& batch : plan.batches) {
+                std::ostringstream contents;
+                contents << "// Generated by muuk (unity build). Do not edit.\n";
+                for (const auto& member : batch.members)
+                    contents << "#include \"" << member << "\"\n";
+
+                util::file_system::ensure_directory_exists(fs::path(batch.source).parent_path().string());
+                util::file_system::write_if_changed(batch.source, contents.str());
+            }
+        }
+
+        /// The resource pool of a source entry. Only `heavy` is meant for
+        /// compile edges.
+        static std::string source_pool(const toml::value& entry) {
+            const auto pool = toml::try_find_or<std::string>(entry, "pool", "");
+            if (pool.empty() || pool == HEAVY_POOL)
+                return pool;
+
+            muuk::logger::warn("Unknown pool '{}' for '{}'. Expected '{}'.", pool, entry.at("path").as_string(), HEAVY_POOL);
+            return "";
+        }
+
+        static void set_pool(BuildManager& build_manager, const std::string& obj_path, const std::string& pool) {
+            if (pool.empty())
+                return;
+            if (auto* target = build_manager.find_compilation_target("output", obj_path))
+                target->pool = pool;
+        }
+
         /// Parses compilation units (modules or sources) from the TOML array
         void parse_compilation_unit(BuildManager& build_manager, const toml::array& unit_array, const CompilationUnitType compilation_unit_type, const std::filesystem::path& build_dir, const CompilationFlags compilation_flags) {
             for (const auto& unit_entry : unit_array) {
@@ -223,6 +614,7 @@ namespace muuk {
                     obj_path,
                     compilation_flags,
                     compilation_unit_type);
+                set_pool(build_manager, obj_path, source_pool(unit_entry));
 
                 // Logging
                 muuk::logger::info("Added {} compilation target: {} -> {}", to_string(compilation_unit_type), src_path, obj_path);
@@ -234,9 +626,188 @@ namespace muuk {
             }
         }
 
+        /// Compiles a library's sources once per ISA level. Each variant gets its
+        /// own objects, and LTO is left out so the archive step can rename
+        /// their symbols.
+        static void add_isa_variants(
+            BuildManager& build_manager,
+            const UnityPlan& unity,
+            const fs::path& build_dir,
+            const CompilationFlags& compilation_flags,
+            const std::vector<std::string>& levels) {
+            // Source, object and pool
+            std::vector<std::tuple<std::string, std::string, std::string>> units;
+            for (const auto& batch : unity.batches)
+                units.emplace_back(batch.source, batch.object, "");
+
+            for (const auto& source : unity.sources)
+                if (source.is_table() && source.contains("path")) {
+                    auto [src_path, obj_path] = get_src_and_obj_paths(source, build_dir);
+                    units.emplace_back(std::move(src_path), std::move(obj_path), source_pool(source));
+                }
+
+            for (const auto& level : levels) {
+                auto flags = compilation_flags;
+                flags.cflags.push_back("-march=" + level);
+                flags.cflags.push_back("-fno-lto");
+
+                for (const auto& [src_path, obj_path, pool] : units) {
+                    const auto variant = isa::variant_object(obj_path, level);
+                    build_manager.add_compilation_target(src_path, variant, flags);
+                    set_pool(build_manager, variant, pool);
+                    muuk::logger::info("Added {} compilation target: {} -> {}", level, src_path, variant);
+                }
+            }
+        }
+
+        /// Directory the `<kernel>_ispc.h` headers are generated in. It is on
+        /// the include path of every package once a library has ISPC kernels.
+        static fs::path ispc_header_dir(const fs::path& build_dir) {
+            return build_dir / "ispc";
+        }
+
+        /// Adds the `ispc` kernels of a library. ISPC dispatches between the
+        /// targets of `isa_levels` on its own, so the objects are shared by
+        /// every level.
+        static void parse_ispc_units(
+            BuildManager& build_manager,
+            const toml::table& package_table,
+            const muuk::Compiler compiler,
+            const fs::path& build_dir,
+            const CompilationFlags& compilation_flags,
+            const BuildProfile* build_profile) {
+            CompilationFlags flags;
+            flags.iflags = compilation_flags.iflags;
+            flags.defines = compilation_flags.defines;
+
+            if (compiler != Compiler::MSVC)
+                flags.cflags.push_back("--pic");
+
+            // ISPC only understands the optimization and debug flags of the profile
+            if (build_profile)
+                for (const auto& flag : build_profile->cflags)
+                    if (flag == "-g" || flag == "-O0" || flag == "-O1" || flag == "-O2" || flag == "-O3")
+                        flags.cflags.push_back(flag);
+
+            auto levels = isa::sort_levels(muuk::parse_array_as_vec(package_table, "isa_levels"));
+            if (!levels)
+                muuk::logger::warn("{} ISPC kernels are compiled for the default target.", levels.error().message);
+            else if (!levels->empty()) {
+                // The per-target objects are merged with `-r`, which MSVC doesn't have
+                if (compiler == Compiler::MSVC)
+                    levels->resize(1);
+
+                std::vector<std::string> ispc_targets;
+                for (const auto& level : *levels)
+                    ispc_targets.push_back(isa::ispc_target(level));
+                flags.cflags.push_back("--target=" + fmt::format("{}", fmt::join(ispc_targets, ",")));
+            }
+
+            util::file_system::ensure_directory_exists(ispc_header_dir(build_dir).string());
+
+            for (const auto& unit : package_table.at("ispc").as_array()) {
+                if (!unit.is_table() || !unit.contains("path"))
+                    continue;
+
+                const auto [src_path, obj_path] = get_src_and_obj_paths(unit, build_dir);
+                const auto header = util::file_system::to_unix_path(
+                    (ispc_header_dir(build_dir) / (fs::path(src_path).stem().string() + "_ispc.h")).string(),
+                    "../../");
+
+                build_manager.add_compilation_target(src_path, obj_path, flags, CompilationUnitType::Ispc);
+                if (auto* target = build_manager.find_compilation_target("output", obj_path))
+                    target->generated_header = header;
+
+                muuk::logger::info("Added ispc compilation target: {} -> {} ({})", src_path, obj_path, header);
+            }
+        }
+
+        /// The C++ translation units of a package that may share a precompiled header.
+        struct PchCandidatePackage {
+            std::string package_id;
+            fs::path package_dir;
+
+            /// Header set through the `pch` key. Empty for `--auto-pch`.
+            std::string header;
+
+            CompilationFlags compilation_flags;
+
+            /// (source, object) pairs
+            std::vector<std::pair<std::string, std::string>> units;
+        };
+
+        static bool is_c_source(const std::string& path) {
+            return fs::path(path).extension() == ".c";
+        }
+
+        /// Registers a precompiled header for each package and points its
+        /// translation units at it. Auto PCH headers are derived from the
+        /// header dependencies recorded by the previous build.
+        static void apply_precompiled_headers(BuildManager& build_manager, const muuk::Compiler compiler, const fs::path& build_dir, const std::vector<PchCandidatePackage>& packages) {
+            if (packages.empty())
+                return;
+
+            if (compiler == Compiler::MSVC) {
+                muuk::logger::warn("Precompiled headers are not supported with MSVC yet. Skipping.");
+                return;
+            }
+
+            const bool needs_deps = std::any_of(packages.begin(), packages.end(), [](const auto& package) {
+                return package.header.empty();
+            });
+
+            HeaderDependencies deps;
+            if (needs_deps)
+                deps = load_header_dependencies(build_manager, build_dir.parent_path());
+
+            const std::string pch_ext = compiler == Compiler::Clang ? ".pch" : ".gch";
+
+            for (const auto& package : packages) {
+                std::string header;
+
+                if (!package.header.empty()) {
+                    header = pch::write_pch_wrapper(package.package_dir, package.header);
+                } else {
+                    std::vector<pch::TranslationUnit> tus;
+                    for (const auto& [src_path, obj_path] : package.units) {
+                        auto it = deps.find(obj_path);
+                        if (it != deps.end())
+                            tus.push_back({ src_path, it->second });
+                    }
+
+                    header = pch::update_auto_pch(package.package_dir, tus);
+                }
+
+                if (header.empty())
+                    continue;
+
+                const auto header_path = util::file_system::to_unix_path(header, "../../");
+                const auto pch_path = header_path + pch_ext;
+
+                build_manager.add_pch_target(package.package_id, header_path, pch_path, package.compilation_flags);
+
+                for (const auto& [_, obj_path] : package.units) {
+                    auto* target = build_manager.find_compilation_target("output", obj_path);
+                    if (!target)
+                        continue;
+
+                    target->pch_header = header_path;
+                    target->pch = pch_path;
+                }
+
+                muuk::logger::info("Using precompiled header '{}' for '{}'", pch_path, package.package_id);
+            }
+        }
+
         /// Parses compilation targets from the `[library]` and `[build]` sections of the cache file.
-        void parse_compilation_targets(BuildManager& build_manager, const muuk::Compiler compiler, const std::filesystem::path& build_dir, const toml::value& muuk_file, const std::string& profile) {
+        void parse_compilation_targets(BuildManager& build_manager, const muuk::Compiler compiler, const std::filesystem::path& build_dir, const toml::value& muuk_file, const std::string& profile, const ParseOptions& options) {
             bool has_modules = false;
+            std::vector<PchCandidatePackage> pch_packages;
+
+            bool has_ispc = false;
+            if (muuk_file.contains("library"))
+                for (const auto& library : muuk_file.at("library").as_array())
+                    has_ispc = has_ispc || library.contains("ispc");
 
             for (const std::string& name : { "build", "library" }) {
                 if (!muuk_file.contains(name))
@@ -261,29 +832,23 @@ namespace muuk {
                             continue;
                     }
 
-                    // Common flags
-                    auto cflags = muuk::parse_array_as_vec(package_table, "cflags");
-                    auto iflags = muuk::parse_array_as_vec(package_table, "include", "-I../../");
-                    auto defines = muuk::parse_array_as_vec(package_table, "defines", "-D");
-
-                    // Extract platform-specific and compiler-specific flags
-                    auto platform_cflags = extract_platform_flags(package_table);
-                    auto compiler_cflags = extract_compiler_flags(package_table, compiler);
-
-                    muuk::normalize_flags_inplace(cflags, compiler);
-                    muuk::normalize_flags_inplace(iflags, compiler);
-                    muuk::normalize_flags_inplace(defines, compiler);
+                    // Dependencies restored from the artifact cache are linked as is
+                    if (name == "library") {
+                        const auto* prebuilt = build_manager.find_prebuilt_library(name + "." + package_name);
+                        if (prebuilt && prebuilt->restored)
+                            continue;
+                    }
 
-                    muuk::normalize_flags_inplace(platform_cflags, compiler);
-                    muuk::normalize_flags_inplace(compiler_cflags, compiler);
+                    auto compilation_flags = get_compilation_flags(package_table, compiler);
+                    if (has_ispc)
+                        compilation_flags.iflags.push_back("-I" + util::file_system::to_unix_path(ispc_header_dir(build_dir).string(), "../../"));
 
-                    CompilationFlags compilation_flags = {
-                        cflags,
-                        iflags,
-                        defines,
-                        platform_cflags,
-                        compiler_cflags
-                    };
+                    if (name == "library" && is_dependency_package(package_table))
+                        if (const auto* build_profile = build_manager.get_profile(profile))
+                            compilation_flags.cflags.insert(
+                                compilation_flags.cflags.end(),
+                                build_profile->dependency_cflags.begin(),
+                                build_profile->dependency_cflags.end());
 
                     // Parse Modules
                     if (package_table.contains("modules")) {
@@ -297,15 +862,84 @@ namespace muuk {
                         has_modules = true;
                     }
 
+                    if (name == "library" && package_table.contains("ispc"))
+                        parse_ispc_units(
+                            build_manager,
+                            package_table,
+                            compiler,
+                            build_dir,
+                            compilation_flags,
+                            build_manager.get_profile(profile));
+
                     // Parse Sources
                     if (package_table.contains("sources")) {
-                        auto sources = package_table.at("sources").as_array();
+                        const auto package_dir = build_dir / name / package_name;
+                        const auto unity = plan_unity_build(
+                            package,
+                            package_dir,
+                            build_dir,
+                            build_manager.get_profile(profile));
+
+                        write_unity_sources(unity);
+
+                        // A PCH only matches the `-march` it was built with, so variants go without
+                        Result<std::vector<std::string>> isa_levels = std::vector<std::string> {};
+                        if (name == "library")
+                            isa_levels = library_isa_levels(package_table, compiler);
+
+                        if (isa_levels && !isa_levels->empty()) {
+                            add_isa_variants(build_manager, unity, build_dir, compilation_flags, *isa_levels);
+                            continue;
+                        }
+
+                        for (const auto& batch : unity.batches) {
+                            build_manager.add_compilation_target(
+                                batch.source,
+                                batch.object,
+                                compilation_flags);
+
+                            muuk::logger::info("Added unity compilation target: {} -> {}", batch.source, batch.object);
+                            muuk::logger::trace("  - Sources: {}", fmt::join(batch.members, ", "));
+                        }
+
+                        const auto& sources = unity.sources;
                         parse_compilation_unit(
                             build_manager,
                             sources,
                             CompilationUnitType::Source,
                             build_dir,
                             compilation_flags);
+
+                        // Precompiled header
+                        const auto pch_header = package_table.contains("pch")
+                            ? package_table.at("pch").as_string()
+                            : std::string {};
+
+                        if (options.auto_pch || !pch_header.empty()) {
+                            PchCandidatePackage pch_package {
+                                name + "." + package_name,
+                                package_dir,
+                                pch_header,
+                                compilation_flags,
+                                {}
+                            };
+
+                            for (const auto& batch : unity.batches)
+                                pch_package.units.emplace_back(batch.source, batch.object);
+
+                            // C sources can't use a C++ PCH
+                            for (const auto& source : sources) {
+                                if (!source.is_table() || !source.contains("path"))
+                                    continue;
+
+                                auto paths = get_src_and_obj_paths(source, build_dir);
+                                if (!is_c_source(paths.first))
+                                    pch_package.units.push_back(std::move(paths));
+                            }
+
+                            if (!pch_package.units.empty())
+                                pch_packages.push_back(std::move(pch_package));
+                        }
                     }
                 }
             }
@@ -314,6 +948,8 @@ namespace muuk {
 
             if (has_modules)
                 resolve_modules(build_manager, build_dir.string());
+
+            apply_precompiled_headers(build_manager, compiler, build_dir, pch_packages);
         };
 
         /// Parse libraries from the `[library]` section of the cache file. Generates archive targets.
@@ -340,6 +976,11 @@ namespace muuk {
                         continue;
                 }
 
+                if (const auto* prebuilt = build_manager.find_prebuilt_library("library." + library_name); prebuilt && prebuilt->restored) {
+                    muuk::logger::info("Using prebuilt library '{}' from the artifact cache", prebuilt->archive);
+                    continue;
+                }
+
                 std::vector<std::string> obj_files;
 
                 auto parse_entries = [&build_dir, &obj_files](const toml::array& entries) {
@@ -361,15 +1002,55 @@ namespace muuk {
                     parse_entries(library_table.at("modules").as_array());
                 }
 
+                // ISPC kernels
+                if (library_table.contains("ispc")) {
+                    parse_entries(library_table.at("ispc").as_array());
+                }
+
+                const auto first_source = obj_files.size();
+
                 // Parse sources
                 if (library_table.contains("sources")) {
-                    parse_entries(library_table.at("sources").as_array());
+                    const auto unity = plan_unity_build(
+                        library_table,
+                        build_dir / "library" / library_name,
+                        build_dir,
+                        build_manager.get_profile(profile));
+
+                    for (const auto& batch : unity.batches)
+                        obj_files.push_back(batch.object);
+
+                    parse_entries(unity.sources);
                 }
 
                 // Parse archive flags
                 auto aflags = muuk::parse_array_as_vec(library_table.as_table(), "aflags");
                 muuk::normalize_flags_inplace(aflags, compiler);
-                build_manager.add_archive_target(lib_path, obj_files, aflags);
+
+                auto isa_levels = library_isa_levels(library_table.as_table(), compiler);
+                if (!isa_levels) {
+                    muuk::logger::warn("{} Building '{}' for the default target only.", isa_levels.error().message, library_name);
+                    isa_levels = std::vector<std::string> {};
+                }
+
+                // Modules are shared by every level
+                if (!isa_levels->empty()) {
+                    std::vector<std::string> variants(obj_files.begin(), obj_files.begin() + first_source);
+                    for (const auto& level : *isa_levels)
+                        for (size_t i = first_source; i < obj_files.size(); ++i)
+                            variants.push_back(isa::variant_object(obj_files[i], level));
+                    obj_files = std::move(variants);
+                }
+
+                // Multi-ISA libraries still need their dispatch archive
+                const auto* build_profile = build_manager.get_profile(profile);
+                if (build_profile && build_profile->archives == "none" && isa_levels->empty()) {
+                    build_manager.add_object_library(lib_path, obj_files);
+                    muuk::logger::info("Linking the objects of '{}' without an archive", lib_path);
+                    continue;
+                }
+
+                build_manager.add_archive_target(lib_path, obj_files, aflags, *isa_levels);
 
                 muuk::logger::info("Added library target: {}", lib_path);
                 muuk::logger::trace("  - Object Files: {}", fmt::join(obj_files, ", "));
@@ -499,7 +1180,16 @@ namespace muuk {
 
                 // Source → Object files
                 if (build_table.contains("sources")) {
-                    for (const auto& src : build_table.at("sources").as_array()) {
+                    const auto unity = plan_unity_build(
+                        entry,
+                        build_artifact_dir / "build" / executable_name,
+                        build_artifact_dir,
+                        build_manager.get_profile(profile_));
+
+                    for (const auto& batch : unity.batches)
+                        obj_files.push_back(batch.object);
+
+                    for (const auto& src : unity.sources) {
                         if (!src.is_table())
                             continue;
                         const auto& src_table = src.as_table();
@@ -528,7 +1218,10 @@ namespace muuk {
                             if (lib_table.contains("sources") || lib_table.contains("modules")) {
                                 const auto lib_path = util::file_system::to_unix_path(
                                     (lib_path_dir / (lib_name + LIB_EXT)).string(), "../../");
-                                libs.push_back(lib_path);
+                                if (const auto* objects = build_manager.find_object_library(lib_path))
+                                    obj_files.insert(obj_files.end(), objects->begin(), objects->end());
+                                else
+                                    libs.push_back(lib_path);
                             }
                         }
 
@@ -583,7 +1276,99 @@ namespace muuk {
                     profile_);
         }
 
-        Result<void> parse(BuildManager& build_manager, const muuk::Compiler compiler, const std::filesystem::path& build_dir, const std::string& profile) {
+        static void hash_flags(cache::Sha256& key, const std::vector<std::string>& flags) {
+            key.field(std::to_string(flags.size()));
+            for (const auto& flag : flags)
+                key.field(flag);
+        }
+
+        /// Everything that affects the contents of a dependency's archive.
+        /// Dependencies are pinned to a revision, so their sources aren't hashed.
+        static std::string library_artifact_key(
+            const toml::table& library_table,
+            const muuk::Compiler compiler,
+            const BuildProfile* build_profile,
+            const std::string& compiler_identity) {
+            cache::Sha256 key;
+            key.field(ARTIFACT_CACHE_VERSION)
+                .field(library_table.at("name").as_string())
+                .field(library_table.at("version").as_string())
+                .field(compiler_identity);
+
+            auto features = muuk::parse_array_as_vec(library_table, "features");
+            std::sort(features.begin(), features.end());
+            hash_flags(key, features);
+
+            const auto flags = get_compilation_flags(library_table, compiler);
+            hash_flags(key, flags.cflags);
+            hash_flags(key, flags.iflags);
+            hash_flags(key, flags.defines);
+            hash_flags(key, flags.platform_cflags);
+            hash_flags(key, flags.compiler_cflags);
+            hash_flags(key, muuk::parse_array_as_vec(library_table, "aflags"));
+            hash_flags(key, muuk::parse_array_as_vec(library_table, "isa_levels"));
+
+            if (build_profile) {
+                hash_flags(key, build_profile->cflags);
+                hash_flags(key, build_profile->defines);
+                hash_flags(key, build_profile->aflags);
+                hash_flags(key, build_profile->dependency_cflags);
+            }
+
+            for (const auto& source : library_table.at("sources").as_array()) {
+                if (!source.is_table() || !source.contains("path"))
+                    continue;
+
+                key.field(source.at("path").as_string());
+                hash_flags(key, muuk::parse_array_as_vec(source.as_table(), "cflags"));
+            }
+
+            return key.hex_digest();
+        }
+
+        /// Looks up the archives of the project's dependencies in the artifact
+        /// cache. Restored packages skip their compile and archive edges; the
+        /// others are stored once the build succeeds.
+        static void resolve_prebuilt_libraries(BuildManager& build_manager, const muuk::Compiler compiler, const fs::path& build_dir, const toml::value& muuk_file, const std::string& profile) {
+            if (!muuk_file.contains("library"))
+                return;
+
+            const auto compiler_identity = cache::compiler_identity(compiler.to_string());
+            const auto* build_profile = build_manager.get_profile(profile);
+
+            for (const auto& library : muuk_file.at("library").as_array()) {
+                const auto& library_table = library.as_table();
+                const auto path = util::file_system::to_unix_path(library_table.at("path").as_string());
+
+                // The project's own packages change too often to be worth sharing
+                if (!is_dependency_package(library_table))
+                    continue;
+
+                // Consumers need the module interfaces, which aren't archived
+                if (!library_table.contains("sources") || library_table.contains("modules"))
+                    continue;
+
+                if (!matches_profile(library_table, profile))
+                    continue;
+
+                const auto library_name = library_table.at("name").as_string();
+
+                PrebuiltLibrary prebuilt;
+                prebuilt.key = library_artifact_key(library_table, compiler, build_profile, compiler_identity);
+                prebuilt.archive = (build_dir / path / (library_name + LIB_EXT)).lexically_normal().generic_string();
+                prebuilt.restored = restore_prebuilt_library(prebuilt.key, prebuilt.archive);
+
+                muuk::logger::info(
+                    "Artifact cache {} for '{}' ({})",
+                    prebuilt.restored ? "hit" : "miss",
+                    library_name,
+                    prebuilt.key.substr(0, 12));
+
+                build_manager.add_prebuilt_library("library." + library_name, std::move(prebuilt));
+            }
+        }
+
+        Result<void> parse(BuildManager& build_manager, const muuk::Compiler compiler, const std::filesystem::path& build_dir, const std::string& profile, const ParseOptions& options) {
             auto result = muuk::parse_muuk_file("build/muuk.lock.toml", true);
             if (!result) {
                 return Err(result);
@@ -595,17 +1380,36 @@ namespace muuk {
                 return Err(profile_result);
             }
 
+            TRYV(pgo::add_flags(profile_result.value(), compiler, profile, options.pgo));
+
             build_manager.set_profile_flags(profile, profile_result.value());
+            if (options.pgo == pgo::Stage::Instrument)
+                build_manager.set_profile_flags(pgo::instrumented_profile(profile), profile_result.value());
 
             const auto build_artifact_dir = build_dir / MUUK_FILES;
             util::file_system::ensure_directory_exists(build_artifact_dir.string());
 
+            // The archives would depend on profile data the cache key can't see
+            const bool profiled = options.pgo == pgo::Stage::Instrument
+                || fs::exists(pgo::profile_data(compiler, profile));
+
+            // Thin archives point into this build directory, and `none` has no archives to share
+            const bool full_archives = profile_result->archives.empty();
+
+            if (options.artifact_cache && profiled)
+                muuk::logger::warn("The artifact cache is not used for profile-guided builds.");
+            else if (options.artifact_cache && !full_archives)
+                muuk::logger::warn("The artifact cache is not used with 'archives = \"{}\"'.", profile_result->archives);
+            else if (options.artifact_cache)
+                resolve_prebuilt_libraries(build_manager, compiler, build_artifact_dir, muuk_file, profile);
+
             parse_compilation_targets(
                 build_manager,
                 compiler,
                 build_artifact_dir,
                 muuk_file,
-                profile);
+                profile,
+                options);
             parse_libraries(
                 build_manager,
                 compiler,
@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "build/manager.hpp"
+#include "build/pgo.hpp"
+#include "compiler.hpp"
+#include "logger.hpp"
+#include "rustify.hpp"
+#include "util.hpp"
+
+namespace fs = std::filesystem;
+
+namespace muuk {
+    namespace build {
+        namespace pgo {
+            static const std::string PGO_DIR = "pgo";
+
+            static void replace_all(std::string& text, const std::string& from, const std::string& to) {
+                for (size_t pos = text.find(from); pos != std::string::npos; pos = text.find(from, pos + to.size()))
+                    text.replace(pos, from.size(), to);
+            }
+
+            std::string instrumented_profile(const std::string& profile) {
+                return profile + "-pgo-gen";
+            }
+
+            fs::path raw_profile_dir(const std::string& profile) {
+                return fs::absolute(fs::path("build") / instrumented_profile(profile) / "pgo-data");
+            }
+
+            fs::path profile_data(const Compiler& compiler, const std::string& profile) {
+                if (compiler == Compiler::GCC)
+                    return fs::absolute(fs::path(PGO_DIR) / (profile + "-gcc"));
+                return fs::absolute(fs::path(PGO_DIR) / (profile + ".profdata"));
+            }
+
+            fs::path symbol_order_file(const std::string& profile) {
+                return fs::absolute(fs::path(PGO_DIR) / (profile + ".order"));
+            }
+
+            fs::path bolt_profile_dir(const std::string& profile) {
+                return fs::absolute(fs::path(PGO_DIR) / (profile + "-bolt"));
+            }
+
+            /// `symbol-order` and `bolt` only apply once `muuk pgo` recorded
+            /// their data.
+            static void add_layout_flags(BuildProfile& build_profile, const std::string& profile) {
+                if (build_profile.layout == "bolt") {
+                    if (fs::exists(bolt_profile_dir(profile)))
+                        build_profile.bolt_data = bolt_profile_dir(profile).generic_string();
+                    return;
+                }
+
+                const auto order = symbol_order_file(profile);
+                if (build_profile.layout != "symbol-order" || !fs::exists(order))
+                    return;
+
+                const bool supported = std::any_of(build_profile.lflags.begin(), build_profile.lflags.end(), [](const std::string& flag) {
+                    return flag == "-fuse-ld=lld" || flag == "-fuse-ld=mold";
+                });
+                if (!supported) {
+                    muuk::logger::warn("'layout = \"symbol-order\"' needs linker = \"lld\" or \"mold\". Linking without it.");
+                    return;
+                }
+
+                // The linker orders sections, so each function needs its own
+                build_profile.cflags.push_back("-ffunction-sections");
+                build_profile.lflags.push_back("-Wl,--symbol-ordering-file=" + order.generic_string());
+                build_profile.lflags.push_back("-Wl,--no-warn-symbol-ordering");
+            }
+
+            Result<void> add_flags(BuildProfile& build_profile, const Compiler& compiler, const std::string& profile, Stage stage) {
+                if (stage == Stage::Instrument) {
+                    const auto raw = raw_profile_dir(profile).generic_string();
+
+                    if (compiler == Compiler::GCC) {
+                        // `.gcda` names are mangled from the object paths; the
+                        // prefix keeps them relative to the build directory
+                        const auto build_dir = fs::absolute(fs::path("build") / instrumented_profile(profile)).generic_string();
+                        build_profile.cflags.push_back("-fprofile-generate=" + raw);
+                        build_profile.cflags.push_back("-fprofile-prefix-path=" + build_dir);
+                        build_profile.cflags.push_back("-fprofile-update=atomic");
+                        build_profile.lflags.push_back("-fprofile-generate");
+                    } else if (compiler == Compiler::Clang) {
+                        build_profile.cflags.push_back("-fprofile-generate=" + raw);
+                        build_profile.lflags.push_back("-fprofile-generate=" + raw);
+                    } else {
+                        return Err("Profile-guided optimization needs GCC or Clang.");
+                    }
+                    return {};
+                }
+
+                add_layout_flags(build_profile, profile);
+
+                const auto data = profile_data(compiler, profile);
+                if (compiler == Compiler::MSVC || !fs::exists(data))
+                    return {};
+
+                muuk::logger::info("Optimizing '{}' with the profile in '{}'", profile, data.generic_string());
+                build_profile.cflags.push_back("-fprofile-use=" + data.generic_string());
+
+                if (compiler == Compiler::GCC) {
+                    const auto build_dir = fs::absolute(fs::path("build") / profile).generic_string();
+                    build_profile.cflags.push_back("-fprofile-prefix-path=" + build_dir);
+
+                    // A function edited since the training run is a warning,
+                    // not an error, as with Clang
+                    build_profile.cflags.push_back("-Wno-error=coverage-mismatch");
+                }
+                return {};
+            }
+
+            std::string training_command(const std::string& command, const std::string& profile) {
+                const auto instrumented = instrumented_profile(profile);
+
+                auto rewritten = command;
+                replace_all(rewritten, "build/" + profile + "/", "build/" + instrumented + "/");
+                replace_all(rewritten, "{build_dir}", fs::absolute(fs::path("build") / instrumented).generic_string());
+                return rewritten;
+            }
+
+            Result<fs::path> merge_profiles(const Compiler& compiler, const std::string& profile) {
+                const auto raw = raw_profile_dir(profile);
+                const auto data = profile_data(compiler, profile);
+                const auto extension = compiler == Compiler::GCC ? ".gcda" : ".profraw";
+
+                std::vector<fs::path> profiles;
+                std::error_code ec;
+                for (const auto& entry : fs::directory_iterator(raw, ec))
+                    if (entry.is_regular_file() && entry.path().extension() == extension)
+                        profiles.push_back(entry.path());
+
+                if (profiles.empty())
+                    return Err("The training runs wrote no '{}' files to '{}'.", extension, raw.generic_string());
+
+                fs::create_directories(data.parent_path(), ec);
+
+                if (compiler == Compiler::GCC) {
+                    // GCC already summed the runs into one file per object. The
+                    // names embed the object path, which differs in the build
+                    // that uses them.
+                    fs::remove_all(data, ec);
+                    fs::create_directories(data, ec);
+
+                    const auto from = "#build#" + instrumented_profile(profile) + "#";
+                    const auto to = "#build#" + profile + "#";
+                    for (const auto& path : profiles) {
+                        auto name = path.filename().string();
+                        replace_all(name, from, to);
+                        fs::copy_file(path, data / name, fs::copy_options::overwrite_existing, ec);
+                        if (ec)
+                            return Err("Could not copy '{}': {}", path.generic_string(), ec.message());
+                    }
+                } else {
+                    if (!util::command_line::command_exists("llvm-profdata"))
+                        return Err("'llvm-profdata' was not found. It is needed to merge Clang profiles.");
+
+                    std::vector<std::string> args = { "llvm-profdata", "merge", "-o", data.string() };
+                    for (const auto& path : profiles)
+                        args.push_back(path.string());
+
+                    const auto merged = util::process::run(args);
+                    if (!merged)
+                        return Err(merged);
+                    if (merged->exit_code != 0)
+                        return Err("llvm-profdata failed:\n{}{}", merged->out, merged->err);
+                }
+
+                muuk::logger::info("Merged {} raw profiles into '{}'.", profiles.size(), data.generic_string());
+                return data;
+            }
+
+            std::vector<std::string> hottest_functions(const std::string& profdata_show) {
+                std::vector<std::pair<std::string, uint64_t>> functions;
+
+                std::istringstream lines(profdata_show);
+                std::string name;
+                for (std::string line; std::getline(lines, line);) {
+                    const auto text = util::trim_whitespace(line);
+
+                    // Function names are the only entries indented by two
+                    if (line.starts_with("  ") && !line.starts_with("   ") && text.ends_with(":")) {
+                        name = text.substr(0, text.size() - 1);
+
+                        // Local functions are prefixed with their file
+                        if (const auto separator = name.find_last_of(";:"); separator != std::string::npos)
+                            name = name.substr(separator + 1);
+                        continue;
+                    }
+
+                    static const std::string count_label = "Function count:";
+                    if (!name.empty() && text.starts_with(count_label)) {
+                        const auto count = std::stoull(text.substr(count_label.size()));
+                        if (count > 0)
+                            functions.emplace_back(name, count);
+                        name.clear();
+                    }
+                }
+
+                std::stable_sort(functions.begin(), functions.end(), [](const auto& a, const auto& b) {
+                    return a.second > b.second;
+                });
+
+                std::vector<std::string> names;
+                for (const auto& [function, _] : functions)
+                    names.push_back(function);
+                return names;
+            }
+
+            Result<fs::path> write_symbol_order(const Compiler& compiler, const std::string& profile) {
+                if (compiler != Compiler::Clang)
+                    return Err("'layout = \"symbol-order\"' reads Clang profiles. GCC already groups hot functions in .text.hot with -fprofile-use.");
+
+                const auto shown = util::process::run({ "llvm-profdata", "show", "--all-functions", profile_data(compiler, profile).string() });
+                if (!shown)
+                    return Err(shown);
+                if (shown->exit_code != 0)
+                    return Err("llvm-profdata failed:\n{}{}", shown->out, shown->err);
+
+                const auto functions = hottest_functions(shown->out);
+                std::ostringstream order;
+                for (const auto& function : functions)
+                    order << function << "\n";
+
+                const auto path = symbol_order_file(profile);
+                util::file_system::write_if_changed(path.string(), order.str());
+                muuk::logger::info("Wrote the order of {} hot functions to '{}'.", functions.size(), path.generic_string());
+                return path;
+            }
+
+            Result<void> record_bolt_profiles(
+                const std::vector<fs::path>& executables,
+                const std::string& profile,
+                const std::function<Result<void>()>& train) {
+                for (const auto* tool : { "llvm-bolt", "merge-fdata" })
+                    if (!util::command_line::command_exists(tool))
+                        return Err("'{}' was not found. It is needed for 'layout = \"bolt\"'.", tool);
+
+                const auto raw = raw_profile_dir(profile) / "bolt";
+                std::error_code ec;
+                fs::remove_all(raw, ec);
+                fs::create_directories(raw, ec);
+
+                for (const auto& executable : executables) {
+                    const auto name = executable.filename().string();
+                    const auto instrumented = util::process::run({ "llvm-bolt",
+                        executable.string(),
+                        "-instrument",
+                        "-instrumentation-file=" + (raw / (name + ".fdata")).string(),
+                        "-instrumentation-file-append-pid",
+                        "-o",
+                        executable.string() + ".instr" });
+                    if (!instrumented)
+                        return Err(instrumented);
+                    if (instrumented->exit_code != 0)
+                        return Err("llvm-bolt could not instrument '{}':\n{}{}", executable.generic_string(), instrumented->out, instrumented->err);
+                }
+
+                // The training commands run the binaries by their usual paths
+                for (const auto& executable : executables) {
+                    fs::rename(executable, executable.string() + ".orig", ec);
+                    fs::rename(executable.string() + ".instr", executable, ec);
+                }
+
+                auto trained = train();
+
+                for (const auto& executable : executables) {
+                    fs::remove(executable, ec);
+                    fs::rename(executable.string() + ".orig", executable, ec);
+                }
+
+                if (!trained)
+                    return Err(trained);
+
+                const auto data = bolt_profile_dir(profile);
+                fs::create_directories(data, ec);
+
+                for (const auto& executable : executables) {
+                    const auto name = executable.filename().string();
+
+                    std::vector<std::string> args = { "merge-fdata" };
+                    for (const auto& entry : fs::directory_iterator(raw, ec))
+                        if (entry.path().filename().string().starts_with(name + "."))
+                            args.push_back(entry.path().string());
+
+                    if (args.size() == 1) {
+                        muuk::logger::warn("The training runs never ran '{}'.", executable.generic_string());
+                        continue;
+                    }
+
+                    const auto merged = util::process::run(args);
+                    if (!merged)
+                        return Err(merged);
+                    if (merged->exit_code != 0)
+                        return Err("merge-fdata failed:\n{}", merged->err);
+
+                    std::ofstream(data / (name + ".fdata"), std::ios::trunc) << merged->out;
+                }
+
+                muuk::logger::info("BOLT profiles written to '{}'.", data.generic_string());
+                return {};
+            }
+
+            std::string bolt_command(const std::string& input, const std::string& output, const std::string& fdata) {
+                return "llvm-bolt " + input + " -o " + output + " -data=" + fdata
+                    + " -reorder-blocks=ext-tsp -reorder-functions=hfsort -split-functions -split-all-cold -split-eh -dyno-stats";
+            }
+
+            std::string bolt_profile(const BuildProfile& build_profile, const std::string& output) {
+                if (build_profile.bolt_data.empty())
+                    return "";
+
+                const auto data = fs::path(build_profile.bolt_data) / (fs::path(output).filename().string() + ".fdata");
+                return fs::exists(data) ? data.generic_string() : "";
+            }
+
+            std::vector<std::string> stale_sources(const BuildManager& build_manager, const fs::path& data) {
+                std::vector<std::string> stale;
+
+                std::error_code ec;
+                const auto merged_at = fs::last_write_time(data, ec);
+                if (ec)
+                    return stale;
+
+                for (const auto& target : build_manager.get_compilation_targets()) {
+                    const auto modified = fs::last_write_time(target.input, ec);
+                    if (!ec && modified > merged_at)
+                        stale.push_back(target.input);
+                }
+                return stale;
+            }
+        } // namespace pgo
+    } // namespace build
+} // namespace muuk
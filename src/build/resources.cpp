@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <sys/sysctl.h>
+#include <sys/types.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+#include "build/executor.hpp"
+#include "build/resources.hpp"
+#include "buildconfig.h"
+#include "logger.hpp"
+
+namespace fs = std::filesystem;
+
+namespace muuk {
+    namespace build {
+#if defined(__linux__)
+        /// First number of a file, 0 if there is none (e.g. `max`)
+        static uint64_t read_number(const std::string& path) {
+            std::ifstream in(path);
+            uint64_t value = 0;
+            if (!(in >> value))
+                return 0;
+            return value;
+        }
+
+        /// Where `file` may be for the process's cgroup: its own directory
+        /// first (cgroup v2, or the v1 `controller` hierarchy), then the root.
+        static std::vector<std::string> cgroup_files(const std::string& v2_file, const std::string& controller, const std::string& v1_file) {
+            std::vector<std::string> candidates;
+            std::ifstream cgroup("/proc/self/cgroup");
+            for (std::string line; std::getline(cgroup, line);) {
+                if (line.starts_with("0::")) {
+                    candidates.push_back("/sys/fs/cgroup" + line.substr(3) + "/" + v2_file);
+                    continue;
+                }
+
+                // `<id>:<controllers>:<path>`, the controllers are comma separated
+                const auto first = line.find(':');
+                const auto second = line.find(':', first + 1);
+                if (first == std::string::npos || second == std::string::npos)
+                    continue;
+                const auto controllers = "," + line.substr(first + 1, second - first - 1) + ",";
+                if (controllers.find("," + controller + ",") != std::string::npos)
+                    candidates.push_back("/sys/fs/cgroup/" + line.substr(first + 1, second - first - 1) + line.substr(second + 1) + "/" + v1_file);
+            }
+
+            candidates.push_back("/sys/fs/cgroup/" + v2_file);
+            candidates.push_back("/sys/fs/cgroup/" + controller + "/" + v1_file);
+            return candidates;
+        }
+
+        /// `memory.max` (cgroup v2) or `memory.limit_in_bytes` (v1) of the
+        /// process's cgroup, 0 when unlimited
+        static uint64_t cgroup_memory_limit() {
+            // v1 reports "no limit" as a huge page-aligned number
+            for (const auto& path : cgroup_files("memory.max", "memory", "memory.limit_in_bytes"))
+                if (const auto limit = read_number(path); limit > 0 && limit < (uint64_t(1) << 60))
+                    return limit;
+            return 0;
+        }
+
+        /// CPUs granted by `cpu.max` (cgroup v2) or the CFS quota (v1),
+        /// rounded up. 0 when unlimited.
+        static size_t cgroup_cpu_limit() {
+            for (const auto& path : cgroup_files("cpu.max", "cpu", "cpu.cfs_quota_us")) {
+                std::ifstream in(path);
+                std::string quota;
+                if (!(in >> quota))
+                    continue;
+
+                int64_t period = 0;
+                if (path.ends_with("cpu.max"))
+                    in >> period;
+                else
+                    std::ifstream(path.substr(0, path.size() - 8) + "period_us") >> period;
+
+                // `max` or `-1` means no quota
+                if (quota == "max" || quota.starts_with("-") || period <= 0)
+                    return 0;
+                const auto quota_us = std::strtoll(quota.c_str(), nullptr, 10);
+                if (quota_us > 0)
+                    return static_cast<size_t>((quota_us + period - 1) / period);
+            }
+            return 0;
+        }
+
+        /// A `/proc/meminfo` field, in KiB
+        static uint64_t meminfo_kb(const std::string& field) {
+            std::ifstream meminfo("/proc/meminfo");
+            for (std::string line; std::getline(meminfo, line);) {
+                if (!line.starts_with(field + ":"))
+                    continue;
+                std::istringstream fields(line.substr(field.size() + 1));
+                uint64_t kib = 0;
+                fields >> kib;
+                return kib;
+            }
+            return 0;
+        }
+#endif
+
+        size_t total_memory_mb() {
+            uint64_t bytes = 0;
+#ifdef _WIN32
+            MEMORYSTATUSEX status {};
+            status.dwLength = sizeof(status);
+            if (GlobalMemoryStatusEx(&status))
+                bytes = status.ullTotalPhys;
+#elif defined(__APPLE__)
+            size_t size = sizeof(bytes);
+            if (sysctlbyname("hw.memsize", &bytes, &size, nullptr, 0) != 0)
+                bytes = 0;
+#elif defined(__linux__)
+            bytes = meminfo_kb("MemTotal") * 1024;
+            if (const auto limit = cgroup_memory_limit(); limit > 0 && (bytes == 0 || limit < bytes))
+                bytes = limit;
+#endif
+            return static_cast<size_t>(bytes / (1024 * 1024));
+        }
+
+        size_t available_memory_mb() {
+#ifdef _WIN32
+            MEMORYSTATUSEX status {};
+            status.dwLength = sizeof(status);
+            if (GlobalMemoryStatusEx(&status))
+                return static_cast<size_t>(status.ullAvailPhys / (1024 * 1024));
+            return 0;
+#elif defined(__linux__)
+            uint64_t bytes = meminfo_kb("MemAvailable") * 1024;
+            if (const auto limit = cgroup_memory_limit(); limit > 0 && (bytes == 0 || limit < bytes))
+                bytes = limit;
+            return bytes > 0 ? static_cast<size_t>(bytes / (1024 * 1024)) : total_memory_mb();
+#else
+            return total_memory_mb();
+#endif
+        }
+
+        size_t available_cpus() {
+            size_t cpus = std::thread::hardware_concurrency();
+#if defined(__linux__)
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (sched_getaffinity(0, sizeof(set), &set) == 0)
+                cpus = static_cast<size_t>(CPU_COUNT(&set));
+            if (const auto limit = cgroup_cpu_limit(); limit > 0)
+                cpus = std::min(cpus, limit);
+#endif
+            return std::max<size_t>(1, cpus);
+        }
+
+        size_t compile_memory_mb(const fs::path& build_dir) {
+            BuildLog build_log;
+            build_log.load(build_dir / BUILD_LOG_FILE);
+
+            std::vector<long> peaks;
+            for (const auto& [output, entry] : build_log.entries())
+                if (entry.max_rss_kb > 0 && output.ends_with(OBJ_EXT))
+                    peaks.push_back(entry.max_rss_kb);
+            if (peaks.empty())
+                return 0;
+
+            // The outliers are what the `heavy` pool is for
+            const auto percentile = peaks.begin() + static_cast<std::ptrdiff_t>(peaks.size() * 9 / 10);
+            std::nth_element(peaks.begin(), percentile, peaks.end());
+            return static_cast<size_t>((*percentile + 1023) / 1024);
+        }
+
+        size_t jobs_within(size_t cpus, size_t memory_mb, size_t job_memory_mb) {
+            if (memory_mb == 0 || job_memory_mb == 0)
+                return std::max<size_t>(1, cpus);
+            return std::max<size_t>(1, std::min(cpus, memory_mb / job_memory_mb));
+        }
+
+        size_t auto_jobs(const fs::path& build_dir) {
+            const auto cpus = available_cpus();
+            const auto memory = available_memory_mb();
+
+            auto job_memory = compile_memory_mb(build_dir);
+            const bool observed = job_memory > 0;
+            if (!observed)
+                job_memory = COMPILE_JOB_MEMORY_MB;
+
+            const auto jobs = jobs_within(cpus, memory, job_memory);
+            muuk::logger::info(
+                "Running {} jobs: {} CPUs, {} MiB of memory available, {} MiB per compile ({})",
+                jobs,
+                cpus,
+                memory,
+                job_memory,
+                observed ? "observed" : "assumed");
+            return jobs;
+        }
+
+        size_t pool_depth(size_t memory_mb, size_t job_memory_mb) {
+            if (memory_mb == 0 || job_memory_mb == 0)
+                return 0;
+            return std::max<size_t>(1, memory_mb / job_memory_mb);
+        }
+
+        std::unordered_map<std::string, size_t> resource_pools(const BuildProfile* build_profile, size_t memory_mb) {
+            std::unordered_map<std::string, size_t> pools = {
+                { LINK_POOL, pool_depth(memory_mb, LINK_JOB_MEMORY_MB) },
+                { HEAVY_POOL, pool_depth(memory_mb, HEAVY_JOB_MEMORY_MB) },
+            };
+
+            if (build_profile) {
+                if (build_profile->lto_jobs > 0)
+                    pools[LTO_LINK_POOL] = build_profile->lto_jobs;
+                for (const auto& [name, depth] : build_profile->pools)
+                    pools[name] = depth;
+            }
+
+            std::erase_if(pools, [](const auto& pool) { return pool.second == 0; });
+            return pools;
+        }
+    } // namespace build
+} // namespace muuk
@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "build/stats.hpp"
+#include "rustify.hpp"
+#include "util.hpp"
+
+namespace fs = std::filesystem;
+
+namespace muuk {
+    namespace build {
+        static constexpr uint8_t STATS_VERSION = 1;
+
+        template <typename T>
+        static void put(std::string& out, T value) {
+            const auto bits = static_cast<std::make_unsigned_t<T>>(value);
+            for (size_t i = 0; i < sizeof(T); ++i)
+                out += static_cast<char>((bits >> (8 * i)) & 0xff);
+        }
+
+        static void put_string(std::string& out, const std::string& value) {
+            const auto size = std::min<size_t>(value.size(), UINT16_MAX);
+            put<uint16_t>(out, static_cast<uint16_t>(size));
+            out.append(value, 0, size);
+        }
+
+        /// Reads little endian values off the front of a record
+        class Reader {
+            const std::string& data_;
+            size_t pos_;
+
+        public:
+            Reader(const std::string& data, size_t pos) :
+                data_(data), pos_(pos) { }
+
+            size_t pos() const { return pos_; }
+
+            template <typename T>
+            bool get(T& value) {
+                if (data_.size() - pos_ < sizeof(T))
+                    return false;
+                std::make_unsigned_t<T> bits = 0;
+                for (size_t i = 0; i < sizeof(T); ++i)
+                    bits |= static_cast<std::make_unsigned_t<T>>(static_cast<uint8_t>(data_[pos_ + i])) << (8 * i);
+                value = static_cast<T>(bits);
+                pos_ += sizeof(T);
+                return true;
+            }
+
+            bool get_string(std::string& value) {
+                uint16_t size = 0;
+                if (!get(size) || data_.size() - pos_ < size)
+                    return false;
+                value = data_.substr(pos_, size);
+                pos_ += size;
+                return true;
+            }
+        };
+
+        std::string encode_stats(const CommandStats& stats) {
+            std::string record;
+            put<uint8_t>(record, STATS_VERSION);
+            put<int32_t>(record, stats.exit_code);
+            put<int64_t>(record, stats.wall_ms);
+            put<int64_t>(record, stats.user_ms);
+            put<int64_t>(record, stats.sys_ms);
+            put<int64_t>(record, stats.max_rss_kb);
+            put<int64_t>(record, stats.in_blocks);
+            put<int64_t>(record, stats.out_blocks);
+            put_string(record, stats.tool);
+            put_string(record, stats.output);
+            return record;
+        }
+
+        std::vector<CommandStats> decode_stats(const std::string& contents) {
+            std::vector<CommandStats> records;
+            Reader reader(contents, 0);
+
+            while (reader.pos() < contents.size()) {
+                CommandStats stats;
+                uint8_t version = 0;
+                if (!reader.get(version) || version != STATS_VERSION)
+                    break;
+
+                const bool complete = reader.get(stats.exit_code)
+                    && reader.get(stats.wall_ms)
+                    && reader.get(stats.user_ms)
+                    && reader.get(stats.sys_ms)
+                    && reader.get(stats.max_rss_kb)
+                    && reader.get(stats.in_blocks)
+                    && reader.get(stats.out_blocks)
+                    && reader.get_string(stats.tool)
+                    && reader.get_string(stats.output);
+                if (!complete)
+                    break;
+
+                records.push_back(std::move(stats));
+            }
+
+            return records;
+        }
+
+        std::vector<CommandStats> latest_stats(const std::vector<CommandStats>& records) {
+            std::unordered_map<std::string, size_t> last;
+            for (size_t i = 0; i < records.size(); ++i)
+                last[records[i].output] = i;
+
+            std::vector<CommandStats> latest;
+            for (size_t i = 0; i < records.size(); ++i)
+                if (last.at(records[i].output) == i)
+                    latest.push_back(records[i]);
+            return latest;
+        }
+
+        std::vector<CommandStats> load_stats(const fs::path& file) {
+            std::ifstream in(file, std::ios::binary);
+            std::ostringstream contents;
+            contents << in.rdbuf();
+            return decode_stats(contents.str());
+        }
+
+        void compact_stats(const fs::path& file) {
+            if (!fs::exists(file))
+                return;
+
+            std::string contents;
+            for (const auto& stats : latest_stats(load_stats(file)))
+                contents += encode_stats(stats);
+            std::ofstream(file, std::ios::binary | std::ios::trunc) << contents;
+        }
+
+        std::pair<std::string, std::string> describe_command(const std::vector<std::string>& command) {
+            if (command.empty())
+                return {};
+
+            size_t tool = 0;
+            if (command.size() > 1 && command[1] == "cc-wrap") {
+                auto separator = std::find(command.begin(), command.end(), "--");
+                tool = separator == command.end() ? 2 : static_cast<size_t>(separator - command.begin()) + 1;
+            }
+
+            std::string output;
+            for (size_t i = tool; i < command.size(); ++i) {
+                const auto& arg = command[i];
+                if (arg == "-o" && i + 1 < command.size())
+                    output = command[++i];
+                else if (arg.starts_with("/Fo") || arg.starts_with("-Fo"))
+                    output = arg.substr(3);
+                else if (arg.starts_with("/OUT:") || arg.starts_with("-OUT:"))
+                    output = arg.substr(5);
+            }
+
+            return { output, tool < command.size() ? fs::path(command[tool]).filename().string() : "" };
+        }
+
+        Result<int> exec(const fs::path& stats_file, const std::vector<std::string>& command) {
+            if (command.empty())
+                return Err("No command given");
+
+            const auto start = std::chrono::steady_clock::now();
+            const auto output = util::process::run(command);
+            if (!output)
+                return Err(output);
+            const auto end = std::chrono::steady_clock::now();
+
+            std::fwrite(output->out.data(), 1, output->out.size(), stdout);
+            std::fwrite(output->err.data(), 1, output->err.size(), stderr);
+
+            CommandStats stats;
+            std::tie(stats.output, stats.tool) = describe_command(command);
+            stats.exit_code = output->exit_code;
+            stats.wall_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+            stats.user_ms = output->user_ms;
+            stats.sys_ms = output->sys_ms;
+            stats.max_rss_kb = output->max_rss_kb;
+            stats.in_blocks = output->in_blocks;
+            stats.out_blocks = output->out_blocks;
+
+            // One append per record, so concurrent edges don't interleave.
+            // The build doesn't depend on the stats, so failing to write is fine.
+            const auto record = encode_stats(stats);
+            std::ofstream file(stats_file, std::ios::binary | std::ios::app);
+            file.write(record.data(), static_cast<std::streamsize>(record.size()));
+
+            return output->exit_code;
+        }
+
+        static std::string format_ms(int64_t ms) {
+            if (ms >= 60 * 1000)
+                return fmt::format("{}m{:02}s", ms / 60000, (ms / 1000) % 60);
+            return fmt::format("{:.1f}s", static_cast<double>(ms) / 1000.0);
+        }
+
+        static std::string format_kb(int64_t kb) {
+            if (kb >= 1024 * 1024)
+                return fmt::format("{:.1f}G", static_cast<double>(kb) / (1024.0 * 1024.0));
+            if (kb >= 1024)
+                return fmt::format("{:.0f}M", static_cast<double>(kb) / 1024.0);
+            return fmt::format("{}K", kb);
+        }
+
+        static int64_t cpu_ms(const CommandStats& stats) {
+            return stats.user_ms + stats.sys_ms;
+        }
+
+        static void format_section(std::ostringstream& out, const std::string& title, const std::vector<const CommandStats*>& commands, size_t top) {
+            out << "\n"
+                << title << ":\n"
+                << fmt::format("  {:>8} {:>8} {:>8} {:>8}  {}\n", "cpu", "wall", "peak mem", "io", "output");
+
+            for (size_t i = 0; i < commands.size() && i < top; ++i) {
+                const auto& stats = *commands[i];
+                out << fmt::format(
+                    "  {:>8} {:>8} {:>8} {:>8}  {}{}\n",
+                    format_ms(cpu_ms(stats)),
+                    format_ms(stats.wall_ms),
+                    format_kb(stats.max_rss_kb),
+                    format_kb((stats.in_blocks + stats.out_blocks) / 2), // 512-byte blocks
+                    stats.output,
+                    stats.exit_code == 0 ? "" : fmt::format(" (exit {})", stats.exit_code));
+            }
+        }
+
+        std::string format_stats(const std::vector<CommandStats>& stats, size_t top) {
+            int64_t user_ms = 0, sys_ms = 0, wall_ms = 0;
+            for (const auto& command : stats) {
+                user_ms += command.user_ms;
+                sys_ms += command.sys_ms;
+                wall_ms += command.wall_ms;
+            }
+
+            std::ostringstream out;
+            out << fmt::format(
+                "{} commands: {} of CPU time ({} user, {} system), {} of command time\n",
+                stats.size(),
+                format_ms(user_ms + sys_ms),
+                format_ms(user_ms),
+                format_ms(sys_ms),
+                format_ms(wall_ms));
+
+            std::vector<const CommandStats*> by_cpu;
+            for (const auto& command : stats)
+                by_cpu.push_back(&command);
+            std::stable_sort(by_cpu.begin(), by_cpu.end(), [](const CommandStats* a, const CommandStats* b) {
+                return cpu_ms(*a) > cpu_ms(*b);
+            });
+            format_section(out, "Heaviest by CPU time (translation units worth splitting)", by_cpu, top);
+
+            auto by_memory = by_cpu;
+            std::stable_sort(by_memory.begin(), by_memory.end(), [](const CommandStats* a, const CommandStats* b) {
+                return a->max_rss_kb > b->max_rss_kb;
+            });
+            format_section(out, "Heaviest by peak memory (candidates for the `heavy` pool)", by_memory, top);
+
+            struct ToolTotals {
+                size_t commands = 0;
+                int64_t cpu_ms = 0;
+                int64_t rss_kb = 0;
+                int64_t max_rss_kb = 0;
+            };
+            std::map<std::string, ToolTotals> tools;
+            for (const auto& command : stats) {
+                auto& totals = tools[command.tool];
+                ++totals.commands;
+                totals.cpu_ms += cpu_ms(command);
+                totals.rss_kb += command.max_rss_kb;
+                totals.max_rss_kb = std::max(totals.max_rss_kb, command.max_rss_kb);
+            }
+
+            out << "\nBy tool:\n"
+                << fmt::format("  {:>8} {:>8} {:>8} {:>8}  {}\n", "commands", "cpu", "mean mem", "peak mem", "tool");
+            for (const auto& [tool, totals] : tools)
+                out << fmt::format(
+                    "  {:>8} {:>8} {:>8} {:>8}  {}\n",
+                    totals.commands,
+                    format_ms(totals.cpu_ms),
+                    format_kb(totals.rss_kb / static_cast<int64_t>(totals.commands)),
+                    format_kb(totals.max_rss_kb),
+                    tool);
+
+            return out.str();
+        }
+    } // namespace build
+} // namespace muuk
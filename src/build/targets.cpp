@@ -25,10 +25,24 @@ namespace muuk {
             compilation_unit_type = compilation_unit_type_;
         }
 
-        ArchiveTarget::ArchiveTarget(const std::string lib, const std::vector<std::string> objs, const std::vector<std::string> aflags) :
+        PrecompiledHeaderTarget::PrecompiledHeaderTarget(const std::string header_, const std::string pch, const CompilationFlags compilation_flags) :
+            BuildTarget(pch, pch) {
+            header = header_;
+            inputs = { header };
+
+            using util::array_ops::merge;
+            merge(flags, compilation_flags.cflags);
+            merge(flags, compilation_flags.iflags);
+            merge(flags, compilation_flags.defines);
+            merge(flags, compilation_flags.platform_cflags);
+            merge(flags, compilation_flags.compiler_cflags);
+        }
+
+        ArchiveTarget::ArchiveTarget(const std::string lib, const std::vector<std::string> objs, const std::vector<std::string> aflags, const std::vector<std::string> isa_levels_) :
             BuildTarget(lib, lib) {
             inputs = objs;
             flags = aflags;
+            isa_levels = isa_levels_;
         }
 
         ExternalTarget::ExternalTarget(
@@ -0,0 +1,506 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+
+#include "build/executor.hpp"
+#include "build/timings.hpp"
+#include "logger.hpp"
+#include "util.hpp"
+
+namespace fs = std::filesystem;
+
+namespace muuk {
+    namespace build {
+        std::vector<LogEntry> parse_build_log(const std::string& contents) {
+            std::vector<LogEntry> entries;
+            std::istringstream stream(contents);
+
+            // `<start>\t<end>\t<mtime>\t<output>\t<hash>...`
+            for (std::string line; std::getline(stream, line);) {
+                if (line.empty() || line[0] == '#')
+                    continue;
+
+                std::vector<std::string> fields;
+                std::istringstream columns(line);
+                for (std::string field; std::getline(columns, field, '\t');)
+                    fields.push_back(field);
+
+                if (fields.size() < 4 || fields[3].empty())
+                    continue;
+
+                LogEntry entry;
+                entry.start_ms = std::strtoll(fields[0].c_str(), nullptr, 10);
+                entry.end_ms = std::strtoll(fields[1].c_str(), nullptr, 10);
+                entry.output = fields[3];
+                entries.push_back(std::move(entry));
+            }
+
+            return entries;
+        }
+
+        static void read_durations(const fs::path& log, EdgeDurations& durations) {
+            std::ifstream in(log);
+            if (!in)
+                return;
+
+            std::stringstream contents;
+            contents << in.rdbuf();
+
+            for (const auto& entry : parse_build_log(contents.str()))
+                durations[entry.output] = std::max<int64_t>(0, entry.end_ms - entry.start_ms);
+        }
+
+        EdgeDurations load_edge_durations(const fs::path& build_dir) {
+            EdgeDurations durations;
+            read_durations(build_dir / ".ninja_log", durations);
+            read_durations(build_dir / BUILD_LOG_FILE, durations);
+            return durations;
+        }
+
+        std::vector<double> estimate_durations(const BuildGraph& graph, const EdgeDurations& durations) {
+            const auto& edges = graph.edges;
+            std::vector<double> result(edges.size(), -1.0);
+
+            std::unordered_map<std::string, std::pair<double, size_t>> per_rule;
+            double total = 0.0;
+            size_t known = 0;
+
+            for (size_t i = 0; i < edges.size(); ++i) {
+                // The slowest output of an edge is how long it took
+                for (const auto& output : edges[i].outputs)
+                    if (auto it = durations.find(output); it != durations.end())
+                        result[i] = std::max(result[i], static_cast<double>(it->second));
+
+                if (result[i] < 0)
+                    continue;
+
+                auto& [sum, count] = per_rule[edges[i].rule];
+                sum += result[i];
+                ++count;
+                total += result[i];
+                ++known;
+            }
+
+            const double fallback = known ? total / static_cast<double>(known) : 1.0;
+            for (size_t i = 0; i < edges.size(); ++i) {
+                if (result[i] >= 0)
+                    continue;
+
+                auto it = per_rule.find(edges[i].rule);
+                result[i] = it != per_rule.end()
+                    ? it->second.first / static_cast<double>(it->second.second)
+                    : fallback;
+            }
+
+            return result;
+        }
+
+        std::vector<double> critical_path_weights(const BuildGraph& graph, const std::vector<double>& durations) {
+            const auto& edges = graph.edges;
+
+            std::unordered_map<std::string, size_t> producer;
+            for (size_t i = 0; i < edges.size(); ++i)
+                for (const auto& output : edges[i].outputs)
+                    producer.emplace(output, i);
+
+            std::vector<std::vector<size_t>> consumers(edges.size());
+            for (size_t i = 0; i < edges.size(); ++i)
+                for (const auto* list : { &edges[i].inputs, &edges[i].implicit_inputs })
+                    for (const auto& input : *list)
+                        if (auto it = producer.find(input); it != producer.end() && it->second != i)
+                            consumers[it->second].push_back(i);
+
+            // Iterative post-order DFS along consumers; a cycle contributes nothing
+            enum class State { New, Visiting, Done };
+            std::vector<State> state(edges.size(), State::New);
+            std::vector<double> weights(edges.size(), 0.0);
+
+            for (size_t root = 0; root < edges.size(); ++root) {
+                if (state[root] != State::New)
+                    continue;
+
+                std::vector<std::pair<size_t, size_t>> stack = { { root, 0 } };
+                state[root] = State::Visiting;
+
+                while (!stack.empty()) {
+                    auto& [edge, next] = stack.back();
+                    if (next < consumers[edge].size()) {
+                        const auto consumer = consumers[edge][next++];
+                        if (state[consumer] == State::New) {
+                            state[consumer] = State::Visiting;
+                            stack.emplace_back(consumer, 0);
+                        }
+                        continue;
+                    }
+
+                    double heaviest = 0.0;
+                    for (const auto consumer : consumers[edge])
+                        if (state[consumer] == State::Done)
+                            heaviest = std::max(heaviest, weights[consumer]);
+
+                    weights[edge] = durations[edge] + heaviest;
+                    state[edge] = State::Done;
+                    stack.pop_back();
+                }
+            }
+
+            return weights;
+        }
+
+        void assign_priorities(BuildGraph& graph, const EdgeDurations& durations) {
+            const auto weights = critical_path_weights(graph, estimate_durations(graph, durations));
+            for (size_t i = 0; i < graph.edges.size(); ++i)
+                graph.edges[i].priority = weights[i];
+        }
+
+        std::vector<LogEntry> last_build_entries(const std::vector<LogEntry>& entries) {
+            size_t first = 0;
+            for (size_t i = 1; i < entries.size(); ++i)
+                if (entries[i].end_ms < entries[i - 1].end_ms)
+                    first = i;
+
+            return { entries.begin() + static_cast<std::ptrdiff_t>(first), entries.end() };
+        }
+
+        static bool is_link_rule(const std::string& rule) {
+            return rule == "archive" || rule == "link" || rule == "link_shared";
+        }
+
+        static bool is_compile_rule(const std::string& rule) {
+            return rule == "compile" || rule == "compile_module" || rule == "compile_pch";
+        }
+
+        TimingReport analyze_timings(const BuildGraph& graph, const std::vector<LogEntry>& entries) {
+            const auto& edges = graph.edges;
+
+            std::unordered_map<std::string, size_t> producer;
+            for (size_t i = 0; i < edges.size(); ++i)
+                for (const auto& output : edges[i].outputs)
+                    producer.emplace(output, i);
+
+            std::vector<std::vector<size_t>> consumers(edges.size());
+            for (size_t i = 0; i < edges.size(); ++i)
+                for (const auto* list : { &edges[i].inputs, &edges[i].implicit_inputs })
+                    for (const auto& input : *list)
+                        if (auto it = producer.find(input); it != producer.end() && it->second != i)
+                            consumers[it->second].push_back(i);
+
+            // An edge belongs to the first archive or binary it feeds
+            std::vector<std::string> groups(edges.size());
+            std::vector<bool> visiting(edges.size(), false);
+            std::function<const std::string&(size_t)> group_of = [&](size_t edge) -> const std::string& {
+                if (!groups[edge].empty())
+                    return groups[edge];
+
+                if (is_link_rule(edges[edge].rule) && !edges[edge].outputs.empty())
+                    return groups[edge] = fs::path(edges[edge].outputs[0]).filename().string();
+
+                visiting[edge] = true;
+                for (const auto consumer : consumers[edge])
+                    if (!visiting[consumer] && group_of(consumer) != "(other)")
+                        return groups[edge] = groups[consumer];
+
+                return groups[edge] = "(other)";
+            };
+            for (size_t i = 0; i < edges.size(); ++i)
+                group_of(i);
+
+            TimingReport report;
+
+            // One row per edge, even when it has several outputs
+            std::unordered_map<size_t, size_t> timed_edge;
+            for (const auto& entry : entries) {
+                auto it = producer.find(entry.output);
+                if (it != producer.end()) {
+                    if (timed_edge.count(it->second))
+                        continue;
+                    timed_edge[it->second] = report.edges.size();
+                }
+
+                TimedEdge timed;
+                timed.output = entry.output;
+                timed.rule = it != producer.end() ? edges[it->second].rule : "unknown";
+                timed.group = it != producer.end() ? groups[it->second] : "(other)";
+                timed.start_ms = entry.start_ms;
+                timed.end_ms = std::max(entry.start_ms, entry.end_ms);
+                report.edges.push_back(std::move(timed));
+            }
+
+            if (report.edges.empty())
+                return report;
+
+            std::vector<size_t> order(report.edges.size());
+            for (size_t i = 0; i < order.size(); ++i)
+                order[i] = i;
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                return report.edges[a].start_ms < report.edges[b].start_ms;
+            });
+
+            std::vector<size_t> position(order.size());
+            std::vector<TimedEdge> sorted;
+            for (size_t i = 0; i < order.size(); ++i) {
+                position[order[i]] = i;
+                sorted.push_back(std::move(report.edges[order[i]]));
+            }
+            report.edges = std::move(sorted);
+            for (auto& [_, index] : timed_edge)
+                index = position[index];
+
+            // Each edge takes the first lane that is free when it starts
+            std::vector<int64_t> lane_end;
+            int64_t first_start = report.edges.front().start_ms;
+            int64_t last_end = 0;
+            for (auto& edge : report.edges) {
+                auto lane = std::find_if(lane_end.begin(), lane_end.end(), [&](int64_t end) { return end <= edge.start_ms; });
+                if (lane == lane_end.end())
+                    lane = lane_end.insert(lane_end.end(), 0);
+
+                *lane = edge.end_ms;
+                edge.lane = static_cast<size_t>(lane - lane_end.begin());
+                report.total_ms += edge.end_ms - edge.start_ms;
+                last_end = std::max(last_end, edge.end_ms);
+            }
+            report.lanes = lane_end.size();
+            report.wall_ms = last_end - first_start;
+
+            // Walk back from the last edge to finish through the input that
+            // was ready last
+            std::unordered_map<size_t, size_t> graph_edge;
+            for (const auto& [edge, index] : timed_edge)
+                graph_edge[index] = edge;
+
+            size_t current = 0;
+            for (size_t i = 1; i < report.edges.size(); ++i)
+                if (report.edges[i].end_ms > report.edges[current].end_ms)
+                    current = i;
+
+            std::vector<bool> on_path(report.edges.size(), false);
+            while (!on_path[current]) {
+                on_path[current] = true;
+                report.critical_path.push_back(current);
+
+                auto it = graph_edge.find(current);
+                if (it == graph_edge.end())
+                    break;
+
+                std::optional<size_t> latest;
+                const auto& edge = edges[it->second];
+                for (const auto* list : { &edge.inputs, &edge.implicit_inputs })
+                    for (const auto& input : *list) {
+                        auto input_producer = producer.find(input);
+                        if (input_producer == producer.end())
+                            continue;
+
+                        auto timed = timed_edge.find(input_producer->second);
+                        if (timed == timed_edge.end())
+                            continue;
+
+                        if (!latest || report.edges[timed->second].end_ms > report.edges[*latest].end_ms)
+                            latest = timed->second;
+                    }
+
+                if (!latest)
+                    break;
+                current = *latest;
+            }
+            std::reverse(report.critical_path.begin(), report.critical_path.end());
+
+            constexpr int64_t BUCKETS = 200;
+            report.bucket_ms = std::max<int64_t>(1, (report.wall_ms + BUCKETS - 1) / BUCKETS);
+            report.parallelism.assign(static_cast<size_t>((report.wall_ms + report.bucket_ms - 1) / report.bucket_ms), 0.0);
+            for (const auto& edge : report.edges) {
+                const auto start = edge.start_ms - first_start;
+                const auto end = edge.end_ms - first_start;
+                for (auto bucket = start / report.bucket_ms; bucket * report.bucket_ms < end; ++bucket) {
+                    const auto overlap = std::min(end, (bucket + 1) * report.bucket_ms) - std::max(start, bucket * report.bucket_ms);
+                    report.parallelism[static_cast<size_t>(bucket)] += static_cast<double>(overlap) / static_cast<double>(report.bucket_ms);
+                }
+            }
+
+            return report;
+        }
+
+        std::string format_chrome_trace(const TimingReport& report) {
+            nlohmann::json events = nlohmann::json::array();
+            for (const auto& edge : report.edges)
+                events.push_back({
+                    { "name", edge.output },
+                    { "cat", edge.rule },
+                    { "ph", "X" },
+                    { "ts", edge.start_ms * 1000 },
+                    { "dur", (edge.end_ms - edge.start_ms) * 1000 },
+                    { "pid", 1 },
+                    { "tid", edge.lane },
+                    { "args", { { "group", edge.group } } },
+                });
+
+            nlohmann::json trace;
+            trace["traceEvents"] = events;
+            trace["displayTimeUnit"] = "ms";
+            return trace.dump(1);
+        }
+
+        static std::string escape_html(const std::string& text) {
+            std::string escaped;
+            for (const char c : text) {
+                switch (c) {
+                case '&':
+                    escaped += "&amp;";
+                    break;
+                case '<':
+                    escaped += "&lt;";
+                    break;
+                case '>':
+                    escaped += "&gt;";
+                    break;
+                case '"':
+                    escaped += "&quot;";
+                    break;
+                default:
+                    escaped += c;
+                }
+            }
+            return escaped;
+        }
+
+        static std::string format_seconds(int64_t ms) {
+            return fmt::format("{:.2f}s", static_cast<double>(ms) / 1000.0);
+        }
+
+        std::string format_timings_html(const TimingReport& report, const std::string& title) {
+            struct GroupTime {
+                int64_t compile_ms = 0;
+                int64_t link_ms = 0;
+                int64_t other_ms = 0;
+                size_t edges = 0;
+            };
+
+            std::unordered_map<std::string, GroupTime> groups;
+            for (const auto& edge : report.edges) {
+                auto& group = groups[edge.group];
+                const auto duration = edge.end_ms - edge.start_ms;
+                if (is_compile_rule(edge.rule))
+                    group.compile_ms += duration;
+                else if (is_link_rule(edge.rule))
+                    group.link_ms += duration;
+                else
+                    group.other_ms += duration;
+                ++group.edges;
+            }
+
+            std::vector<std::pair<std::string, GroupTime>> by_time(groups.begin(), groups.end());
+            std::sort(by_time.begin(), by_time.end(), [](const auto& a, const auto& b) {
+                const auto total = [](const GroupTime& time) { return time.compile_ms + time.link_ms + time.other_ms; };
+                return total(a.second) != total(b.second) ? total(a.second) > total(b.second) : a.first < b.first;
+            });
+
+            std::vector<const TimedEdge*> compiles;
+            for (const auto& edge : report.edges)
+                if (is_compile_rule(edge.rule))
+                    compiles.push_back(&edge);
+            std::stable_sort(compiles.begin(), compiles.end(), [](const TimedEdge* a, const TimedEdge* b) {
+                return a->end_ms - a->start_ms > b->end_ms - b->start_ms;
+            });
+            compiles.resize(std::min<size_t>(compiles.size(), 20));
+
+            std::ostringstream html;
+            html << "<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n"
+                 << "<title>" << escape_html(title) << "</title>\n"
+                 << "<style>\n"
+                 << "body { font-family: sans-serif; margin: 2em; }\n"
+                 << "table { border-collapse: collapse; margin-bottom: 2em; }\n"
+                 << "th, td { border: 1px solid #ccc; padding: 0.2em 0.6em; text-align: left; }\n"
+                 << "td.num { text-align: right; }\n"
+                 << "</style>\n</head>\n<body>\n"
+                 << "<h1>" << escape_html(title) << "</h1>\n";
+
+            const double parallelism = report.wall_ms
+                ? static_cast<double>(report.total_ms) / static_cast<double>(report.wall_ms)
+                : 0.0;
+            html << "<p>" << report.edges.size() << " edges in " << format_seconds(report.wall_ms)
+                 << ", " << format_seconds(report.total_ms) << " of work, "
+                 << fmt::format("{:.1f}", parallelism) << " running on average (" << report.lanes << " at most).</p>\n";
+
+            html << "<h2>Parallelism</h2>\n";
+            const double peak = std::max<double>(1.0, static_cast<double>(report.lanes));
+            constexpr int HEIGHT = 100;
+            html << "<svg width=\"" << report.parallelism.size() * 4 << "\" height=\"" << HEIGHT
+                 << "\" style=\"background: #f4f4f4\">\n";
+            for (size_t i = 0; i < report.parallelism.size(); ++i) {
+                const auto height = static_cast<int>(std::lround(report.parallelism[i] / peak * HEIGHT));
+                html << "<rect x=\"" << i * 4 << "\" y=\"" << HEIGHT - height << "\" width=\"4\" height=\"" << height
+                     << "\" fill=\"#4a7ebb\"><title>" << fmt::format("{:.1f}", report.parallelism[i]) << " at "
+                     << format_seconds(static_cast<int64_t>(i) * report.bucket_ms) << "</title></rect>\n";
+            }
+            html << "</svg>\n";
+
+            html << "<h2>Critical path</h2>\n<table>\n<tr><th>Output</th><th>Rule</th><th>Start</th><th>Duration</th></tr>\n";
+            const auto first_start = report.edges.empty() ? 0 : report.edges.front().start_ms;
+            for (const auto index : report.critical_path) {
+                const auto& edge = report.edges[index];
+                html << "<tr><td>" << escape_html(edge.output) << "</td><td>" << escape_html(edge.rule)
+                     << "</td><td class=\"num\">" << format_seconds(edge.start_ms - first_start)
+                     << "</td><td class=\"num\">" << format_seconds(edge.end_ms - edge.start_ms) << "</td></tr>\n";
+            }
+            html << "</table>\n";
+
+            html << "<h2>Targets</h2>\n<table>\n<tr><th>Target</th><th>Edges</th><th>Compile</th><th>Link</th><th>Other</th></tr>\n";
+            for (const auto& [name, time] : by_time)
+                html << "<tr><td>" << escape_html(name) << "</td><td class=\"num\">" << time.edges
+                     << "</td><td class=\"num\">" << format_seconds(time.compile_ms)
+                     << "</td><td class=\"num\">" << format_seconds(time.link_ms)
+                     << "</td><td class=\"num\">" << format_seconds(time.other_ms) << "</td></tr>\n";
+            html << "</table>\n";
+
+            html << "<h2>Slowest translation units</h2>\n<table>\n<tr><th>Output</th><th>Target</th><th>Duration</th></tr>\n";
+            for (const auto* edge : compiles)
+                html << "<tr><td>" << escape_html(edge->output) << "</td><td>" << escape_html(edge->group)
+                     << "</td><td class=\"num\">" << format_seconds(edge->end_ms - edge->start_ms) << "</td></tr>\n";
+            html << "</table>\n";
+
+            html << "<p>Open <code>trace.json</code> in <code>chrome://tracing</code> or "
+                 << "<a href=\"https://ui.perfetto.dev\">Perfetto</a> for the timeline.</p>\n"
+                 << "</body>\n</html>\n";
+            return html.str();
+        }
+
+        Result<void> write_timings_report(const BuildGraph& graph, const fs::path& build_dir, const std::string& log_file) {
+            std::ifstream in(build_dir / log_file);
+            if (!in)
+                return Err("No build log found at '{}'.", (build_dir / log_file).generic_string());
+
+            std::stringstream contents;
+            contents << in.rdbuf();
+
+            const auto report = analyze_timings(graph, last_build_entries(parse_build_log(contents.str())));
+            if (report.edges.empty()) {
+                muuk::logger::info("Nothing was built, so there are no timings to report.");
+                return {};
+            }
+
+            const auto html_path = build_dir / "timings.html";
+            const auto trace_path = build_dir / "trace.json";
+            util::file_system::write_if_changed(
+                html_path.string(),
+                format_timings_html(report, "muuk build timings: " + build_dir.generic_string()));
+            util::file_system::write_if_changed(trace_path.string(), format_chrome_trace(report));
+
+            muuk::logger::info(
+                "Build timings written to '{}' and '{}'.",
+                html_path.generic_string(),
+                trace_path.generic_string());
+            return {};
+        }
+    } // namespace build
+} // namespace muuk
@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "build/watch.hpp"
+#include "buildconfig.h"
+#include "rustify.hpp"
+
+namespace fs = std::filesystem;
+
+namespace muuk {
+    namespace build {
+#ifdef __linux__
+        /// Files whose appearance can change what the `sources` globs match
+        static bool is_source_like(const fs::path& path) {
+            static const std::unordered_set<std::string> extensions = {
+                ".c", ".cc", ".cpp", ".cxx", ".c++", ".cppm", ".ixx", ".mpp",
+                ".h", ".hh", ".hpp", ".hxx", ".inl", ".ipp", ".tpp",
+                ".ispc", ".isph"
+            };
+            return extensions.contains(path.extension().string());
+        }
+
+        Watcher::Watcher() :
+            fd_(inotify_init1(IN_CLOEXEC | IN_NONBLOCK)) { }
+
+        Watcher::~Watcher() {
+            if (fd_ >= 0)
+                close(fd_);
+        }
+
+        Result<void> Watcher::watch(const std::vector<std::string>& files) {
+            if (fd_ < 0)
+                return Err("Failed to start watching files: {}", std::strerror(errno));
+
+            std::set<std::string> dirs;
+            files_.clear();
+            for (const auto& file : files) {
+                const auto path = fs::path(file).lexically_normal();
+                files_.insert(path.generic_string());
+                dirs.insert(path.parent_path().generic_string());
+            }
+
+            // Watches that are still wanted keep their queued events
+            for (auto it = dirs_.begin(); it != dirs_.end();) {
+                if (dirs.contains(it->second)) {
+                    ++it;
+                    continue;
+                }
+                inotify_rm_watch(fd_, it->first);
+                it = dirs_.erase(it);
+            }
+
+            constexpr uint32_t mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+            for (const auto& dir : dirs) {
+                const int wd = inotify_add_watch(fd_, dir.c_str(), mask);
+                if (wd >= 0) {
+                    dirs_[wd] = dir;
+                } else if (errno == ENOSPC) {
+                    return Err("Ran out of inotify watches for {} directories. Raise fs.inotify.max_user_watches.", dirs.size());
+                }
+                // Directories removed since the last build are skipped
+            }
+
+            return {};
+        }
+
+        Result<WatchChanges> Watcher::wait(std::chrono::milliseconds quiet) {
+            if (fd_ < 0)
+                return Err("Failed to start watching files: {}", std::strerror(errno));
+
+            while (true) {
+                // Classified once the burst settles: editors and `git`
+                // remove and recreate files along the way
+                std::set<std::string> touched;
+                bool rescan = false;
+                bool directories = false;
+
+                alignas(inotify_event) char buffer[64 * 1024];
+                int timeout = -1;
+                while (true) {
+                    pollfd pfd { fd_, POLLIN, 0 };
+                    const int ready = poll(&pfd, 1, timeout);
+                    if (ready < 0) {
+                        if (errno == EINTR)
+                            continue;
+                        return Err("Failed to wait for file changes: {}", std::strerror(errno));
+                    }
+                    if (ready == 0)
+                        break;
+
+                    const auto count = read(fd_, buffer, sizeof(buffer));
+                    if (count < 0) {
+                        if (errno == EINTR || errno == EAGAIN)
+                            continue;
+                        return Err("Failed to read file changes: {}", std::strerror(errno));
+                    }
+
+                    for (ssize_t offset = 0; offset < count;) {
+                        const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                        offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+                        // Events were lost, anything may have changed
+                        if (event->mask & IN_Q_OVERFLOW) {
+                            rescan = true;
+                            continue;
+                        }
+                        if (event->mask & IN_IGNORED) {
+                            dirs_.erase(event->wd);
+                            continue;
+                        }
+
+                        const auto dir = dirs_.find(event->wd);
+                        if (dir == dirs_.end() || event->len == 0)
+                            continue;
+
+                        const auto path = (fs::path(dir->second) / event->name).generic_string();
+                        const bool added_or_removed = event->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO);
+                        if (event->mask & IN_ISDIR) {
+                            directories = directories || added_or_removed;
+                        } else if (files_.contains(path) || fs::path(path).filename() == MUUK_TOML_FILE) {
+                            touched.insert(path);
+                        } else if (added_or_removed && is_source_like(path)) {
+                            touched.insert(path);
+                        }
+                    }
+
+                    if (rescan || directories || !touched.empty())
+                        timeout = static_cast<int>(quiet.count());
+                }
+
+                WatchChanges changes;
+                changes.manifests = rescan;
+                changes.directories = rescan || directories;
+                for (const auto& path : touched) {
+                    const bool exists = fs::exists(path);
+                    if (fs::path(path).filename() == MUUK_TOML_FILE)
+                        changes.manifests = true;
+                    else if (files_.contains(path))
+                        changes.directories = changes.directories || !exists;
+                    else if (exists)
+                        changes.directories = true;
+                    else
+                        continue; // A file that came and went, e.g. a temporary
+
+                    changes.paths.push_back(path);
+                }
+
+                if (!changes.empty())
+                    return changes;
+            }
+        }
+#else
+        Watcher::Watcher() { }
+
+        Watcher::~Watcher() { }
+
+        Result<void> Watcher::watch(const std::vector<std::string>&) {
+            return Err("--watch relies on inotify and is only supported on Linux.");
+        }
+
+        Result<WatchChanges> Watcher::wait(std::chrono::milliseconds) {
+            return Err("--watch relies on inotify and is only supported on Linux.");
+        }
+#endif
+    } // namespace build
+} // namespace muuk
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <string>
+
+#include "cache/hash.hpp"
+#include "cache/http.hpp"
+#include "cache/local_cache.hpp"
+#include "commands/cache_server.hpp"
+#include "logger.hpp"
+#include "rustify.hpp"
+
+namespace muuk {
+    namespace cache {
+        static bool is_hash(const std::string& key) {
+            return key.size() == 64 && std::all_of(key.begin(), key.end(), [](char c) {
+                return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+            });
+        }
+
+        /// Answers `GET`, `HEAD` and `PUT` on `/cas/<sha256>` and `/ac/<key>`,
+        /// ignoring any path prefix (e.g. `/team/cas/<sha256>`).
+        static HttpResponse handle_request(LocalCache& store, const HttpRequest& request) {
+            auto path = request.path.substr(0, request.path.find('?'));
+
+            const auto last = path.rfind('/');
+            const auto kind_start = last == std::string::npos || last == 0 ? std::string::npos : path.rfind('/', last - 1);
+            if (kind_start == std::string::npos)
+                return { 404, {}, "" };
+
+            const auto kind = path.substr(kind_start + 1, last - kind_start - 1);
+            const auto key = path.substr(last + 1);
+
+            if ((kind != "cas" && kind != "ac") || !is_hash(key))
+                return { 404, {}, "" };
+
+            if (request.method == "GET" || request.method == "HEAD") {
+                auto contents = store.read(key, kind);
+                if (!contents)
+                    return { 404, {}, "" };
+                return { 200, { { "Content-Type", "application/octet-stream" } }, std::move(*contents) };
+            }
+
+            if (request.method == "PUT") {
+                if (kind == "cas" && sha256_hex(request.body) != key)
+                    return { 400, {}, "content does not match its hash" };
+
+                if (!store.write(key, kind, request.body))
+                    return { 500, {}, "" };
+
+                store.evict(key);
+                return { 200, {}, "" };
+            }
+
+            return { 405, { { "Allow", "GET, HEAD, PUT" } }, "" };
+        }
+    } // namespace cache
+
+    Result<void> cache_server(const CacheServerOptions& options) {
+        const auto dir = options.dir.empty() ? cache::default_cache_dir() / "server" : std::filesystem::path(options.dir);
+        const auto max_size = options.max_size ? options.max_size : cache::default_cache_size();
+
+        cache::LocalCache store(dir, max_size);
+
+        cache::HttpServer server(options.bind, options.port, options.threads, [&store](const cache::HttpRequest& request) {
+            return cache::handle_request(store, request);
+        });
+        TRYV(server.listen());
+
+        muuk::logger::info(
+            "Serving compilation cache '{}' on http://{}:{} ({} threads)",
+            dir.string(),
+            options.bind,
+            server.port(),
+            options.threads);
+
+        server.serve();
+        return {};
+    }
+} // namespace muuk
@@ -0,0 +1,476 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "build/deps.hpp"
+#include "cache/compiler_cache.hpp"
+#include "cache/hash.hpp"
+#include "cache/local_cache.hpp"
+#include "cache/remote_cache.hpp"
+#include "commands/cc_wrap.hpp"
+#include "dist/client.hpp"
+#include "rustify.hpp"
+#include "util.hpp"
+
+namespace fs = std::filesystem;
+
+namespace muuk {
+    namespace cache {
+        /// Bumped whenever the key derivation changes.
+        static constexpr const char* CACHE_VERSION = "muuk-cc-1";
+
+        /// Flags whose value is the following argument.
+        static const std::unordered_set<std::string> FLAGS_WITH_VALUE = {
+            "-o", "-MF", "-MT", "-MQ", "-include", "-include-pch", "-imacros",
+            "-I", "-isystem", "-iquote", "-idirafter", "-D", "-U", "-x",
+            "-Xclang", "-Xpreprocessor", "-Xassembler", "-arch", "-target", "--param"
+        };
+
+        /// Flags producing side outputs or changing what the command does,
+        /// which a single cached object can't reproduce.
+        static const std::unordered_set<std::string> UNCACHEABLE_FLAGS = {
+            "-E", "-S", "-M", "-MM", "-save-temps", "--coverage", "-ftest-coverage",
+            "-gsplit-dwarf", "-ftime-trace", "-ftime-report", "-fdump-tree-all"
+        };
+
+        static bool is_source_file(const std::string& arg) {
+            static const std::unordered_set<std::string> extensions = {
+                ".c", ".cc", ".cpp", ".cxx", ".c++", ".C", ".m", ".mm"
+            };
+            return extensions.contains(fs::path(arg).extension().string());
+        }
+
+        CompilerInvocation parse_invocation(const std::vector<std::string>& args) {
+            CompilerInvocation invocation;
+            invocation.args = args;
+
+            bool compile_only = false;
+            size_t sources = 0;
+
+            for (size_t i = 1; i < args.size(); ++i) {
+                const auto& arg = args[i];
+
+                // The object depends on the profile data, which isn't hashed
+                if (UNCACHEABLE_FLAGS.contains(arg) || arg.starts_with("-save-temps=") || arg.starts_with("-fprofile-use")) {
+                    invocation.reason = "uncacheable flag " + arg;
+                    return invocation;
+                }
+
+                if (arg == "-c") {
+                    compile_only = true;
+                } else if (FLAGS_WITH_VALUE.contains(arg)) {
+                    if (i + 1 >= args.size()) {
+                        invocation.reason = "missing value for " + arg;
+                        return invocation;
+                    }
+
+                    const auto& value = args[++i];
+                    if (arg == "-o")
+                        invocation.output = value;
+                    else if (arg == "-MF")
+                        invocation.depfile = value;
+                    else if (arg == "-include-pch")
+                        invocation.pch_inputs.push_back(value);
+                } else if (arg.starts_with("-o") && arg.size() > 2) {
+                    invocation.output = arg.substr(2);
+                } else if (arg.starts_with("-MF") && arg.size() > 3) {
+                    invocation.depfile = arg.substr(3);
+                } else if (arg == "-") {
+                    invocation.reason = "reads from stdin";
+                    return invocation;
+                } else if (!arg.starts_with("-") && is_source_file(arg)) {
+                    invocation.source = arg;
+                    ++sources;
+                }
+            }
+
+            if (!compile_only)
+                invocation.reason = "not a compilation (-c)";
+            else if (sources != 1)
+                invocation.reason = "expected exactly one source file";
+            else if (invocation.output.empty())
+                invocation.reason = "no output file (-o)";
+            else
+                invocation.cacheable = true;
+
+            return invocation;
+        }
+
+        std::vector<std::string> preprocessor_args(const CompilerInvocation& invocation) {
+            static const std::unordered_set<std::string> dropped = { "-c", "-MD", "-MMD", "-MP" };
+            static const std::unordered_set<std::string> dropped_with_value = { "-o", "-MF", "-MT", "-MQ" };
+
+            const auto& args = invocation.args;
+            std::vector<std::string> result = { args[0], "-E" };
+
+            for (size_t i = 1; i < args.size(); ++i) {
+                const auto& arg = args[i];
+                if (dropped.contains(arg))
+                    continue;
+                if (dropped_with_value.contains(arg)) {
+                    ++i;
+                    continue;
+                }
+                if ((arg.starts_with("-o") && arg.size() > 2) || (arg.starts_with("-MF") && arg.size() > 3))
+                    continue;
+
+                result.push_back(arg);
+                if (FLAGS_WITH_VALUE.contains(arg) && i + 1 < args.size())
+                    result.push_back(args[++i]);
+            }
+
+            return result;
+        }
+
+        std::vector<std::string> normalized_flags(const CompilerInvocation& invocation) {
+            static const std::unordered_set<std::string> dropped_with_value = { "-o", "-MF", "-MT", "-MQ" };
+
+            const auto& args = invocation.args;
+            std::vector<std::string> result;
+
+            for (size_t i = 1; i < args.size(); ++i) {
+                const auto& arg = args[i];
+                if (dropped_with_value.contains(arg)) {
+                    ++i;
+                    continue;
+                }
+                if (arg == invocation.source)
+                    continue;
+                if ((arg.starts_with("-o") && arg.size() > 2) || (arg.starts_with("-MF") && arg.size() > 3))
+                    continue;
+
+                result.push_back(arg);
+            }
+
+            return result;
+        }
+
+        std::vector<std::string> remote_compile_flags(const CompilerInvocation& invocation, bool preprocessed) {
+            static const std::unordered_set<std::string> dropped = { "-c", "-MD", "-MMD", "-MP" };
+            static const std::unordered_set<std::string> preprocessor_only = {
+                "-I", "-isystem", "-iquote", "-idirafter", "-D", "-U", "-include", "-imacros", "-x"
+            };
+
+            const auto flags = normalized_flags(invocation);
+            std::vector<std::string> result;
+
+            for (size_t i = 0; i < flags.size(); ++i) {
+                const auto& flag = flags[i];
+                if (dropped.contains(flag))
+                    continue;
+
+                if (preprocessed) {
+                    if (preprocessor_only.contains(flag)) {
+                        ++i;
+                        continue;
+                    }
+                    if (flag.starts_with("-I") || flag.starts_with("-D") || flag.starts_with("-U"))
+                        continue;
+                }
+
+                result.push_back(flag);
+                if (FLAGS_WITH_VALUE.contains(flag) && i + 1 < flags.size())
+                    result.push_back(flags[++i]);
+            }
+
+            return result;
+        }
+
+        static std::string escape_depfile_path(const std::string& path) {
+            std::string escaped;
+            for (const char c : path) {
+                if (c == ' ' || c == '#')
+                    escaped += '\\';
+                else if (c == '$')
+                    escaped += '$';
+                escaped += c;
+            }
+            return escaped;
+        }
+
+        std::string format_depfile(const std::string& target, const std::vector<std::string>& deps) {
+            std::string out = escape_depfile_path(target) + ":";
+            for (const auto& dep : deps)
+                out += " \\\n  " + escape_depfile_path(dep);
+            return out + "\n";
+        }
+
+        static std::string read_file(const fs::path& path) {
+            std::ifstream in(path, std::ios::binary);
+            return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+
+        static void forward_output(const std::string& out, const std::string& err) {
+            if (!out.empty())
+                std::fwrite(out.data(), 1, out.size(), stdout);
+            if (!err.empty())
+                std::fwrite(err.data(), 1, err.size(), stderr);
+        }
+
+        static void note(const std::string& message) {
+            if (std::getenv("MUUK_CACHE_DEBUG"))
+                fmt::print(stderr, "muuk cc-wrap: {}\n", message);
+        }
+
+        std::string compiler_identity(const std::string& compiler) {
+            auto version = util::process::run({ compiler, "--version" });
+            if (!version)
+                return compiler;
+            return compiler + "\n" + version->out + version->err;
+        }
+
+        /// Restores a cached result. Returns false if any part is missing.
+        static bool restore(const LocalCache& cache, const std::string& key, const CompilerInvocation& invocation) {
+            if (!cache.contains(key, "o"))
+                return false;
+
+            std::optional<std::string> deps;
+            if (!invocation.depfile.empty()) {
+                deps = cache.read(key, "d");
+                if (!deps)
+                    return false;
+            }
+
+            if (!cache.fetch(key, "o", invocation.output))
+                return false;
+
+            if (deps) {
+                std::vector<std::string> headers;
+                std::istringstream stream(*deps);
+                for (std::string line; std::getline(stream, line);)
+                    if (!line.empty())
+                        headers.push_back(line);
+
+                std::ofstream out(invocation.depfile, std::ios::binary | std::ios::trunc);
+                out << format_depfile(invocation.output, headers);
+            }
+
+            forward_output(cache.read(key, "stdout").value_or(""), cache.read(key, "stderr").value_or(""));
+            return true;
+        }
+
+        /// Direct mode: the result key recorded for a source, valid as long
+        /// as every header it was compiled against is unchanged.
+        static std::optional<std::string> lookup_manifest(const LocalCache& cache, const std::string& manifest_key) {
+            const auto manifest = cache.read(manifest_key, "manifest");
+            if (!manifest)
+                return std::nullopt;
+
+            std::istringstream stream(*manifest);
+            std::string result_key;
+            if (!std::getline(stream, result_key) || result_key.empty())
+                return std::nullopt;
+
+            for (std::string line; std::getline(stream, line);) {
+                const auto tab = line.find('\t');
+                if (tab == std::string::npos)
+                    return std::nullopt;
+
+                const auto hash = sha256_file(line.substr(tab + 1));
+                if (!hash || *hash != line.substr(0, tab))
+                    return std::nullopt;
+            }
+
+            return result_key;
+        }
+
+        static void record_manifest(LocalCache& cache, const std::string& manifest_key, const std::string& result_key, const std::vector<std::string>& headers) {
+            std::string manifest = result_key + "\n";
+            for (const auto& header : headers) {
+                const auto hash = sha256_file(header);
+                if (!hash)
+                    return;
+                manifest += *hash + "\t" + header + "\n";
+            }
+
+            (void)cache.write(manifest_key, "manifest", manifest);
+        }
+
+        /// The remote cache configured through the environment, if any.
+        static std::optional<RemoteCache> open_remote_cache() {
+            const auto options = remote_cache_options_from_env();
+            if (!options)
+                return std::nullopt;
+
+            auto remote = RemoteCache::connect(*options);
+            if (!remote) {
+                note(remote.error().message);
+                return std::nullopt;
+            }
+            return std::move(*remote);
+        }
+
+        /// Copies a remote entry into the local cache, the object last.
+        static bool fetch_remote(std::optional<RemoteCache>& remote, LocalCache& cache, const std::string& key) {
+            auto files = remote->fetch(key);
+            if (!files) {
+                // Don't pay for an unreachable server twice
+                note("remote cache: " + files.error().message);
+                remote.reset();
+                return false;
+            }
+
+            if (!*files || !(*files)->contains("o"))
+                return false;
+
+            for (const auto& [name, contents] : **files)
+                if (name != "o" && !cache.write(key, name, contents))
+                    return false;
+
+            return cache.write(key, "o", (**files)["o"]).has_value();
+        }
+
+        static void upload_remote(std::optional<RemoteCache>& remote, const LocalCache& cache, const std::string& key) {
+            if (!remote || remote->read_only())
+                return;
+
+            EntryFiles files;
+            for (const auto* name : { "o", "d", "stdout", "stderr" })
+                if (auto contents = cache.read(key, name))
+                    files[name] = std::move(*contents);
+
+            if (!files.contains("o"))
+                return;
+
+            if (auto uploaded = remote->upload(key, files); !uploaded)
+                note("remote cache: " + uploaded.error().message);
+        }
+
+        /// Compiles on a `muuk worker` when workers are configured, falling
+        /// back to the local compiler.
+        static Result<util::process::Output> compile(const CompilerInvocation& invocation) {
+            if (invocation.cacheable) {
+                if (const auto options = dist::dist_options_from_env()) {
+                    auto remote = dist::compile_remote(*options, invocation);
+                    if (remote)
+                        return remote;
+                    note("worker: " + remote.error().message + ", compiling locally");
+                }
+            }
+
+            return util::process::run(invocation.args);
+        }
+
+        static Result<int> run_uncached(const CompilerInvocation& invocation) {
+            auto result = compile(invocation);
+            if (!result)
+                return Err(result);
+
+            forward_output(result->out, result->err);
+            return result->exit_code;
+        }
+    } // namespace cache
+
+    Result<int> cc_wrap(const std::vector<std::string>& command) {
+        using namespace cache;
+
+        if (command.empty())
+            return Err("cc-wrap: no compiler command given");
+
+        // Flags in response files count towards the key like any other
+        const auto invocation = parse_invocation(util::process::expand_response_files(command));
+        if (!invocation.cacheable || std::getenv("MUUK_CACHE_DISABLE")) {
+            note("not cached: " + (invocation.reason.empty() ? std::string("disabled") : invocation.reason));
+            return run_uncached(invocation);
+        }
+
+        LocalCache cache;
+
+        Sha256 common;
+        common.field(CACHE_VERSION).field(compiler_identity(command[0]));
+        for (const auto& flag : normalized_flags(invocation))
+            common.field(flag);
+        for (const auto& pch : invocation.pch_inputs)
+            common.field(sha256_file(pch).value_or(pch));
+        const auto common_key = common.hex_digest();
+
+        // Direct mode needs the header list, which comes from the depfile
+        std::string manifest_key;
+        if (!invocation.depfile.empty()) {
+            if (auto source_hash = sha256_file(invocation.source)) {
+                manifest_key = Sha256().field("direct").field(common_key).field(invocation.source).field(*source_hash).hex_digest();
+
+                if (const auto result_key = lookup_manifest(cache, manifest_key)) {
+                    if (restore(cache, *result_key, invocation)) {
+                        note("direct hit " + invocation.output);
+                        return 0;
+                    }
+                }
+            }
+        }
+
+        // Preprocessor mode
+        auto preprocessed = util::process::run(preprocessor_args(invocation));
+        if (!preprocessed || preprocessed->exit_code != 0) {
+            note("preprocessing failed, compiling uncached");
+            return run_uncached(invocation);
+        }
+
+        const auto result_key = Sha256().field("cpp").field(common_key).field(preprocessed->out).hex_digest();
+
+        auto remote = open_remote_cache();
+
+        const bool local_hit = restore(cache, result_key, invocation);
+        const bool remote_hit = !local_hit && remote
+            && fetch_remote(remote, cache, result_key)
+            && restore(cache, result_key, invocation);
+
+        if (local_hit || remote_hit) {
+            note((remote_hit ? "remote hit " : "preprocessor hit ") + invocation.output);
+
+            if (!manifest_key.empty()) {
+                const auto deps = build::parse_depfile(read_file(invocation.depfile));
+                record_manifest(cache, manifest_key, result_key, deps);
+            }
+            return 0;
+        }
+
+        note("miss " + invocation.output);
+
+        auto compiled = compile(invocation);
+        if (!compiled)
+            return Err(compiled);
+
+        forward_output(compiled->out, compiled->err);
+
+        if (compiled->exit_code != 0 || !fs::exists(invocation.output))
+            return compiled->exit_code;
+
+        if (!invocation.depfile.empty()) {
+            const auto deps = build::parse_depfile(read_file(invocation.depfile));
+
+            std::string deps_list;
+            for (const auto& dep : deps)
+                deps_list += dep + "\n";
+
+            if (!cache.write(result_key, "d", deps_list))
+                return compiled->exit_code;
+
+            if (!manifest_key.empty())
+                record_manifest(cache, manifest_key, result_key, deps);
+        }
+
+        if (!compiled->out.empty())
+            (void)cache.write(result_key, "stdout", compiled->out);
+        if (!compiled->err.empty())
+            (void)cache.write(result_key, "stderr", compiled->err);
+
+        // The object goes in last, since its presence marks a complete entry
+        if (auto stored = cache.store(result_key, "o", invocation.output); !stored)
+            note(stored.error().message);
+
+        upload_remote(remote, cache, result_key);
+
+        cache.evict(result_key);
+        return compiled->exit_code;
+    }
+} // namespace muuk
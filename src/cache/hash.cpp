@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+#include "cache/hash.hpp"
+#include "rustify.hpp"
+
+namespace muuk {
+    namespace cache {
+        namespace {
+            constexpr std::array<uint32_t, 64> K = {
+                0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+                0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+                0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+                0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+                0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+                0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+                0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+                0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+            };
+
+            constexpr uint32_t rotr(uint32_t x, int n) {
+                return (x >> n) | (x << (32 - n));
+            }
+        } // namespace
+
+        Sha256::Sha256() :
+            state_ { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 },
+            buffer_ {} { }
+
+        void Sha256::compress(const uint8_t* block) {
+            std::array<uint32_t, 64> w;
+            for (size_t i = 0; i < 16; ++i)
+                w[i] = (uint32_t(block[i * 4]) << 24) | (uint32_t(block[i * 4 + 1]) << 16)
+                    | (uint32_t(block[i * 4 + 2]) << 8) | uint32_t(block[i * 4 + 3]);
+
+            for (size_t i = 16; i < 64; ++i) {
+                const uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                const uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+
+            auto [a, b, c, d, e, f, g, h] = state_;
+
+            for (size_t i = 0; i < 64; ++i) {
+                const uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+                const uint32_t ch = (e & f) ^ (~e & g);
+                const uint32_t t1 = h + s1 + ch + K[i] + w[i];
+                const uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+                const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+                const uint32_t t2 = s0 + maj;
+
+                h = g;
+                g = f;
+                f = e;
+                e = d + t1;
+                d = c;
+                c = b;
+                b = a;
+                a = t1 + t2;
+            }
+
+            state_[0] += a;
+            state_[1] += b;
+            state_[2] += c;
+            state_[3] += d;
+            state_[4] += e;
+            state_[5] += f;
+            state_[6] += g;
+            state_[7] += h;
+        }
+
+        Sha256& Sha256::update(const void* data, size_t size) {
+            const auto* bytes = static_cast<const uint8_t*>(data);
+            total_size_ += size;
+
+            while (size > 0) {
+                const size_t chunk = std::min(size, buffer_.size() - buffer_size_);
+                std::memcpy(buffer_.data() + buffer_size_, bytes, chunk);
+                buffer_size_ += chunk;
+                bytes += chunk;
+                size -= chunk;
+
+                if (buffer_size_ == buffer_.size()) {
+                    compress(buffer_.data());
+                    buffer_size_ = 0;
+                }
+            }
+
+            return *this;
+        }
+
+        Sha256& Sha256::update(std::string_view data) {
+            return update(data.data(), data.size());
+        }
+
+        Sha256& Sha256::field(std::string_view data) {
+            const std::string length = std::to_string(data.size()) + ":";
+            update(length);
+            return update(data);
+        }
+
+        std::string Sha256::hex_digest() {
+            const uint64_t bit_length = total_size_ * 8;
+
+            const uint8_t pad = 0x80;
+            update(&pad, 1);
+
+            const uint8_t zero = 0;
+            while (buffer_size_ != 56)
+                update(&zero, 1);
+
+            std::array<uint8_t, 8> length;
+            for (size_t i = 0; i < 8; ++i)
+                length[i] = static_cast<uint8_t>(bit_length >> (56 - 8 * i));
+            update(length.data(), length.size());
+
+            static constexpr char digits[] = "0123456789abcdef";
+            std::string hex;
+            hex.reserve(64);
+            for (const uint32_t word : state_)
+                for (int shift = 28; shift >= 0; shift -= 4)
+                    hex += digits[(word >> shift) & 0xf];
+
+            return hex;
+        }
+
+        std::string sha256_hex(std::string_view data) {
+            return Sha256().update(data).hex_digest();
+        }
+
+        Result<std::string> sha256_file(const std::filesystem::path& path) {
+            std::ifstream in(path, std::ios::binary);
+            if (!in)
+                return make_error<EC::FileNotFound>(path.string());
+
+            Sha256 hash;
+            std::array<char, 64 * 1024> buffer;
+            while (in) {
+                in.read(buffer.data(), buffer.size());
+                hash.update(buffer.data(), static_cast<size_t>(in.gcount()));
+            }
+
+            return hash.hex_digest();
+        }
+    } // namespace cache
+} // namespace muuk
@@ -0,0 +1,625 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <fmt/core.h>
+
+#include "cache/http.hpp"
+#include "rustify.hpp"
+#include "util.hpp"
+
+namespace muuk {
+    namespace cache {
+        namespace {
+#ifdef _WIN32
+            using socket_t = SOCKET;
+            constexpr socket_t INVALID = INVALID_SOCKET;
+
+            void close_socket(socket_t s) { closesocket(s); }
+            int poll_sockets(pollfd* fds, size_t count, int timeout) { return WSAPoll(fds, static_cast<ULONG>(count), timeout); }
+            int last_error() { return WSAGetLastError(); }
+            bool in_progress(int error) { return error == WSAEWOULDBLOCK; }
+            void set_non_blocking(socket_t s, bool enabled) {
+                u_long mode = enabled ? 1 : 0;
+                ioctlsocket(s, FIONBIO, &mode);
+            }
+            constexpr int SEND_FLAGS = 0;
+
+            void init_sockets() {
+                static const bool initialized = [] {
+                    WSADATA data;
+                    return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+                }();
+                (void)initialized;
+            }
+#else
+            using socket_t = int;
+            constexpr socket_t INVALID = -1;
+
+            void close_socket(socket_t s) { ::close(s); }
+            int poll_sockets(pollfd* fds, size_t count, int timeout) { return ::poll(fds, count, timeout); }
+            int last_error() { return errno; }
+            bool in_progress(int error) { return error == EINPROGRESS; }
+            void set_non_blocking(socket_t s, bool enabled) {
+                const int flags = fcntl(s, F_GETFL, 0);
+                fcntl(s, F_SETFL, enabled ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK));
+            }
+#ifdef MSG_NOSIGNAL
+            constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+            constexpr int SEND_FLAGS = 0;
+#endif
+            void init_sockets() { }
+#endif
+
+            /// Largest request body the server accepts.
+            constexpr size_t MAX_BODY_SIZE = 1024ull * 1024 * 1024;
+
+            /// How long the server keeps an idle connection open.
+            constexpr std::chrono::milliseconds IDLE_TIMEOUT { 30000 };
+
+            socket_t as_socket(intptr_t s) { return static_cast<socket_t>(s); }
+
+            /// Waits until the socket is ready for `events` or the timeout expires.
+            bool wait_for(socket_t s, short events, std::chrono::milliseconds timeout) {
+                pollfd fd {};
+                fd.fd = s;
+                fd.events = events;
+                return poll_sockets(&fd, 1, static_cast<int>(timeout.count())) > 0;
+            }
+
+            Result<void> send_all(socket_t s, std::string_view data, std::chrono::milliseconds timeout) {
+                while (!data.empty()) {
+                    if (!wait_for(s, POLLOUT, timeout))
+                        return Err("timed out sending");
+
+                    const auto sent = ::send(s, data.data(), static_cast<int>(std::min<size_t>(data.size(), 1 << 20)), SEND_FLAGS);
+                    if (sent <= 0)
+                        return Err("connection lost while sending");
+                    data.remove_prefix(static_cast<size_t>(sent));
+                }
+                return {};
+            }
+
+            /// Buffered reads of an HTTP message.
+            class Reader {
+            public:
+                Reader(socket_t s, std::chrono::milliseconds timeout) :
+                    socket_(s), timeout_(timeout) { }
+
+                bool received_anything() const { return received_; }
+
+                Result<std::string> line() {
+                    while (true) {
+                        const auto end = buffer_.find("\r\n", offset_);
+                        if (end != std::string::npos) {
+                            auto result = buffer_.substr(offset_, end - offset_);
+                            offset_ = end + 2;
+                            return result;
+                        }
+                        if (buffer_.size() - offset_ > 64 * 1024)
+                            return Err("header line too long");
+                        TRYV(fill());
+                    }
+                }
+
+                Result<std::string> exactly(size_t size) {
+                    while (buffer_.size() - offset_ < size)
+                        TRYV(fill());
+
+                    auto result = buffer_.substr(offset_, size);
+                    offset_ += size;
+                    return result;
+                }
+
+                Result<std::string> until_eof() {
+                    while (true) {
+                        auto filled = fill();
+                        if (!filled)
+                            break;
+                    }
+                    if (!eof_)
+                        return Err("timed out reading");
+
+                    auto result = buffer_.substr(offset_);
+                    offset_ = buffer_.size();
+                    return result;
+                }
+
+            private:
+                Result<void> fill() {
+                    if (offset_ > 0 && offset_ == buffer_.size()) {
+                        buffer_.clear();
+                        offset_ = 0;
+                    }
+
+                    if (!wait_for(socket_, POLLIN, timeout_))
+                        return Err("timed out reading");
+
+                    char chunk[64 * 1024];
+                    const auto received = ::recv(socket_, chunk, sizeof(chunk), 0);
+                    if (received <= 0) {
+                        eof_ = true;
+                        return Err("connection closed");
+                    }
+
+                    received_ = true;
+                    buffer_.append(chunk, static_cast<size_t>(received));
+                    return {};
+                }
+
+                socket_t socket_;
+                std::chrono::milliseconds timeout_;
+                std::string buffer_;
+                size_t offset_ = 0;
+                bool received_ = false;
+                bool eof_ = false;
+            };
+
+            Result<std::map<std::string, std::string>> read_headers(Reader& reader) {
+                std::map<std::string, std::string> headers;
+                while (true) {
+                    auto line = reader.line();
+                    if (!line)
+                        return Err(line);
+                    if (line->empty())
+                        return headers;
+
+                    const auto colon = line->find(':');
+                    if (colon == std::string::npos)
+                        return Err("malformed header '{}'", *line);
+
+                    headers[util::string_ops::to_lower(line->substr(0, colon))] = util::trim_whitespace(line->substr(colon + 1));
+                }
+            }
+
+            Result<std::string> read_chunked(Reader& reader) {
+                std::string body;
+                while (true) {
+                    auto size_line = reader.line();
+                    if (!size_line)
+                        return Err(size_line);
+
+                    const auto size = std::strtoull(size_line->c_str(), nullptr, 16);
+                    if (size == 0)
+                        break;
+                    if (body.size() + size > MAX_BODY_SIZE)
+                        return Err("body too large");
+
+                    auto chunk = reader.exactly(size);
+                    if (!chunk)
+                        return Err(chunk);
+                    body += *chunk;
+                    TRYV(reader.line());
+                }
+
+                // Trailers
+                TRYV(read_headers(reader));
+                return body;
+            }
+
+            const char* reason_phrase(int status) {
+                switch (status) {
+                case 200:
+                    return "OK";
+                case 400:
+                    return "Bad Request";
+                case 404:
+                    return "Not Found";
+                case 405:
+                    return "Method Not Allowed";
+                case 413:
+                    return "Payload Too Large";
+                case 500:
+                    return "Internal Server Error";
+                case 503:
+                    return "Service Unavailable";
+                default:
+                    return "";
+                }
+            }
+
+            std::string format_response(const HttpResponse& response, bool head, bool keep_alive) {
+                std::string out = fmt::format("HTTP/1.1 {} {}\r\n", response.status, reason_phrase(response.status));
+                for (const auto& [name, value] : response.headers)
+                    out += name + ": " + value + "\r\n";
+                out += fmt::format("Content-Length: {}\r\n", response.body.size());
+                out += keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+                if (!head)
+                    out += response.body;
+                return out;
+            }
+        } // namespace
+
+        Result<Url> parse_url(const std::string& url) {
+            constexpr std::string_view scheme = "http://";
+            if (!url.starts_with(scheme))
+                return Err("Unsupported cache URL '{}': only http:// is supported", url);
+
+            Url result;
+            auto rest = url.substr(scheme.size());
+
+            const auto slash = rest.find('/');
+            if (slash != std::string::npos) {
+                result.prefix = rest.substr(slash);
+                while (!result.prefix.empty() && result.prefix.back() == '/')
+                    result.prefix.pop_back();
+                rest = rest.substr(0, slash);
+            }
+
+            const auto colon = rest.rfind(':');
+            if (colon != std::string::npos && rest.find(']', colon) == std::string::npos) {
+                const auto port = rest.substr(colon + 1);
+                if (!util::is_integer(port) || std::stoul(port) == 0 || std::stoul(port) > 65535)
+                    return Err("Invalid port in cache URL '{}'", url);
+                result.port = static_cast<uint16_t>(std::stoul(port));
+                rest = rest.substr(0, colon);
+            }
+
+            if (rest.size() > 2 && rest.front() == '[' && rest.back() == ']')
+                rest = rest.substr(1, rest.size() - 2);
+
+            if (rest.empty())
+                return Err("Missing host in cache URL '{}'", url);
+
+            result.host = rest;
+            return result;
+        }
+
+        HttpClient::HttpClient(Url url, std::chrono::milliseconds timeout) :
+            url_(std::move(url)), timeout_(timeout) {
+            init_sockets();
+        }
+
+        HttpClient::~HttpClient() {
+            disconnect();
+        }
+
+        void HttpClient::disconnect() {
+            if (socket_ != -1) {
+                close_socket(as_socket(socket_));
+                socket_ = -1;
+            }
+        }
+
+        Result<void> HttpClient::connect() {
+            addrinfo hints {};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+
+            addrinfo* addresses = nullptr;
+            const auto port = std::to_string(url_.port);
+            if (getaddrinfo(url_.host.c_str(), port.c_str(), &hints, &addresses) != 0)
+                return Err("Failed to resolve '{}'", url_.host);
+
+            std::string error = "no addresses";
+            for (auto* address = addresses; address; address = address->ai_next) {
+                const auto s = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+                if (s == INVALID)
+                    continue;
+
+                // Connect without blocking, so an unreachable host costs at most `timeout`
+                set_non_blocking(s, true);
+                bool connected = ::connect(s, address->ai_addr, static_cast<int>(address->ai_addrlen)) == 0;
+                if (!connected && in_progress(last_error()) && wait_for(s, POLLOUT, timeout_)) {
+                    int so_error = 0;
+                    socklen_t length = sizeof(so_error);
+                    getsockopt(s, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&so_error), &length);
+                    connected = so_error == 0;
+                }
+
+                if (!connected) {
+                    error = "connection refused or timed out";
+                    close_socket(s);
+                    continue;
+                }
+
+                int one = 1;
+                setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+#ifdef SO_NOSIGPIPE
+                setsockopt(s, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+                socket_ = static_cast<intptr_t>(s);
+                break;
+            }
+
+            freeaddrinfo(addresses);
+
+            if (socket_ == -1)
+                return Err("Failed to connect to {}:{}: {}", url_.host, url_.port, error);
+            return {};
+        }
+
+        Result<HttpResponse> HttpClient::exchange(const std::string& request, bool head) {
+            const auto s = as_socket(socket_);
+            TRYV(send_all(s, request, timeout_));
+
+            Reader reader(s, timeout_);
+
+            auto status_line = reader.line();
+            if (!status_line)
+                return Err(status_line);
+
+            // e.g. `HTTP/1.1 200 OK`
+            const auto space = status_line->find(' ');
+            if (!status_line->starts_with("HTTP/") || space == std::string::npos)
+                return Err("malformed status line '{}'", *status_line);
+
+            HttpResponse response;
+            response.status = std::atoi(status_line->c_str() + space + 1);
+
+            auto headers = read_headers(reader);
+            if (!headers)
+                return Err(headers);
+            response.headers = std::move(*headers);
+
+            const auto& h = response.headers;
+            bool close = h.contains("connection") && util::string_ops::to_lower(h.at("connection")) == "close";
+
+            if (head || response.status == 204 || response.status == 304 || response.status / 100 == 1) {
+                // No body
+            } else if (h.contains("transfer-encoding") && util::string_ops::to_lower(h.at("transfer-encoding")) != "identity") {
+                auto body = read_chunked(reader);
+                if (!body)
+                    return Err(body);
+                response.body = std::move(*body);
+            } else if (h.contains("content-length")) {
+                const auto length = std::strtoull(h.at("content-length").c_str(), nullptr, 10);
+                auto body = reader.exactly(length);
+                if (!body)
+                    return Err(body);
+                response.body = std::move(*body);
+            } else {
+                auto body = reader.until_eof();
+                if (!body)
+                    return Err(body);
+                response.body = std::move(*body);
+                close = true;
+            }
+
+            if (close)
+                disconnect();
+
+            return response;
+        }
+
+        Result<HttpResponse> HttpClient::request(const std::string& method, const std::string& path, const std::string& body) {
+            std::string request = fmt::format(
+                "{} {}{} HTTP/1.1\r\nHost: {}:{}\r\nUser-Agent: muuk\r\n",
+                method,
+                url_.prefix,
+                path,
+                url_.host,
+                url_.port);
+            if (!body.empty() || method == "PUT" || method == "POST")
+                request += fmt::format("Content-Type: application/octet-stream\r\nContent-Length: {}\r\n", body.size());
+            request += "\r\n";
+            request += body;
+
+            // A kept-alive connection may have been closed by the server in
+            // the meantime, so a failure on a reused connection is retried once.
+            for (int attempt = 0; attempt < 2; ++attempt) {
+                const bool reused = socket_ != -1;
+                if (!reused)
+                    TRYV(connect());
+
+                auto response = exchange(request, method == "HEAD");
+                if (response)
+                    return response;
+
+                disconnect();
+                if (!reused)
+                    return Err("{} {}{} failed: {}", method, url_.prefix, path, response.error().message);
+            }
+
+            return Err("{} {}{} failed", method, url_.prefix, path);
+        }
+
+        HttpServer::HttpServer(std::string bind_address, uint16_t port, size_t threads, Handler handler) :
+            bind_address_(std::move(bind_address)),
+            port_(port),
+            threads_(std::max<size_t>(threads, 1)),
+            handler_(std::move(handler)) {
+            init_sockets();
+        }
+
+        HttpServer::~HttpServer() {
+            if (listener_ != -1)
+                close_socket(as_socket(listener_));
+        }
+
+        Result<void> HttpServer::listen() {
+            addrinfo hints {};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags = AI_PASSIVE;
+
+            addrinfo* addresses = nullptr;
+            const auto port = std::to_string(port_);
+            if (getaddrinfo(bind_address_.c_str(), port.c_str(), &hints, &addresses) != 0)
+                return Err("Failed to resolve bind address '{}'", bind_address_);
+
+            for (auto* address = addresses; address; address = address->ai_next) {
+                const auto s = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+                if (s == INVALID)
+                    continue;
+
+                int one = 1;
+                setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&one), sizeof(one));
+
+                if (::bind(s, address->ai_addr, static_cast<int>(address->ai_addrlen)) != 0 || ::listen(s, 128) != 0) {
+                    close_socket(s);
+                    continue;
+                }
+
+                sockaddr_storage bound {};
+                socklen_t length = sizeof(bound);
+                getsockname(s, reinterpret_cast<sockaddr*>(&bound), &length);
+                if (bound.ss_family == AF_INET)
+                    port_ = ntohs(reinterpret_cast<sockaddr_in*>(&bound)->sin_port);
+                else if (bound.ss_family == AF_INET6)
+                    port_ = ntohs(reinterpret_cast<sockaddr_in6*>(&bound)->sin6_port);
+
+                listener_ = static_cast<intptr_t>(s);
+                break;
+            }
+
+            freeaddrinfo(addresses);
+
+            if (listener_ == -1)
+                return Err("Failed to listen on {}:{}", bind_address_, port_);
+            return {};
+        }
+
+        void HttpServer::stop() {
+            stopping_ = true;
+        }
+
+        void HttpServer::serve() {
+            std::mutex mutex;
+            std::condition_variable ready;
+            std::deque<intptr_t> pending;
+            const size_t max_pending = threads_ * 4;
+
+            std::vector<std::thread> workers;
+            for (size_t i = 0; i < threads_; ++i) {
+                workers.emplace_back([&] {
+                    while (true) {
+                        intptr_t client;
+                        {
+                            std::unique_lock lock(mutex);
+                            ready.wait(lock, [&] { return stopping_ || !pending.empty(); });
+                            if (pending.empty())
+                                return;
+                            client = pending.front();
+                            pending.pop_front();
+                        }
+
+                        handle_connection(client);
+                    }
+                });
+            }
+
+            const auto listener = as_socket(listener_);
+            while (!stopping_) {
+                // Wake up regularly to notice `stop()`
+                if (!wait_for(listener, POLLIN, std::chrono::milliseconds(200)))
+                    continue;
+
+                const auto client = ::accept(listener, nullptr, nullptr);
+                if (client == INVALID)
+                    continue;
+
+                int one = 1;
+                setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+#ifdef SO_NOSIGPIPE
+                setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+                std::unique_lock lock(mutex);
+                if (pending.size() >= max_pending) {
+                    lock.unlock();
+                    HttpResponse busy { 503, {}, "" };
+                    (void)send_all(client, format_response(busy, false, false), std::chrono::milliseconds(1000));
+                    close_socket(client);
+                    continue;
+                }
+
+                pending.push_back(static_cast<intptr_t>(client));
+                ready.notify_one();
+            }
+
+            {
+                std::lock_guard lock(mutex);
+                ready.notify_all();
+            }
+            for (auto& worker : workers)
+                worker.join();
+
+            for (const auto client : pending)
+                close_socket(as_socket(client));
+        }
+
+        void HttpServer::handle_connection(intptr_t client) {
+            const auto s = as_socket(client);
+            Reader reader(s, IDLE_TIMEOUT);
+
+            while (!stopping_) {
+                auto request_line = reader.line();
+                if (!request_line)
+                    break;
+
+                // e.g. `GET /cas/<hash> HTTP/1.1`
+                const auto first = request_line->find(' ');
+                const auto second = request_line->find(' ', first + 1);
+                if (first == std::string::npos || second == std::string::npos)
+                    break;
+
+                HttpRequest request;
+                request.method = request_line->substr(0, first);
+                request.path = request_line->substr(first + 1, second - first - 1);
+                const bool http10 = request_line->ends_with("HTTP/1.0");
+
+                auto headers = read_headers(reader);
+                if (!headers)
+                    break;
+                request.headers = std::move(*headers);
+
+                HttpResponse response;
+                bool keep_alive = !http10;
+                if (request.headers.contains("connection"))
+                    keep_alive = util::string_ops::to_lower(request.headers["connection"]) != "close";
+
+                if (request.headers.contains("transfer-encoding")) {
+                    auto body = read_chunked(reader);
+                    if (!body)
+                        break;
+                    request.body = std::move(*body);
+                } else if (request.headers.contains("content-length")) {
+                    const auto length = std::strtoull(request.headers["content-length"].c_str(), nullptr, 10);
+                    if (length > MAX_BODY_SIZE) {
+                        response.status = 413;
+                        (void)send_all(s, format_response(response, false, false), IDLE_TIMEOUT);
+                        break;
+                    }
+
+                    auto body = reader.exactly(length);
+                    if (!body)
+                        break;
+                    request.body = std::move(*body);
+                }
+
+                try {
+                    response = handler_(request);
+                } catch (const std::exception& e) {
+                    response = { 500, {}, e.what() };
+                }
+
+                if (!send_all(s, format_response(response, request.method == "HEAD", keep_alive), IDLE_TIMEOUT) || !keep_alive)
+                    break;
+            }
+
+            close_socket(s);
+        }
+    } // namespace cache
+} // namespace muuk
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cache/local_cache.hpp"
+#include "rustify.hpp"
+
+namespace fs = std::filesystem;
+
+namespace muuk {
+    namespace cache {
+        /// Entries are spread over 256 shards, each allowed 1/256 of the budget.
+        static constexpr std::uintmax_t SHARD_COUNT = 256;
+
+        /// Shards are trimmed down to this fraction of their budget.
+        static constexpr double EVICTION_TARGET = 0.9;
+
+        fs::path default_cache_dir() {
+            if (const char* dir = std::getenv("MUUK_CACHE_DIR"); dir && *dir)
+                return dir;
+
+#ifdef _WIN32
+            if (const char* local = std::getenv("LOCALAPPDATA"); local && *local)
+                return fs::path(local) / "muuk";
+#else
+            if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg)
+                return fs::path(xdg) / "muuk";
+            if (const char* home = std::getenv("HOME"); home && *home)
+                return fs::path(home) / ".cache" / "muuk";
+#endif
+            return fs::temp_directory_path() / "muuk-cache";
+        }
+
+        std::uintmax_t default_cache_size() {
+            const char* value = std::getenv("MUUK_CACHE_SIZE");
+            if (!value || !*value)
+                return DEFAULT_CACHE_SIZE;
+
+            char* end = nullptr;
+            const auto size = std::strtoull(value, &end, 10);
+            switch (end ? *end : '\0') {
+            case 'k':
+            case 'K':
+                return size * 1024;
+            case 'm':
+            case 'M':
+                return size * 1024 * 1024;
+            case 'g':
+            case 'G':
+                return size * 1024 * 1024 * 1024;
+            default:
+                return size > 0 ? size : DEFAULT_CACHE_SIZE;
+            }
+        }
+
+        LocalCache::LocalCache(fs::path root, std::uintmax_t max_size) :
+            root_(std::move(root)), max_size_(max_size) { }
+
+        fs::path LocalCache::entry_path(const std::string& key, const std::string& name) const {
+            return root_ / "objects" / key.substr(0, 2) / (key + "." + name);
+        }
+
+        bool LocalCache::contains(const std::string& key, const std::string& name) const {
+            std::error_code ec;
+            return fs::exists(entry_path(key, name), ec);
+        }
+
+        bool LocalCache::fetch(const std::string& key, const std::string& name, const fs::path& destination) const {
+            const auto path = entry_path(key, name);
+
+            std::error_code ec;
+            fs::copy_file(path, destination, fs::copy_options::overwrite_existing, ec);
+            if (ec)
+                return false;
+
+            // Mark the entry as recently used
+            fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+            return true;
+        }
+
+        std::optional<std::string> LocalCache::read(const std::string& key, const std::string& name) const {
+            std::ifstream in(entry_path(key, name), std::ios::binary);
+            if (!in)
+                return std::nullopt;
+
+            return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+
+        /// Unique name next to `path`, so a rename publishes the file atomically.
+        static fs::path temporary_path(const fs::path& path) {
+            static thread_local std::mt19937_64 rng(std::random_device {}());
+            return path.parent_path() / (path.filename().string() + ".tmp" + std::to_string(rng()));
+        }
+
+        Result<void> LocalCache::store(const std::string& key, const std::string& name, const fs::path& source) {
+            const auto path = entry_path(key, name);
+            const auto temp = temporary_path(path);
+
+            std::error_code ec;
+            fs::create_directories(path.parent_path(), ec);
+            fs::copy_file(source, temp, fs::copy_options::overwrite_existing, ec);
+            if (!ec)
+                fs::rename(temp, path, ec);
+
+            if (ec) {
+                fs::remove(temp, ec);
+                return Err("Failed to store '{}' in the cache: {}", source.string(), ec.message());
+            }
+
+            return {};
+        }
+
+        Result<void> LocalCache::write(const std::string& key, const std::string& name, const std::string& contents) {
+            const auto path = entry_path(key, name);
+            const auto temp = temporary_path(path);
+
+            std::error_code ec;
+            fs::create_directories(path.parent_path(), ec);
+
+            {
+                std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+                if (!out)
+                    return Err("Failed to write '{}'", temp.string());
+                out << contents;
+            }
+
+            fs::rename(temp, path, ec);
+            if (ec) {
+                fs::remove(temp, ec);
+                return Err("Failed to write '{}': {}", path.string(), ec.message());
+            }
+
+            return {};
+        }
+
+        void LocalCache::evict(const std::string& key) {
+            const auto shard = root_ / "objects" / key.substr(0, 2);
+            const auto budget = max_size_ / SHARD_COUNT;
+
+            struct Entry {
+                std::uintmax_t size = 0;
+                fs::file_time_type last_used = fs::file_time_type::min();
+                std::vector<fs::path> files;
+            };
+
+            // Files of an entry share the key, which is the stem before the first '.'
+            std::map<std::string, Entry> entries;
+            std::uintmax_t total = 0;
+
+            std::error_code ec;
+            for (const auto& file : fs::directory_iterator(shard, ec)) {
+                if (!file.is_regular_file(ec))
+                    continue;
+
+                const auto filename = file.path().filename().string();
+                auto& entry = entries[filename.substr(0, filename.find('.'))];
+
+                const auto size = file.file_size(ec);
+                entry.size += size;
+                entry.last_used = std::max(entry.last_used, file.last_write_time(ec));
+                entry.files.push_back(file.path());
+                total += size;
+            }
+
+            if (total <= budget)
+                return;
+
+            std::vector<const Entry*> by_age;
+            for (const auto& [_, entry] : entries)
+                by_age.push_back(&entry);
+
+            std::sort(by_age.begin(), by_age.end(), [](const Entry* a, const Entry* b) {
+                return a->last_used < b->last_used;
+            });
+
+            const auto target = static_cast<std::uintmax_t>(budget * EVICTION_TARGET);
+            for (const auto* entry : by_age) {
+                if (total <= target)
+                    break;
+
+                for (const auto& file : entry->files)
+                    fs::remove(file, ec);
+                total -= std::min(total, entry->size);
+            }
+        }
+    } // namespace cache
+} // namespace muuk
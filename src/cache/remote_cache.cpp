@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cache/hash.hpp"
+#include "cache/remote_cache.hpp"
+#include "rustify.hpp"
+#include "util.hpp"
+
+namespace muuk {
+    namespace cache {
+        std::optional<RemoteCacheOptions> remote_cache_options_from_env() {
+            const char* url = std::getenv("MUUK_REMOTE_CACHE");
+            if (!url || !*url)
+                return std::nullopt;
+
+            RemoteCacheOptions options;
+            options.url = url;
+
+            if (const char* timeout = std::getenv("MUUK_REMOTE_CACHE_TIMEOUT"); timeout && util::is_integer(timeout))
+                options.timeout = std::chrono::milliseconds(std::max(1, std::atoi(timeout)));
+            if (const char* jobs = std::getenv("MUUK_REMOTE_CACHE_JOBS"); jobs && util::is_integer(jobs))
+                options.max_connections = static_cast<size_t>(std::max(1, std::atoi(jobs)));
+            if (const char* read_only = std::getenv("MUUK_REMOTE_CACHE_READONLY"); read_only && *read_only && std::string(read_only) != "0")
+                options.read_only = true;
+
+            return options;
+        }
+
+        /// Runs `tasks` on up to `max_threads` threads, the calling one included.
+        /// Returns the first error, if any.
+        static Result<void> run_bounded(const std::vector<std::function<Result<void>(HttpClient&)>>& tasks, HttpClient& own_client, const Url& url, const RemoteCacheOptions& options) {
+            std::atomic<size_t> next = 0;
+            std::mutex mutex;
+            Result<void> result;
+
+            auto work = [&](HttpClient& client) {
+                for (size_t i = next++; i < tasks.size(); i = next++) {
+                    auto done = tasks[i](client);
+                    if (!done) {
+                        std::lock_guard lock(mutex);
+                        if (result)
+                            result = Err(done);
+                    }
+                }
+            };
+
+            const auto extra = std::min(options.max_connections, tasks.size()) - std::min<size_t>(tasks.size(), 1);
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < extra; ++i) {
+                threads.emplace_back([&] {
+                    HttpClient client(url, options.timeout);
+                    work(client);
+                });
+            }
+
+            work(own_client);
+            for (auto& thread : threads)
+                thread.join();
+
+            return result;
+        }
+
+        Result<RemoteCache> RemoteCache::connect(const RemoteCacheOptions& options) {
+            auto url = parse_url(options.url);
+            if (!url)
+                return Err(url);
+            return RemoteCache(std::move(*url), options);
+        }
+
+        RemoteCache::RemoteCache(Url url, RemoteCacheOptions options) :
+            url_(std::move(url)),
+            options_(std::move(options)),
+            client_(std::make_unique<HttpClient>(url_, options_.timeout)) { }
+
+        Result<std::optional<EntryFiles>> RemoteCache::fetch(const std::string& key) {
+            auto index = client_->request("GET", "/ac/" + key);
+            if (!index)
+                return Err(index);
+            if (index->status == 404)
+                return std::nullopt;
+            if (index->status != 200)
+                return Err("GET /ac/{} returned {}", key, index->status);
+
+            std::vector<std::pair<std::string, std::string>> blobs;
+            std::istringstream stream(index->body);
+            for (std::string line; std::getline(stream, line);) {
+                const auto tab = line.find('\t');
+                if (tab == std::string::npos)
+                    return Err("Malformed remote cache entry '{}'", key);
+                blobs.emplace_back(line.substr(0, tab), line.substr(tab + 1));
+            }
+
+            EntryFiles files;
+            std::mutex mutex;
+            std::atomic<bool> missing = false;
+
+            std::vector<std::function<Result<void>(HttpClient&)>> tasks;
+            for (const auto& [name, hash] : blobs) {
+                tasks.push_back([&, name, hash](HttpClient& client) -> Result<void> {
+                    if (missing)
+                        return {};
+
+                    auto blob = client.request("GET", "/cas/" + hash);
+                    if (!blob)
+                        return Err(blob);
+                    if (blob->status == 404) {
+                        missing = true;
+                        return {};
+                    }
+                    if (blob->status != 200)
+                        return Err("GET /cas/{} returned {}", hash, blob->status);
+
+                    // Don't trust the server with the object file's contents
+                    if (sha256_hex(blob->body) != hash)
+                        return Err("Remote cache blob {} is corrupt", hash);
+
+                    std::lock_guard lock(mutex);
+                    files[name] = std::move(blob->body);
+                    return {};
+                });
+            }
+
+            TRYV(run_bounded(tasks, *client_, url_, options_));
+
+            if (missing)
+                return std::nullopt;
+            return files;
+        }
+
+        Result<void> RemoteCache::upload(const std::string& key, const EntryFiles& files) {
+            if (options_.read_only)
+                return {};
+
+            std::string index;
+            std::vector<std::function<Result<void>(HttpClient&)>> tasks;
+
+            for (const auto& [name, contents] : files) {
+                const auto hash = sha256_hex(contents);
+                index += name + "\t" + hash + "\n";
+
+                tasks.push_back([&contents, hash](HttpClient& client) -> Result<void> {
+                    auto response = client.request("PUT", "/cas/" + hash, contents);
+                    if (!response)
+                        return Err(response);
+                    if (response->status / 100 != 2)
+                        return Err("PUT /cas/{} returned {}", hash, response->status);
+                    return {};
+                });
+            }
+
+            TRYV(run_bounded(tasks, *client_, url_, options_));
+
+            auto response = client_->request("PUT", "/ac/" + key, index);
+            if (!response)
+                return Err(response);
+            if (response->status / 100 != 2)
+                return Err("PUT /ac/{} returned {}", key, response->status);
+
+            return {};
+        }
+    } // namespace cache
+} // namespace muuk
@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "build/deps.hpp"
+#include "cache/compiler_cache.hpp"
+#include "cache/hash.hpp"
+#include "cache/http.hpp"
+#include "dist/client.hpp"
+#include "dist/protocol.hpp"
+#include "rustify.hpp"
+#include "util.hpp"
+
+namespace fs = std::filesystem;
+
+namespace muuk {
+    namespace dist {
+        /// A job is offered to at most this many workers before compiling locally.
+        static constexpr size_t MAX_ATTEMPTS = 2;
+
+        std::optional<DistOptions> dist_options_from_env() {
+            const char* workers = std::getenv("MUUK_WORKERS");
+            if (!workers || !*workers)
+                return std::nullopt;
+
+            DistOptions options;
+            std::istringstream stream(workers);
+            for (std::string worker; std::getline(stream, worker, ',');) {
+                worker = util::trim_whitespace(worker);
+                if (!worker.empty())
+                    options.workers.push_back(worker);
+            }
+
+            if (options.workers.empty())
+                return std::nullopt;
+
+            if (const char* pump = std::getenv("MUUK_WORKERS_PUMP"); pump && *pump && std::string(pump) != "0")
+                options.pump = true;
+            if (const char* timeout = std::getenv("MUUK_WORKERS_TIMEOUT"); timeout && util::is_integer(timeout))
+                options.timeout = std::chrono::milliseconds(std::max(1, std::atoi(timeout)));
+
+            const char* root = std::getenv("MUUK_PROJECT_ROOT");
+            options.project_root = root && *root ? std::string(root) : fs::current_path().string();
+
+            return options;
+        }
+
+        static std::string read_file(const fs::path& path) {
+            std::ifstream in(path, std::ios::binary);
+            return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+
+        static bool is_under(const std::string& path, const std::string& root) {
+            return path.size() > root.size() && path.starts_with(root) && path[root.size()] == '/';
+        }
+
+        /// A compile request, and the local files the worker may ask for.
+        struct Job {
+            Fields fields;
+
+            /// Content hash -> path of the project files sent in pump mode
+            std::map<std::string, std::string> files;
+        };
+
+        /// Runs the preprocessor locally with `mode` (`-E` or `-M`), writing
+        /// the depfile the compile would have written.
+        static Result<util::process::Output> preprocess(const cache::CompilerInvocation& invocation, const std::string& mode) {
+            auto args = cache::preprocessor_args(invocation);
+            args[1] = mode;
+            if (mode == "-E" && !invocation.depfile.empty())
+                args.insert(args.end(), { "-MD", "-MF", invocation.depfile });
+            args.insert(args.end(), { "-MT", invocation.output });
+
+            auto result = util::process::run(args);
+            if (!result)
+                return Err(result);
+            if (result->exit_code != 0)
+                return Err("Preprocessing '{}' failed", invocation.source);
+
+            if (mode == "-M" && !invocation.depfile.empty()) {
+                std::ofstream out(invocation.depfile, std::ios::binary | std::ios::trunc);
+                out << result->out;
+            }
+
+            return result;
+        }
+
+        static Result<Job> prepare(const DistOptions& options, const cache::CompilerInvocation& invocation) {
+            const auto& compiler = invocation.args[0];
+
+            Job job;
+            job.fields = {
+                { "version", PROTOCOL_VERSION },
+                { "compiler", fs::path(compiler).filename().string() },
+                { "identity", cache::compiler_identity(compiler) },
+            };
+
+            if (!options.pump) {
+                auto preprocessed = preprocess(invocation, "-E");
+                if (!preprocessed)
+                    return Err(preprocessed);
+
+                job.fields.emplace_back("mode", "preprocessed");
+                job.fields.emplace_back("language", fs::path(invocation.source).extension() == ".c" ? "c" : "c++");
+                for (auto& flag : cache::remote_compile_flags(invocation, true))
+                    job.fields.emplace_back("arg", std::move(flag));
+                job.fields.emplace_back("source", std::move(preprocessed->out));
+                return job;
+            }
+
+            // Pump mode: the worker rebuilds the project tree from the files
+            // the source includes, each sent once per worker
+            auto dependencies = preprocess(invocation, "-M");
+            if (!dependencies)
+                return Err(dependencies);
+
+            const auto cwd = fs::current_path();
+            const auto root = fs::absolute(options.project_root).lexically_normal().generic_string();
+
+            job.fields.emplace_back("mode", "pump");
+            job.fields.emplace_back("cwd", cwd.generic_string());
+            job.fields.emplace_back("root", root);
+            job.fields.emplace_back("input", invocation.source);
+            for (auto& flag : cache::remote_compile_flags(invocation, false))
+                job.fields.emplace_back("arg", std::move(flag));
+
+            for (const auto& dep : build::parse_depfile(dependencies->out)) {
+                const auto path = (cwd / dep).lexically_normal().generic_string();
+
+                if (!is_under(path, root)) {
+                    job.fields.emplace_back("system", path);
+                    continue;
+                }
+
+                const auto hash = cache::sha256_file(path);
+                if (!hash)
+                    return Err("Failed to read '{}'", path);
+
+                job.fields.emplace_back("file", *hash + "\t" + path);
+                job.files.emplace(*hash, path);
+            }
+
+            return job;
+        }
+
+        static Result<util::process::Output> run_job(const std::string& worker, const DistOptions& options, const Job& job, const cache::CompilerInvocation& invocation) {
+            auto url = cache::parse_url(worker);
+            if (!url)
+                return Err(url);
+
+            cache::HttpClient client(*url, options.timeout);
+
+            if (!job.files.empty()) {
+                std::string hashes;
+                for (const auto& [hash, _] : job.files)
+                    hashes += hash + "\n";
+
+                auto missing = client.request("POST", "/missing", hashes);
+                if (!missing)
+                    return Err(missing);
+                if (missing->status != 200)
+                    return Err("Worker {} answered {} to /missing", worker, missing->status);
+
+                std::istringstream stream(missing->body);
+                for (std::string hash; std::getline(stream, hash);) {
+                    auto file = job.files.find(hash);
+                    if (file == job.files.end())
+                        continue;
+
+                    auto uploaded = client.request("PUT", "/files/" + hash, read_file(file->second));
+                    if (!uploaded)
+                        return Err(uploaded);
+                    if (uploaded->status != 200)
+                        return Err("Worker {} rejected '{}' ({})", worker, file->second, uploaded->status);
+                }
+            }
+
+            auto response = client.request("POST", "/compile", encode_fields(job.fields));
+            if (!response)
+                return Err(response);
+            if (response->status != 200)
+                return Err("Worker {} declined the job ({}): {}", worker, response->status, response->body);
+
+            auto reply = decode_fields(response->body);
+            if (!reply)
+                return Err(reply);
+
+            util::process::Output output;
+            output.exit_code = std::atoi(find_field(*reply, "exit").value_or("-1").c_str());
+            output.out = find_field(*reply, "stdout").value_or("");
+            output.err = find_field(*reply, "stderr").value_or("");
+
+            if (output.exit_code == 0) {
+                const auto object = find_field(*reply, "object");
+                if (!object)
+                    return Err("Worker {} sent no object for '{}'", worker, invocation.output);
+
+                std::ofstream out(invocation.output, std::ios::binary | std::ios::trunc);
+                out.write(object->data(), static_cast<std::streamsize>(object->size()));
+                if (!out)
+                    return Err("Failed to write '{}'", invocation.output);
+            }
+
+            return output;
+        }
+
+        Result<util::process::Output> compile_remote(const DistOptions& options, const cache::CompilerInvocation& invocation) {
+            if (options.workers.empty())
+                return Err("No workers configured");
+            if (!invocation.pch_inputs.empty())
+                return Err("Precompiled headers are only used locally");
+
+            auto job = prepare(options, invocation);
+            if (!job)
+                return Err(job);
+
+            const auto count = options.workers.size();
+            const auto first = std::hash<std::string> {}(invocation.output) % count;
+
+            Result<util::process::Output> result = Err("No worker took the job");
+            for (size_t attempt = 0; attempt < std::min(count, MAX_ATTEMPTS); ++attempt) {
+                result = run_job(options.workers[(first + attempt) % count], options, *job, invocation);
+                if (result)
+                    return result;
+            }
+
+            return result;
+        }
+    } // namespace dist
+} // namespace muuk
@@ -0,0 +1,83 @@
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "dist/protocol.hpp"
+#include "rustify.hpp"
+
+namespace muuk {
+    namespace dist {
+        std::string encode_fields(const Fields& fields) {
+            std::string message;
+            for (const auto& [name, value] : fields) {
+                message += name;
+                message += '\t';
+                message += std::to_string(value.size());
+                message += '\n';
+                message += value;
+            }
+            return message;
+        }
+
+        Result<Fields> decode_fields(const std::string& message) {
+            Fields fields;
+            size_t position = 0;
+
+            while (position < message.size()) {
+                const auto tab = message.find('\t', position);
+                const auto newline = message.find('\n', position);
+                if (tab == std::string::npos || newline == std::string::npos || tab > newline)
+                    return Err("Malformed message header at byte {}", position);
+
+                const auto size_text = message.substr(tab + 1, newline - tab - 1);
+                if (size_text.empty() || size_text.find_first_not_of("0123456789") != std::string::npos)
+                    return Err("Malformed field size '{}'", size_text);
+
+                const auto size = std::strtoull(size_text.c_str(), nullptr, 10);
+                if (size > message.size() - newline - 1)
+                    return Err("Truncated field '{}'", message.substr(position, tab - position));
+
+                fields.emplace_back(message.substr(position, tab - position), message.substr(newline + 1, size));
+                position = newline + 1 + size;
+            }
+
+            return fields;
+        }
+
+        std::optional<std::string> find_field(const Fields& fields, const std::string& name) {
+            for (const auto& [field_name, value] : fields)
+                if (field_name == name)
+                    return value;
+            return std::nullopt;
+        }
+
+        std::vector<std::string> find_fields(const Fields& fields, const std::string& name) {
+            std::vector<std::string> values;
+            for (const auto& [field_name, value] : fields)
+                if (field_name == name)
+                    values.push_back(value);
+            return values;
+        }
+
+        bool is_allowed_compiler(const std::string& compiler) {
+            static const char* names[] = { "g++", "gcc", "c++", "cc", "clang++", "clang" };
+
+            for (const auto* name : names) {
+                const std::string base = name;
+                if (!compiler.starts_with(base))
+                    continue;
+
+                // An optional version suffix, e.g. `-13` or `-17.0`
+                const auto suffix = compiler.substr(base.size());
+                if (suffix.empty())
+                    return true;
+                if (suffix.size() > 1 && suffix[0] == '-'
+                    && suffix.find_first_not_of("0123456789.", 1) == std::string::npos)
+                    return true;
+            }
+
+            return false;
+        }
+    } // namespace dist
+} // namespace muuk
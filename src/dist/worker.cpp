@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cache/compiler_cache.hpp"
+#include "cache/hash.hpp"
+#include "cache/http.hpp"
+#include "cache/local_cache.hpp"
+#include "commands/worker.hpp"
+#include "dist/protocol.hpp"
+#include "dist/worker.hpp"
+#include "logger.hpp"
+#include "rustify.hpp"
+#include "util.hpp"
+
+namespace fs = std::filesystem;
+
+namespace muuk {
+    namespace dist {
+        /// Flags whose joined value may be a path into the project.
+        static const char* PATH_FLAGS[] = { "-isystem", "-iquote", "-idirafter", "-include", "-imacros", "-I" };
+
+        static bool is_hash(const std::string& key) {
+            return key.size() == 64 && std::all_of(key.begin(), key.end(), [](char c) {
+                return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+            });
+        }
+
+        static bool is_under(const std::string& path, const std::string& root) {
+            return path == root
+                || (path.size() > root.size() && path.starts_with(root) && path[root.size()] == '/');
+        }
+
+        static std::string read_file(const fs::path& path) {
+            std::ifstream in(path, std::ios::binary);
+            return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+
+        static void replace_all(std::string& text, const std::string& from, const std::string& to) {
+            for (size_t position = text.find(from); position != std::string::npos; position = text.find(from, position + to.size()))
+                text.replace(position, from.size(), to);
+        }
+
+        static cache::HttpResponse refuse(int status, const std::string& reason) {
+            return { status, { { "Content-Type", "text/plain" } }, reason };
+        }
+
+        /// Where a client path lives in the job's copy of the project.
+        static fs::path mirror_path(const fs::path& mirror, const std::string& path) {
+            return mirror / fs::path(path).relative_path();
+        }
+
+        Worker::Worker(WorkerOptions options) :
+            options_(std::move(options)),
+            root_(options_.dir.empty() ? cache::default_cache_dir() / "worker" : fs::path(options_.dir)),
+            files_(root_ / "files", options_.max_size ? options_.max_size : cache::default_cache_size()),
+            server_(
+                options_.bind,
+                options_.port,
+                options_.threads ? options_.threads : std::max(1u, std::thread::hardware_concurrency()),
+                [this](const cache::HttpRequest& request) { return handle(request); }) {
+            // Leftovers of jobs interrupted by a previous run
+            std::error_code ec;
+            fs::remove_all(root_ / "jobs", ec);
+        }
+
+        Result<void> Worker::listen() {
+            return server_.listen();
+        }
+
+        void Worker::serve() {
+            server_.serve();
+        }
+
+        void Worker::stop() {
+            server_.stop();
+        }
+
+        std::string Worker::identity(const std::string& compiler) {
+            std::lock_guard lock(identities_mutex_);
+            auto it = identities_.find(compiler);
+            if (it == identities_.end())
+                it = identities_.emplace(compiler, cache::compiler_identity(compiler)).first;
+            return it->second;
+        }
+
+        cache::HttpResponse Worker::handle(const cache::HttpRequest& request) {
+            const auto path = request.path.substr(0, request.path.find('?'));
+
+            if (path == "/compile" && request.method == "POST") {
+                const auto job_dir = root_ / "jobs" / std::to_string(next_job_++);
+                auto response = compile(request.body, job_dir);
+
+                std::error_code ec;
+                fs::remove_all(job_dir, ec);
+                return response;
+            }
+
+            if (path == "/missing" && request.method == "POST") {
+                std::string missing;
+                std::istringstream stream(request.body);
+                for (std::string hash; std::getline(stream, hash);)
+                    if (is_hash(hash) && !files_.contains(hash, "src"))
+                        missing += hash + "\n";
+                return { 200, {}, missing };
+            }
+
+            if (path.starts_with("/files/") && request.method == "PUT") {
+                const auto hash = path.substr(7);
+                if (!is_hash(hash))
+                    return refuse(404, "");
+                if (cache::sha256_hex(request.body) != hash)
+                    return refuse(400, "content does not match its hash");
+                if (!files_.write(hash, "src", request.body))
+                    return refuse(500, "");
+
+                files_.evict(hash);
+                return { 200, {}, "" };
+            }
+
+            return refuse(404, "");
+        }
+
+        cache::HttpResponse Worker::compile(const std::string& body, const fs::path& job_dir) {
+            const auto fields = decode_fields(body);
+            if (!fields)
+                return refuse(400, fields.error().message);
+
+            if (find_field(*fields, "version") != PROTOCOL_VERSION)
+                return refuse(400, "unsupported protocol version");
+
+            const auto compiler = find_field(*fields, "compiler").value_or("");
+            if (!is_allowed_compiler(compiler))
+                return refuse(403, "compiler '" + compiler + "' is not allowed");
+
+            if (find_field(*fields, "identity") != identity(compiler))
+                return refuse(409, "the worker's " + compiler + " is a different version");
+
+            std::error_code ec;
+            fs::create_directories(job_dir, ec);
+
+            const auto object = job_dir / "tu.o";
+            const auto mode = find_field(*fields, "mode").value_or("");
+            auto args = find_fields(*fields, "arg");
+
+            std::vector<std::string> command = { compiler };
+            fs::path cwd = job_dir;
+            std::string mirror_prefix;
+
+            if (mode == "preprocessed") {
+                const auto source = job_dir / (find_field(*fields, "language") == "c" ? "tu.i" : "tu.ii");
+                {
+                    std::ofstream out(source, std::ios::binary);
+                    out << find_field(*fields, "source").value_or("");
+                }
+
+                command.insert(command.end(), args.begin(), args.end());
+                command.insert(command.end(), { "-c", source.string(), "-o", object.string() });
+            } else if (mode == "pump") {
+                const auto project_root = find_field(*fields, "root").value_or("");
+                if (project_root.empty() || !fs::path(project_root).is_absolute())
+                    return refuse(400, "missing project root");
+
+                const auto mirror = job_dir / "root";
+                mirror_prefix = mirror.generic_string();
+
+                for (const auto& file : find_fields(*fields, "file")) {
+                    const auto tab = file.find('\t');
+                    const auto hash = file.substr(0, tab);
+                    const auto path = tab == std::string::npos ? "" : file.substr(tab + 1);
+                    if (!is_hash(hash) || !is_under(path, project_root))
+                        return refuse(400, "invalid file '" + file + "'");
+
+                    const auto destination = mirror_path(mirror, path);
+                    fs::create_directories(destination.parent_path(), ec);
+                    if (!files_.fetch(hash, "src", destination))
+                        return refuse(412, "missing file " + path);
+                }
+
+                for (const auto& header : find_fields(*fields, "system"))
+                    if (!fs::exists(header, ec))
+                        return refuse(409, "the worker has no " + header);
+
+                // Paths into the project point at the job's copy of it
+                auto remap = [&](const std::string& arg) {
+                    for (const std::string prefix : PATH_FLAGS) {
+                        const auto rest = arg.substr(std::min(arg.size(), prefix.size()));
+                        if (arg.starts_with(prefix) && is_under(rest, project_root))
+                            return prefix + mirror_path(mirror, rest).generic_string();
+                    }
+                    return is_under(arg, project_root) ? mirror_path(mirror, arg).generic_string() : arg;
+                };
+
+                for (const auto& arg : args)
+                    command.push_back(remap(arg));
+
+                const auto client_cwd = find_field(*fields, "cwd").value_or("");
+                if (is_under(client_cwd, project_root))
+                    cwd = mirror_path(mirror, client_cwd);
+                fs::create_directories(cwd, ec);
+
+                command.insert(command.end(), { "-c", remap(find_field(*fields, "input").value_or("")), "-o", object.string() });
+            } else {
+                return refuse(400, "unknown mode '" + mode + "'");
+            }
+
+            auto result = util::process::run(command, cwd.string());
+            if (!result)
+                return refuse(500, result.error().message);
+
+            // Diagnostics name the client's paths, not the job's copy
+            if (!mirror_prefix.empty()) {
+                replace_all(result->out, mirror_prefix, "");
+                replace_all(result->err, mirror_prefix, "");
+            }
+
+            Fields reply = {
+                { "exit", std::to_string(result->exit_code) },
+                { "stdout", result->out },
+                { "stderr", result->err },
+            };
+            if (result->exit_code == 0)
+                reply.emplace_back("object", read_file(object));
+
+            return { 200, { { "Content-Type", "application/octet-stream" } }, encode_fields(reply) };
+        }
+    } // namespace dist
+
+    Result<void> worker(const WorkerOptions& options) {
+        dist::Worker worker(options);
+        TRYV(worker.listen());
+
+        muuk::logger::info(
+            "Compiling for muuk clients on http://{}:{}",
+            options.bind,
+            worker.port());
+
+        worker.serve();
+        return {};
+    }
+} // namespace muuk
@@ -37,6 +37,14 @@ inline void force_oneline(toml::value& v) {
 
 namespace muuk {
     namespace lockgen {
+        /// Resolves the `pch` key against the package's base path.
+        static std::string load_pch(const toml::value& v, const std::string& base_path) {
+            const auto header = toml::try_find_or<std::string>(v, "pch", "");
+            if (header.empty())
+                return header;
+
+            return util::file_system::to_unix_path((fs::path(base_path) / header).lexically_normal().string());
+        }
 
         Result<void> Dependency::load(const std::string name_, const toml::value& v) {
             name = name_;
@@ -91,10 +99,13 @@ namespace muuk {
         }
 
         toml::value source_file::serialize() const {
-            return toml::table {
+            toml::value out = toml::table {
                 { "path", path },
                 { "cflags", cflags }
             };
+            if (!pool.empty())
+                out["pool"] = pool;
+            return out;
         }
 
         void Compilers::load(const toml::value& v, const std::string& base_path) {
@@ -156,6 +167,12 @@ namespace muuk {
                 {});
             lockgen::load(settings, v);
             lockgen::load(sanitizers, v);
+            lockgen::load(unity, v);
+            lockgen::load(debug_info, v);
+            linker = toml::try_find_or<std::string>(v, "linker", "");
+            layout = toml::try_find_or<std::string>(v, "layout", "");
+            archives = toml::try_find_or<std::string>(v, "archives", "");
+            pools = toml::try_find_or<std::map<std::string, int64_t>>(v, "pools", {});
         }
 
         void ProfileConfig::serialize(toml::value& out) const {
@@ -167,6 +184,20 @@ namespace muuk {
 
             lockgen::serialize(settings, out);
             lockgen::serialize(sanitizers, out);
+            lockgen::serialize(unity, out);
+            lockgen::serialize(debug_info, out);
+            if (!linker.empty())
+                out["linker"] = linker;
+            if (!layout.empty())
+                out["layout"] = layout;
+            if (!archives.empty())
+                out["archives"] = archives;
+            if (!pools.empty()) {
+                toml::value pools_out = toml::table {};
+                for (const auto& [pool, depth] : pools)
+                    pools_out[pool] = depth;
+                out["pools"] = pools_out;
+            }
         }
 
         void Library::load(const std::string& name_, const std::string& version_, const std::string& base_path_, const toml::value& v) {
@@ -174,6 +205,10 @@ namespace muuk {
             version = version_;
 
             BaseConfig<Library>::load(v, base_path_);
+            pch = load_pch(v, base_path_);
+            lockgen::load(unity, v);
+            isa_levels = toml::try_find_or<std::vector<std::string>>(v, "isa_levels", {});
+            ispc = parse_sources(v, base_path_, "ispc");
         }
 
         void Library::serialize(toml::value& out, Platforms platforms_, Compilers compilers_) const {
@@ -182,6 +217,20 @@ namespace muuk {
             BaseConfig<Library>::serialize(out);
             out["profiles"] = profiles;
 
+            if (!pch.empty())
+                out["pch"] = pch;
+
+            lockgen::serialize(unity, out);
+
+            if (!isa_levels.empty())
+                out["isa_levels"] = isa_levels;
+
+            toml::array kernels;
+            for (const auto& kernel : expand_glob_sources(ispc))
+                kernels.push_back(kernel.serialize());
+            if (!kernels.empty())
+                out["ispc"] = kernels;
+
             platforms_.serialize(out);
             compilers_.serialize(out);
         }
@@ -271,6 +320,11 @@ namespace muuk {
 
             out["link"] = muuk::to_string(link_type);
 
+            if (!pch.empty())
+                out["pch"] = pch;
+
+            lockgen::serialize(unity, out);
+
             compilers.serialize(out);
             platforms.serialize(out);
 
@@ -302,6 +356,8 @@ namespace muuk {
 
         void Build::load(const toml::value& v, const std::string& base_path) {
             BaseConfig<Build>::load(v, base_path);
+            pch = load_pch(v, base_path);
+            lockgen::load(unity, v);
 
             profiles = toml::try_find_or<std::unordered_set<std::string>>(v, "profile", {});
 
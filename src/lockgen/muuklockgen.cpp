@@ -395,6 +395,9 @@ namespace muuk {
                 if (lib_table.contains("modules"))
                     lib_table.at("modules").as_array_fmt().fmt = toml::array_format::multiline;
 
+                if (lib_table.contains("ispc"))
+                    lib_table.at("ispc").as_array_fmt().fmt = toml::array_format::multiline;
+
                 library_array.as_array().push_back(lib_table);
 
                 muuk::logger::info("Written package '{}' to lockfile.", package_name);
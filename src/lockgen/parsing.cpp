@@ -50,7 +50,7 @@ namespace muuk {
                 debug_profile.settings.debug = true;
                 debug_profile.settings.optimization_level = OptimizationLevel::O0;
                 debug_profile.settings.debug_assertions = true;
-                debug_profile.settings.lto = false;
+                debug_profile.settings.lto = "";
                 debug_profile.sanitizers.address = true;
                 debug_profile.sanitizers.undefined = true;
 
@@ -59,7 +59,7 @@ namespace muuk {
                 release_profile.settings.debug = false;
                 release_profile.settings.optimization_level = OptimizationLevel::O3;
                 debug_profile.settings.debug_assertions = false;
-                release_profile.settings.lto = true;
+                release_profile.settings.lto = "fat";
                 debug_profile.sanitizers.undefined = true;
 
                 profiles_config_["debug"] = std::move(debug_profile);
@@ -21,8 +21,16 @@ namespace muuk {
                 }
             }
 
-            if (v.contains("lto"))
-                settings.lto = v.at("lto").as_boolean();
+            if (v.contains("lto")) {
+                if (v.at("lto").is_boolean())
+                    settings.lto = v.at("lto").as_boolean() ? "fat" : "";
+                else if (v.at("lto").is_string())
+                    settings.lto = v.at("lto").as_string() == "off" ? "" : v.at("lto").as_string();
+            }
+            if (v.contains("lto-partition"))
+                settings.lto_partition = v.at("lto-partition").as_string();
+            if (v.contains("lto-jobs"))
+                settings.lto_jobs = v.at("lto-jobs").as_integer();
             if (v.contains("debug"))
                 settings.debug = v.at("debug").as_boolean();
             if (v.contains("rpath"))
@@ -33,7 +41,14 @@ namespace muuk {
 
         void serialize(const Settings& settings, toml::value& out) {
             out["opt-level"] = to_string(settings.optimization_level);
-            out["lto"] = settings.lto;
+            if (settings.lto.empty())
+                out["lto"] = false;
+            else
+                out["lto"] = settings.lto;
+            if (!settings.lto_partition.empty())
+                out["lto-partition"] = settings.lto_partition;
+            if (settings.lto_jobs)
+                out["lto-jobs"] = *settings.lto_jobs;
             out["debug"] = settings.debug;
             out["rpath"] = settings.rpath;
             out["debug-assertions"] = settings.debug_assertions;
@@ -81,5 +96,34 @@ namespace muuk {
             if (!san_array.empty())
                 out["sanitizers"] = std::move(san_array);
         }
+
+        void load(Unity& unity, const toml::value& v) {
+            if (v.contains("unity"))
+                unity.enabled = v.at("unity").as_boolean();
+            if (v.contains("unity_batch"))
+                unity.batch = v.at("unity_batch").as_integer();
+        }
+
+        void serialize(const Unity& unity, toml::value& out) {
+            if (unity.enabled)
+                out["unity"] = *unity.enabled;
+            if (unity.batch)
+                out["unity_batch"] = *unity.batch;
+        }
+
+        void load(DebugInfo& debug_info, const toml::value& v) {
+            debug_info.split = toml::try_find_or<std::string>(v, "split-debuginfo", "");
+            debug_info.compress = toml::try_find_or<std::string>(v, "compress-debug", "");
+            debug_info.dependencies = toml::try_find_or<std::string>(v, "dependency-debug", "");
+        }
+
+        void serialize(const DebugInfo& debug_info, toml::value& out) {
+            if (!debug_info.split.empty())
+                out["split-debuginfo"] = debug_info.split;
+            if (!debug_info.compress.empty())
+                out["compress-debug"] = debug_info.compress;
+            if (!debug_info.dependencies.empty())
+                out["dependency-debug"] = debug_info.dependencies;
+        }
     };
 }
\ No newline at end of file
@@ -20,6 +20,9 @@ namespace muuk {
             if (!section.contains(key))
                 return temp_sources;
 
+            // A package's `pool` applies to each of its sources
+            const auto package_pool = toml::try_find_or<std::string>(section, "pool", "");
+
             for (const auto& src : section.at(key).as_array()) {
 
                 // (1)
@@ -51,7 +54,8 @@ namespace muuk {
 
                     temp_sources.emplace_back(
                         util::file_system::to_unix_path(full_path.lexically_normal().string()),
-                        extracted_cflags);
+                        extracted_cflags,
+                        package_pool);
                 }
 
                 // (2)
@@ -72,7 +76,8 @@ namespace muuk {
 
                     temp_sources.emplace_back(
                         util::file_system::to_unix_path(path.lexically_normal().string()),
-                        cflags);
+                        cflags,
+                        toml::try_find_or<std::string>(src, "pool", package_pool));
                 }
             }
 
@@ -154,7 +159,7 @@ namespace muuk {
                 try {
                     auto globbed_paths = glob::rglob(s.path);
                     for (const auto& path : globbed_paths)
-                        expanded.emplace_back(util::file_system::to_unix_path(path.string()), s.cflags);
+                        expanded.emplace_back(util::file_system::to_unix_path(path.string()), s.cflags, s.pool);
 
                 } catch (const std::exception& e) {
                     muuk::logger::warn("Error while globbing '{}': {}", s.path, e.what());
@@ -1,5 +1,6 @@
 #define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
 
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -7,14 +8,22 @@
 #include <fmt/ostream.h>
 #include <nlohmann/json.hpp>
 
+#include "build/isa.hpp"
+#include "build/stats.hpp"
 #include "buildconfig.h"
 #include "commands/add.hpp"
 #include "commands/build.hpp"
+#include "commands/cache_server.hpp"
+#include "commands/cc_wrap.hpp"
 #include "commands/clean.hpp"
+#include "commands/headers.hpp"
+#include "commands/pgo.hpp"
 #include "commands/init.hpp"
 #include "commands/install.hpp"
 #include "commands/remove.hpp"
 #include "commands/run.hpp"
+#include "commands/stats.hpp"
+#include "commands/worker.hpp"
 #include "logger.hpp"
 #include "muuk_parser.hpp"
 #include "rustify.hpp"
@@ -72,9 +81,175 @@ int main(int argc, char* argv[]) {
         .default_value(std::string("")) // TODO: Eventually parse the default profile from the config file
         .nargs(1);
     build_command.add_argument("-j", "--jobs")
-        .help("Number of jobs to run in parallel (0 means infinity)")
-        .default_value(std::string("1"))
+        .help("Number of jobs to run in parallel: `auto` sizes it by the CPUs and memory (0 means infinity)")
+        .default_value(std::string("auto"))
         .nargs(1);
+    build_command.add_argument("--auto-pch")
+        .help("Precompile the headers shared by most translation units of each package")
+        .flag();
+    build_command.add_argument("--cache")
+        .help("Cache compiled objects in ~/.cache/muuk (GCC and Clang)")
+        .flag();
+    build_command.add_argument("--remote-cache")
+        .help("Share compiled objects through an HTTP cache (e.g. http://cache:8080), implies --cache")
+        .default_value(std::string(""))
+        .nargs(1);
+
+    build_command.add_argument("--artifact-cache")
+        .help("Reuse dependency archives built by other projects on this machine")
+        .flag();
+
+    build_command.add_argument("--workers")
+        .help("Send compiles to `muuk worker`s (e.g. http://farm1:3633,http://farm2:3633)")
+        .default_value(std::string(""))
+        .nargs(1);
+
+    build_command.add_argument("--pump")
+        .help("With --workers, send each header once per worker instead of preprocessed sources")
+        .flag();
+
+    build_command.add_argument("--executor")
+        .help("Run the build with `ninja` or muuk's built-in `native` executor")
+        .default_value(std::string("ninja"))
+        .nargs(1);
+
+    build_command.add_argument("--compile-profile")
+        .help("Profile every translation unit and report the most expensive headers and templates (Clang)")
+        .flag();
+
+    build_command.add_argument("--timings")
+        .help("Write a timing report (timings.html, trace.json) to build/<profile> after the build")
+        .flag();
+
+    build_command.add_argument("--stats")
+        .help("Record the CPU time and peak memory of every compile and link in build/<profile>/.muuk_stats")
+        .flag();
+
+    build_command.add_argument("--watch")
+        .help("Stay running and rebuild whenever a manifest, source or header changes (Linux)")
+        .flag();
+
+    build_command.add_argument("--run")
+        .help("Script from [scripts] to run after each successful build in --watch mode")
+        .default_value(std::string(""))
+        .nargs(1);
+
+    argparse::ArgumentParser headers_command("headers", "Rank headers by their cost to the build, from the last build's dependencies");
+    headers_command.add_argument("-c", "--compiler")
+        .help("Compiler the project was built with (e.g., gcc, clang, cl)")
+#ifdef _WIN32
+        .default_value(std::string("cl"))
+#elif defined(__APPLE__)
+        .default_value(std::string("clang"))
+#elif defined(__linux__)
+        .default_value(std::string("gcc"))
+#endif
+        .nargs(1);
+    headers_command.add_argument("-p", "--profile")
+        .help("Build profile to analyze")
+        .default_value(std::string(""))
+        .nargs(1);
+    headers_command.add_argument("--top")
+        .help("Number of headers listed per section")
+        .default_value(20)
+        .scan<'i', int>();
+
+    argparse::ArgumentParser stats_command("stats", "Summarize the heaviest commands recorded by `muuk build --stats`");
+    stats_command.add_argument("-p", "--profile")
+        .help("Build profile to summarize")
+        .default_value(std::string(""))
+        .nargs(1);
+    stats_command.add_argument("--top")
+        .help("Number of commands listed per section")
+        .default_value(20)
+        .scan<'i', int>();
+
+    argparse::ArgumentParser pgo_command("pgo", "Build with profile-guided optimization, using the training commands of [pgo]");
+    pgo_command.add_argument("-c", "--compiler")
+        .help("Specify a compiler to use (gcc or clang)")
+#ifdef __linux__
+        .default_value(std::string("gcc"))
+#else
+        .default_value(std::string("clang"))
+#endif
+        .nargs(1);
+    pgo_command.add_argument("-p", "--profile")
+        .help("Profile to optimize (default: `profile` in [pgo], then the default profile)")
+        .default_value(std::string(""))
+        .nargs(1);
+    pgo_command.add_argument("-j", "--jobs")
+        .help("Number of jobs to run in parallel: `auto` sizes it by the CPUs and memory (0 means infinity)")
+        .default_value(std::string("auto"))
+        .nargs(1);
+    pgo_command.add_argument("--executor")
+        .help("Run the builds with `ninja` or muuk's built-in `native` executor")
+        .default_value(std::string("ninja"))
+        .nargs(1);
+
+    argparse::ArgumentParser cc_wrap_command("cc-wrap", "Run a compiler command through the compilation cache");
+    cc_wrap_command.add_argument("compiler_command")
+        .remaining()
+        .help("The compiler command, e.g. `muuk cc-wrap -- g++ -c a.cpp -o a.o`")
+        .default_value(std::vector<std::string> {});
+
+    argparse::ArgumentParser exec_command("exec", "Run a command and record its resource usage");
+    exec_command.add_argument("--stats")
+        .help("File the usage is appended to")
+        .required();
+    exec_command.add_argument("command")
+        .remaining()
+        .help("The command, e.g. `muuk exec --stats .muuk_stats -- g++ -c a.cpp -o a.o`")
+        .default_value(std::vector<std::string> {});
+
+    argparse::ArgumentParser isa_archive_command("isa-archive", "Archive the ISA variants of a library behind a runtime dispatcher");
+    isa_archive_command.add_argument("--compiler")
+        .help("C compiler for the dispatch stub")
+        .required();
+    isa_archive_command.add_argument("--archiver")
+        .help("Archiver")
+        .required();
+    isa_archive_command.add_argument("--levels")
+        .help("Comma separated ISA levels, baseline first")
+        .required();
+    isa_archive_command.add_argument("-o", "--output")
+        .help("The archive to write")
+        .required();
+    isa_archive_command.add_argument("objects")
+        .remaining()
+        .help("Object files, e.g. `a.cpp.x86-64-v3.o`")
+        .default_value(std::vector<std::string> {});
+
+    argparse::ArgumentParser cache_server_command("cache-server", "Serve a directory as a remote compilation cache");
+    cache_server_command.add_argument("--dir")
+        .help("Directory to store the cache in (default: <cache dir>/server)")
+        .default_value(std::string(""));
+    cache_server_command.add_argument("--bind")
+        .help("Address to listen on")
+        .default_value(std::string("127.0.0.1"));
+    cache_server_command.add_argument("--port")
+        .help("Port to listen on")
+        .default_value(8080)
+        .scan<'i', int>();
+    cache_server_command.add_argument("--threads")
+        .help("Number of worker threads")
+        .default_value(8)
+        .scan<'i', int>();
+
+    argparse::ArgumentParser worker_command("worker", "Compile translation units sent by other muuk builds");
+    worker_command.add_argument("--dir")
+        .help("Directory for shipped headers and jobs (default: <cache dir>/worker)")
+        .default_value(std::string(""));
+    worker_command.add_argument("--bind")
+        .help("Address to listen on")
+        .default_value(std::string("127.0.0.1"));
+    worker_command.add_argument("--port")
+        .help("Port to listen on")
+        .default_value(3633)
+        .scan<'i', int>();
+    worker_command.add_argument("--threads")
+        .help("Number of concurrent compiles (0 means one per hardware thread)")
+        .default_value(0)
+        .scan<'i', int>();
 
     argparse::ArgumentParser download_command("install", "Install a package from github");
 
@@ -110,6 +285,14 @@ int main(int argc, char* argv[]) {
     program.add_subparser(remove_command);
     program.add_subparser(init_command);
     program.add_subparser(add_command);
+    program.add_subparser(cc_wrap_command);
+    program.add_subparser(exec_command);
+    program.add_subparser(isa_archive_command);
+    program.add_subparser(cache_server_command);
+    program.add_subparser(worker_command);
+    program.add_subparser(headers_command);
+    program.add_subparser(stats_command);
+    program.add_subparser(pgo_command);
 
     if (argc < 2) {
         fmt::print("Usage: {} <command> [--muuk-path <path>] [other options]", std::string(argv[0]));
@@ -127,6 +310,79 @@ int main(int argc, char* argv[]) {
             return check_and_report(muuk::init_project());
         }
 
+        if (program.is_subcommand_used("cc-wrap")) {
+            auto command = cc_wrap_command.get<std::vector<std::string>>("compiler_command");
+            if (!command.empty() && command.front() == "--")
+                command.erase(command.begin());
+
+            const auto result = muuk::cc_wrap(command);
+            if (!result) {
+                muuk::terminal::error(result.error().message);
+                return 1;
+            }
+            return result.value();
+        }
+
+        if (program.is_subcommand_used("exec")) {
+            auto command = exec_command.get<std::vector<std::string>>("command");
+            if (!command.empty() && command.front() == "--")
+                command.erase(command.begin());
+
+            const auto result = muuk::build::exec(exec_command.get<std::string>("--stats"), command);
+            if (!result) {
+                muuk::terminal::error(result.error().message);
+                return 1;
+            }
+            return result.value();
+        }
+
+        if (program.is_subcommand_used("isa-archive")) {
+            muuk::build::isa::ArchiveOptions options;
+            options.compiler = isa_archive_command.get<std::string>("--compiler");
+            options.archiver = isa_archive_command.get<std::string>("--archiver");
+            options.output = isa_archive_command.get<std::string>("--output");
+            std::istringstream levels(isa_archive_command.get<std::string>("--levels"));
+            for (std::string level; std::getline(levels, level, ',');)
+                options.levels.push_back(level);
+            options.objects = util::process::expand_response_files(isa_archive_command.get<std::vector<std::string>>("objects"));
+            if (!options.objects.empty() && options.objects.front() == "--")
+                options.objects.erase(options.objects.begin());
+
+            return check_and_report(muuk::build::isa::archive(options));
+        }
+
+        if (program.is_subcommand_used("cache-server")) {
+            const auto port = cache_server_command.get<int>("--port");
+            const auto threads = cache_server_command.get<int>("--threads");
+            if (port < 0 || port > 65535 || threads < 1) {
+                muuk::logger::error("Invalid port or thread count for 'cache-server'.");
+                return 1;
+            }
+
+            muuk::CacheServerOptions options;
+            options.dir = cache_server_command.get<std::string>("--dir");
+            options.bind = cache_server_command.get<std::string>("--bind");
+            options.port = static_cast<uint16_t>(port);
+            options.threads = static_cast<size_t>(threads);
+            return check_and_report(muuk::cache_server(options));
+        }
+
+        if (program.is_subcommand_used("worker")) {
+            const auto port = worker_command.get<int>("--port");
+            const auto threads = worker_command.get<int>("--threads");
+            if (port < 0 || port > 65535 || threads < 0) {
+                muuk::logger::error("Invalid port or thread count for 'worker'.");
+                return 1;
+            }
+
+            muuk::WorkerOptions options;
+            options.dir = worker_command.get<std::string>("--dir");
+            options.bind = worker_command.get<std::string>("--bind");
+            options.port = static_cast<uint16_t>(port);
+            options.threads = static_cast<size_t>(threads);
+            return check_and_report(muuk::worker(options));
+        }
+
         if (program.is_subcommand_used("install")) {
             muuk::logger::info("Installing dependencies from muuk.toml...");
             return check_and_report(muuk::install("muuk.lock"));
@@ -192,6 +448,42 @@ int main(int argc, char* argv[]) {
             return check_and_report(muuk::clean(muuk_config));
         }
 
+        if (program.is_subcommand_used("headers")) {
+            const auto top = headers_command.get<int>("--top");
+            if (top < 1) {
+                muuk::logger::error("Invalid value for --top.");
+                return 1;
+            }
+
+            muuk::HeadersOptions options;
+            options.compiler = headers_command.get<std::string>("--compiler");
+            options.profile = headers_command.get<std::string>("--profile");
+            options.top = static_cast<size_t>(top);
+            return check_and_report(muuk::headers_cmd(options, muuk_config));
+        }
+
+        if (program.is_subcommand_used("stats")) {
+            const auto top = stats_command.get<int>("--top");
+            if (top < 1) {
+                muuk::logger::error("Invalid value for --top.");
+                return 1;
+            }
+
+            muuk::StatsOptions options;
+            options.profile = stats_command.get<std::string>("--profile");
+            options.top = static_cast<size_t>(top);
+            return check_and_report(muuk::stats_cmd(options, muuk_config));
+        }
+
+        if (program.is_subcommand_used("pgo")) {
+            muuk::BuildOptions options;
+            options.compiler = pgo_command.get<std::string>("--compiler");
+            options.profile = pgo_command.get<std::string>("--profile");
+            options.jobs = pgo_command.get<std::string>("--jobs");
+            options.executor = pgo_command.get<std::string>("--executor");
+            return check_and_report(muuk::pgo_cmd(options, muuk_config));
+        }
+
         if (program.is_subcommand_used("run")) {
             const auto script = run_command.present<std::string>("script");
             const auto extra_args = run_command.get<std::vector<std::string>>("extra_args");
@@ -206,16 +498,29 @@ int main(int argc, char* argv[]) {
         }
 
         if (program.is_subcommand_used("build")) {
-            std::string target_build = build_command.get<std::string>("--target-build");
-            std::string compiler = build_command.get<std::string>("--compiler");
-            std::string profile = build_command.get<std::string>("--profile");
-            std::string jobs = build_command.get<std::string>("--jobs");
+            muuk::BuildOptions options;
+            options.target_build = build_command.get<std::string>("--target-build");
+            options.compiler = build_command.get<std::string>("--compiler");
+            options.profile = build_command.get<std::string>("--profile");
+            options.jobs = build_command.get<std::string>("--jobs");
+            options.auto_pch = build_command.get<bool>("--auto-pch");
+            options.compile_cache = build_command.get<bool>("--cache");
+            options.remote_cache = build_command.get<std::string>("--remote-cache");
+            options.artifact_cache = build_command.get<bool>("--artifact-cache");
+            options.executor = build_command.get<std::string>("--executor");
+            options.workers = build_command.get<std::string>("--workers");
+            options.pump = build_command.get<bool>("--pump");
+            options.timings = build_command.get<bool>("--timings");
+            options.stats = build_command.get<bool>("--stats");
+            options.compile_profile = build_command.get<bool>("--compile-profile");
+            if (build_command.get<bool>("--watch"))
+                return check_and_report(muuk::watch_cmd(
+                    options,
+                    build_command.get<std::string>("--run"),
+                    muuk_config));
             return check_and_report(muuk::build_cmd(
-                target_build,
-                compiler,
-                profile,
-                muuk_config,
-                jobs));
+                options,
+                muuk_config));
         }
     } catch (const std::runtime_error& err) {
         muuk::logger::error(std::string(err.what()) + "\n");
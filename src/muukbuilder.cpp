@@ -1,13 +1,32 @@
 #include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <vector>
 
+#include <fmt/format.h>
 #include <toml.hpp>
 
+#include "build/artifacts.hpp"
 #include "build/backend.hpp"
+#include "build/compile_profile.hpp"
+#include "build/deps.hpp"
+#include "build/include_graph.hpp"
 #include "build/manager.hpp"
 #include "build/parser.hpp"
+#include "build/pgo.hpp"
+#include "build/resources.hpp"
+#include "build/stats.hpp"
+#include "build/watch.hpp"
+#include "build/timings.hpp"
 #include "buildconfig.h"
+#include "cache/http.hpp"
 #include "commands/build.hpp"
+#include "commands/headers.hpp"
+#include "commands/pgo.hpp"
+#include "commands/run.hpp"
+#include "commands/stats.hpp"
 #include "compiler.hpp"
 #include "lockgen/muuklockgen.hpp"
 #include "logger.hpp"
@@ -149,24 +168,31 @@ namespace muuk {
         return {};
     }
 
-    Result<void> build_cmd(const std::string& target_build, const std::string& compiler, const std::string& profile, const toml::value& config, const std::string& jobs) {
+    Result<void> build_cmd(const BuildOptions& options, const toml::value& config) {
+        const auto& [target_build, compiler, profile, jobs, auto_pch, compile_cache, remote_cache, artifact_cache, workers, pump, executor, timings, stats, compile_profile, pgo_instrument, refresh_lock] = options;
+
         util::file_system::ensure_directory_exists("build/" + profile);
 
-        if (!jobs.empty() && !util::is_integer(jobs))
+        if (!jobs.empty() && jobs != "auto" && !util::is_integer(jobs))
             return Err("Invalid number of jobs specified: " + jobs);
 
+        if (executor != "ninja" && executor != "native")
+            return Err("Unknown executor '{}'. Expected 'ninja' or 'native'.", executor);
+
         auto muuk_result = muuk::parse_muuk_file<toml::ordered_type_config>("muuk.toml", false);
         if (!muuk_result)
             return Err(muuk_result);
 
         auto muuk_file = muuk_result.value();
 
-        // TODO: Pass the config to the lock generator
-        auto lock_generator_ = lockgen::MuukLockGenerator::create("./");
-        if (!lock_generator_)
-            return Err(lock_generator_.error());
+        if (refresh_lock || !fs::exists(MUUK_CACHE_FILE)) {
+            // TODO: Pass the config to the lock generator
+            auto lock_generator_ = lockgen::MuukLockGenerator::create("./");
+            if (!lock_generator_)
+                return Err(lock_generator_.error());
 
-        TRYV(lock_generator_->generate_cache(MUUK_CACHE_FILE));
+            TRYV(lock_generator_->generate_cache(MUUK_CACHE_FILE));
+        }
 
         auto compiler_result = compiler.empty()
             ? detect_default_compiler()
@@ -184,9 +210,13 @@ namespace muuk {
             return Err(profile_result);
         auto selected_profile = profile_result.value();
 
+        // The instrumented build of `muuk pgo` lives next to the profile's own
+        const auto pgo_stage = pgo_instrument ? build::pgo::Stage::Instrument : build::pgo::Stage::Optimize;
+        const auto build_name = pgo_instrument ? build::pgo::instrumented_profile(selected_profile) : selected_profile;
+
         auto build_manager = std::make_unique<build::BuildManager>();
 
-        if (muuk_file.contains("build")) {
+        if (muuk_file.contains("build") && !pgo_instrument) {
             const auto& builds = muuk_file["build"].as_table();
             for (const auto& [build_name, _] : builds) {
                 muuk::logger::info("Adding script for build target '{}'", build_name);
@@ -197,28 +227,385 @@ namespace muuk {
         TRYV(parse(
             *build_manager,
             selected_compiler,
-            fs::path("build") / selected_profile,
-            selected_profile));
+            fs::path("build") / build_name,
+            selected_profile,
+            { auto_pch, artifact_cache, pgo_stage }));
+
+        if (const auto data = build::pgo::profile_data(selected_compiler, selected_profile); !pgo_instrument && fs::exists(data)) {
+            const auto stale = build::pgo::stale_sources(*build_manager, data);
+            if (!stale.empty())
+                muuk::logger::warn(
+                    "{} source files (e.g. '{}') changed since the profile '{}' was merged. Run 'muuk pgo' to refresh it.",
+                    stale.size(),
+                    stale.front(),
+                    data.generic_string());
+        }
 
-        build::NinjaBackend build_backend(
-            *build_manager,
-            selected_compiler,
-            selected_archiver,
-            selected_linker);
+        std::unique_ptr<build::BuildBackend> build_backend;
+        if (executor == "native")
+            build_backend = std::make_unique<build::NativeBackend>(
+                *build_manager,
+                selected_compiler,
+                selected_archiver,
+                selected_linker);
+        else
+            build_backend = std::make_unique<build::NinjaBackend>(
+                *build_manager,
+                selected_compiler,
+                selected_archiver,
+                selected_linker);
+
+        if (!remote_cache.empty()) {
+            auto url = cache::parse_url(remote_cache);
+            if (!url)
+                return Err(url);
+
+            // Inherited by ninja and the `cc-wrap` edges it runs
+            util::process::set_env("MUUK_REMOTE_CACHE", remote_cache);
+        }
 
-        build_backend.generate_build_file(selected_profile);
+        if (!workers.empty()) {
+            std::istringstream stream(workers);
+            for (std::string worker; std::getline(stream, worker, ',');) {
+                worker = util::trim_whitespace(worker);
+                if (auto url = cache::parse_url(worker); !worker.empty() && !url)
+                    return Err(url);
+            }
 
-        muuk::logger::info("Generating Ninja file for '{}'", selected_profile);
-        build_backend.generate_build_file(selected_profile);
+            // Read by the `cc-wrap` edges
+            util::process::set_env("MUUK_WORKERS", workers);
+            util::process::set_env("MUUK_WORKERS_PUMP", pump ? "1" : "");
+            util::process::set_env("MUUK_PROJECT_ROOT", fs::current_path().string());
 
-        execute_build(selected_profile, target_build, jobs);
-        generate_compile_commands(
-            *build_manager,
-            selected_profile,
-            selected_compiler,
-            selected_archiver,
-            selected_linker);
+            if (!compile_cache && remote_cache.empty())
+                util::process::set_env("MUUK_CACHE_DISABLE", "1");
+        }
+
+        if (compile_cache || !remote_cache.empty() || !workers.empty()) {
+            if (selected_compiler == muuk::Compiler::MSVC)
+                muuk::logger::warn("The compilation cache and workers only support GCC and Clang. Building without them.");
+            else
+                build_backend->set_compiler_launcher(
+                    util::process::quote(util::process::current_executable()) + " cc-wrap --");
+        }
+
+        if (compile_profile) {
+            if (selected_compiler == muuk::Compiler::GCC)
+                muuk::logger::warn("GCC prints a -ftime-report per translation unit; only Clang's time traces are aggregated.");
+            else if (selected_compiler == muuk::Compiler::MSVC)
+                muuk::logger::warn("--compile-profile is not supported with MSVC.");
+            build_backend->set_extra_cflags(build::compile_profile_flags(selected_compiler));
+        }
+
+        if (stats) {
+            // Absolute, since the edges run from the build directory
+            const auto stats_file = fs::absolute(fs::path("build") / build_name / build::STATS_FILE);
+            build::compact_stats(stats_file);
+            build_backend->set_command_launcher(
+                util::process::quote(util::process::current_executable()) + " exec --stats " + util::process::quote(stats_file.string()) + " --");
+        }
+
+        build_backend->generate_build_file(build_name);
+
+        // Resolved per build, so the compile history of this profile counts
+        const auto job_count = jobs == "auto"
+            ? std::to_string(build::auto_jobs(fs::path("build") / build_name))
+            : jobs;
+
+        Result<void> built;
+        if (executor == "native") {
+            auto& native_backend = static_cast<build::NativeBackend&>(*build_backend);
+            auto stats = native_backend.execute(target_build, job_count.empty() ? 0 : std::stoul(job_count));
+            if (!stats)
+                built = Err(stats);
+        } else {
+            built = execute_build(build_name, target_build, job_count);
+        }
+
+        // Training can't run without the instrumented binaries
+        if (!built && pgo_instrument)
+            return Err(built);
+
+        if (built && artifact_cache)
+            build::store_prebuilt_libraries(*build_manager);
+
+        if (built && (timings || compile_profile)) {
+            // The native graph names outputs the way both logs do
+            build::NativeBackend graph_backend(*build_manager, selected_compiler, selected_archiver, selected_linker);
+            graph_backend.build_graph(build_name);
+            const auto build_dir = fs::path("build") / build_name;
+
+            if (timings) {
+                auto report = build::write_timings_report(
+                    graph_backend.graph(),
+                    build_dir,
+                    executor == "native" ? build::BUILD_LOG_FILE : ".ninja_log");
+                if (!report)
+                    muuk::logger::warn("Could not write the build timings: {}", report.error().message);
+            }
+
+            if (compile_profile && selected_compiler == muuk::Compiler::Clang) {
+                auto report = build::write_compile_profile(graph_backend.graph(), build_dir);
+                if (report)
+                    muuk::logger::info("Compile profile (also in '{}'):\n{}", (build_dir / "compile_profile.txt").generic_string(), *report);
+                else
+                    muuk::logger::warn("Could not write the compile profile: {}", report.error().message);
+            }
+        }
+
+        if (!pgo_instrument)
+            generate_compile_commands(
+                *build_manager,
+                selected_profile,
+                selected_compiler,
+                selected_archiver,
+                selected_linker);
+
+        return {};
+    }
+
+    /// The files a build reads: the manifests, the sources and the headers
+    /// recorded by the last build. Anything under `build/` is left out, or
+    /// the build would keep triggering itself.
+    static Result<std::vector<std::string>> watched_files(const BuildOptions& options, const toml::value& config) {
+        const auto root = fs::current_path();
+        const auto build_root = (root / "build").generic_string() + "/";
+
+        std::vector<std::string> files = { (root / MUUK_TOML_FILE).generic_string() };
+        auto add = [&](const fs::path& path) {
+            const auto file = fs::absolute(path).lexically_normal().generic_string();
+            if (!file.starts_with(build_root))
+                files.push_back(file);
+        };
+
+        auto lock = muuk::parse_muuk_file<toml::type_config>(MUUK_CACHE_FILE, true);
+        if (!lock)
+            return Err(lock);
+        if (lock->contains("library") && lock->at("library").is_array())
+            for (const auto& library : lock->at("library").as_array())
+                if (library.contains("path"))
+                    add(fs::path(library.at("path").as_string()) / MUUK_TOML_FILE);
+
+        auto compiler_result = options.compiler.empty()
+            ? detect_default_compiler()
+            : muuk::Compiler::from_string(options.compiler);
+        if (!compiler_result)
+            return Err("Error selecting compiler: " + compiler_result.error().message);
+
+        auto profile_result = select_profile(options.profile, config);
+        if (!profile_result)
+            return Err(profile_result);
+
+        const auto build_dir = fs::path("build") / profile_result.value();
+        build::BuildManager build_manager;
+        TRYV(parse(build_manager, compiler_result.value(), build_dir, profile_result.value()));
+
+        for (const auto& target : build_manager.get_compilation_targets())
+            add(target.input);
+
+        // Headers outside the project (the system's) aren't worth a watch
+        for (const auto& [_, headers] : build::load_header_dependencies(build_manager, build_dir))
+            for (const auto& header : headers)
+                if (header.starts_with(root.generic_string() + "/"))
+                    add(header);
+
+        return files;
+    }
+
+    Result<void> watch_cmd(const BuildOptions& options, const std::string& script, const toml::value& config) {
+        BuildOptions build_options = options;
+        toml::value watched_config = config;
+        build::Watcher watcher;
+        bool manifest_valid = true;
+
+        while (true) {
+            if (manifest_valid) {
+                auto built = build_cmd(build_options, watched_config);
+                if (!built)
+                    muuk::logger::error("Build failed: {}", built.error().message);
+                else if (!script.empty())
+                    if (auto ran = run_script(watched_config, script, {}); !ran)
+                        muuk::logger::error("Script '{}' failed: {}", script, ran.error().message);
+                build_options.refresh_lock = false;
+
+                // Without a lock file, the manifest is all there is to watch
+                auto files = watched_files(build_options, watched_config);
+                if (!files)
+                    muuk::logger::warn("Only watching '{}': {}", MUUK_TOML_FILE, files.error().message);
+                TRYV(watcher.watch(files ? *files : std::vector<std::string> { (fs::current_path() / MUUK_TOML_FILE).generic_string() }));
+                muuk::logger::info("Watching {} files for changes. Press Ctrl+C to stop.", files ? files->size() : 1);
+            }
+
+            auto changes = watcher.wait();
+            if (!changes)
+                return Err(changes);
+
+            muuk::logger::info(
+                "{} changed{}",
+                changes->paths.empty() ? "A directory" : changes->paths.front(),
+                changes->paths.size() > 1 ? fmt::format(" (and {} more files)", changes->paths.size() - 1) : "");
+
+            // The lock generator also expands the `sources` globs
+            build_options.refresh_lock = build_options.refresh_lock || changes->manifests || changes->directories;
+
+            if (changes->manifests) {
+                auto parsed = muuk::parse_muuk_file<toml::type_config>(MUUK_TOML_FILE);
+                manifest_valid = static_cast<bool>(parsed);
+                if (!parsed) {
+                    muuk::logger::error("Not rebuilding: {}", parsed.error().message);
+                    continue;
+                }
+                watched_config = parsed.value();
+            }
+        }
+    }
+
+    Result<void> pgo_cmd(const BuildOptions& options, const toml::value& config) {
+        std::vector<std::string> training;
+        std::string pgo_profile;
+        if (config.contains("pgo") && config.at("pgo").is_table()) {
+            const auto& pgo = config.at("pgo");
+            if (pgo.contains("train"))
+                for (const auto& command : pgo.at("train").as_array())
+                    training.push_back(command.as_string());
+            if (pgo.contains("profile"))
+                pgo_profile = pgo.at("profile").as_string();
+        }
+
+        if (training.empty())
+            return Err("No training commands. Add them to 'train' in the [pgo] section of muuk.toml.");
+
+        auto compiler_result = options.compiler.empty()
+            ? detect_default_compiler()
+            : muuk::Compiler::from_string(options.compiler);
+        if (!compiler_result)
+            return Err("Error selecting compiler: " + compiler_result.error().message);
+        const auto compiler = compiler_result.value();
+
+        auto profile_result = select_profile(options.profile.empty() ? pgo_profile : options.profile, config);
+        if (!profile_result)
+            return Err(profile_result);
+        const auto profile = profile_result.value();
+
+        BuildOptions instrumented = options;
+        instrumented.profile = profile;
+        instrumented.pgo_instrument = true;
+        muuk::logger::info("Building the instrumented variant of '{}'", profile);
+        TRYV(build_cmd(instrumented, config));
+
+        // Counters from older binaries would be merged in otherwise
+        const auto raw_dir = build::pgo::raw_profile_dir(profile);
+        fs::remove_all(raw_dir);
+        util::file_system::ensure_directory_exists(raw_dir.string());
+
+        // Training runs the instrumented build, or the binaries at their usual
+        // paths when BOLT swapped them for its own instrumented copies
+        auto run_training = [&](bool instrumented_build) -> Result<void> {
+            for (auto command : training) {
+                // A training entry can name one of the [scripts]
+                if (config.contains("scripts") && config.at("scripts").contains(command) && config.at("scripts").at(command).is_string())
+                    command = util::process::quote(config.at("scripts").at(command).as_string());
+
+                if (instrumented_build)
+                    command = build::pgo::training_command(command, profile);
+                muuk::logger::info("Training: {}", command);
+
+                const int result = util::command_line::execute_command(command);
+                if (result != 0)
+                    return Err("Training command '{}' failed with exit code {}.", command, result);
+            }
+            return {};
+        };
+
+        TRYV(run_training(true));
+
+        auto data = build::pgo::merge_profiles(compiler, profile);
+        if (!data)
+            return Err(data);
+
+        std::string layout;
+        if (auto lock = muuk::parse_muuk_file("build/muuk.lock.toml", true); lock && lock->contains("profile"))
+            if (const auto& profiles = lock->at("profile"); profiles.contains(profile))
+                layout = toml::try_find_or<std::string>(profiles.at(profile), "layout", "");
+
+        if (layout == "symbol-order")
+            if (auto order = build::pgo::write_symbol_order(compiler, profile); !order)
+                muuk::logger::warn(order.error().message);
+
+        BuildOptions optimized = options;
+        optimized.profile = profile;
+        muuk::logger::info("Rebuilding '{}' with the profile in '{}'", profile, data->generic_string());
+        TRYV(build_cmd(optimized, config));
+
+        if (layout != "bolt")
+            return {};
+
+        // BOLT works on the final binaries, so it records its own profile
+        std::vector<fs::path> executables;
+        if (config.contains("build") && config.at("build").is_table())
+            for (const auto& [name, _] : config.at("build").as_table())
+                if (const auto executable = fs::path("build") / profile / (name + EXE_EXT); fs::exists(executable))
+                    executables.push_back(executable);
+
+        TRYV(build::pgo::record_bolt_profiles(executables, profile, [&]() { return run_training(false); }));
+
+        muuk::logger::info("Adding the BOLT-optimized binaries of '{}'", profile);
+        return build_cmd(optimized, config);
+    }
+
+    Result<void> headers_cmd(const HeadersOptions& options, const toml::value& config) {
+        auto compiler_result = options.compiler.empty()
+            ? detect_default_compiler()
+            : muuk::Compiler::from_string(options.compiler);
+        if (!compiler_result)
+            return Err("Error selecting compiler: " + compiler_result.error().message);
+
+        auto profile_result = select_profile(options.profile, config);
+        if (!profile_result)
+            return Err(profile_result);
+
+        const auto build_dir = fs::path("build") / profile_result.value();
+        if (!fs::exists("build/muuk.lock.toml"))
+            return Err("No lock file found. Run 'muuk build' first.");
+
+        build::BuildManager build_manager;
+        TRYV(parse(build_manager, compiler_result.value(), build_dir, profile_result.value()));
+
+        const auto deps = build::load_header_dependencies(build_manager, build_dir);
+        if (deps.empty())
+            return Err("No header dependencies recorded in '{}'. Run 'muuk build' first.", build_dir.generic_string());
+
+        std::vector<build::pch::TranslationUnit> tus;
+        for (const auto& target : build_manager.get_compilation_targets())
+            if (auto it = deps.find(target.output); it != deps.end())
+                tus.push_back({ target.input, it->second });
+
+        const auto report = build::analyze_includes(tus, [](const std::string& path) {
+            std::ifstream in(path);
+            std::stringstream contents;
+            contents << in.rdbuf();
+            return contents.str();
+        });
+
+        fmt::print("{}", build::format_include_report(report, options.top));
+
+        const auto json_path = build_dir / "headers.json";
+        util::file_system::write_if_changed(json_path.string(), build::include_report_json(report).dump(2));
+        muuk::logger::info("Header statistics written to '{}'.", json_path.generic_string());
+        return {};
+    }
+
+    Result<void> stats_cmd(const StatsOptions& options, const toml::value& config) {
+        auto profile_result = select_profile(options.profile, config);
+        if (!profile_result)
+            return Err(profile_result);
+
+        const auto stats_file = fs::path("build") / profile_result.value() / build::STATS_FILE;
+        const auto stats = build::latest_stats(build::load_stats(stats_file));
+        if (stats.empty())
+            return Err("No commands recorded in '{}'. Run 'muuk build --stats' first.", stats_file.generic_string());
 
+        fmt::print("{}", build::format_stats(stats, options.top));
         return {};
     }
 
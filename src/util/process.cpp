@@ -0,0 +1,308 @@
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
+#endif
+
+#include "rustify.hpp"
+#include "util.hpp"
+
+namespace fs = std::filesystem;
+
+namespace util {
+    namespace process {
+        std::string quote(const std::string& arg) {
+            if (!arg.empty() && arg.find_first_of(" \t\n\"'\\$`;&|<>()*?") == std::string::npos)
+                return arg;
+
+#ifdef _WIN32
+            std::string quoted = "\"";
+            for (const char c : arg) {
+                if (c == '"')
+                    quoted += '\\';
+                quoted += c;
+            }
+            return quoted + "\"";
+#else
+            std::string quoted = "'";
+            for (const char c : arg) {
+                if (c == '\'')
+                    quoted += "'\\''";
+                else
+                    quoted += c;
+            }
+            return quoted + "'";
+#endif
+        }
+
+        /// Splits a response file like GCC's `buildargv`: whitespace
+        /// separates arguments, quotes group them and `\` escapes a character.
+        static std::vector<std::string> split_response_file(const std::string& contents) {
+            std::vector<std::string> args;
+            std::string arg;
+            bool in_arg = false;
+            char quote_char = 0;
+
+            for (size_t i = 0; i < contents.size(); ++i) {
+                const char c = contents[i];
+                if (c == '\\' && i + 1 < contents.size()) {
+                    arg += contents[++i];
+                    in_arg = true;
+                } else if (quote_char) {
+                    if (c == quote_char)
+                        quote_char = 0;
+                    else
+                        arg += c;
+                } else if (c == '"' || c == '\'') {
+                    quote_char = c;
+                    in_arg = true;
+                } else if (std::isspace(static_cast<unsigned char>(c))) {
+                    if (in_arg)
+                        args.push_back(std::move(arg));
+                    arg.clear();
+                    in_arg = false;
+                } else {
+                    arg += c;
+                    in_arg = true;
+                }
+            }
+
+            if (in_arg)
+                args.push_back(std::move(arg));
+            return args;
+        }
+
+        static void expand_into(std::vector<std::string>& out, const std::vector<std::string>& args, int depth) {
+            for (const auto& arg : args) {
+                std::ifstream file;
+                if (arg.size() > 1 && arg[0] == '@' && depth < 16)
+                    file.open(arg.substr(1), std::ios::binary);
+
+                // Like the compilers, an unreadable `@file` stays as it is
+                if (!file.is_open()) {
+                    out.push_back(arg);
+                    continue;
+                }
+
+                std::ostringstream contents;
+                contents << file.rdbuf();
+                expand_into(out, split_response_file(contents.str()), depth + 1);
+            }
+        }
+
+        std::vector<std::string> expand_response_files(const std::vector<std::string>& args) {
+            std::vector<std::string> expanded;
+            expand_into(expanded, args, 0);
+            return expanded;
+        }
+
+#ifdef _WIN32
+        static Result<Output> run_command_line(std::string command, const std::string& cwd) {
+            // stderr goes through a temporary file, `_popen` only captures stdout
+            static std::atomic<unsigned> counter = 0;
+            const auto err_file = fs::temp_directory_path()
+                / ("muuk-" + std::to_string(GetCurrentProcessId()) + "-" + std::to_string(counter++) + ".err");
+
+            command = "(" + command + ") 2>" + quote(err_file.string());
+            if (!cwd.empty())
+                command = "cd /d " + quote(cwd) + " && " + command;
+
+            // `cmd /c` strips the outer quotes of the whole line
+            FILE* pipe = _popen(("\"" + command + "\"").c_str(), "rb");
+            if (!pipe)
+                return Err("Failed to run '{}'", command);
+
+            Output output;
+            std::array<char, 4096> buffer;
+            size_t read = 0;
+            while ((read = fread(buffer.data(), 1, buffer.size(), pipe)) > 0)
+                output.out.append(buffer.data(), read);
+
+            output.exit_code = _pclose(pipe);
+
+            std::ifstream err(err_file, std::ios::binary);
+            output.err.assign(std::istreambuf_iterator<char>(err), std::istreambuf_iterator<char>());
+            err.close();
+
+            std::error_code ec;
+            fs::remove(err_file, ec);
+
+            return output;
+        }
+
+        Result<Output> run(const std::vector<std::string>& args, const std::string& cwd) {
+            if (args.empty())
+                return Err("No command given");
+
+            std::string command;
+            for (const auto& arg : args)
+                command += quote(arg) + " ";
+            return run_command_line(command, cwd);
+        }
+
+        Result<Output> run_shell(const std::string& command, const std::string& cwd) {
+            return run_command_line(command, cwd);
+        }
+
+        std::string current_executable() {
+            std::array<char, MAX_PATH> buffer {};
+            const auto length = GetModuleFileNameA(nullptr, buffer.data(), static_cast<DWORD>(buffer.size()));
+            return std::string(buffer.data(), length);
+        }
+
+        void set_env(const std::string& name, const std::string& value) {
+            _putenv_s(name.c_str(), value.c_str());
+        }
+#else
+        /// Pipes must not leak into commands started concurrently by other
+        /// threads, or their readers would only see EOF once those exit.
+        static int make_pipe(int fds[2]) {
+#ifdef __linux__
+            return pipe2(fds, O_CLOEXEC);
+#else
+            if (pipe(fds) != 0)
+                return -1;
+            fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+            fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+            return 0;
+#endif
+        }
+
+        Result<Output> run(const std::vector<std::string>& args, const std::string& cwd) {
+            if (args.empty())
+                return Err("No command given");
+
+            int out_pipe[2];
+            int err_pipe[2];
+            if (make_pipe(out_pipe) != 0)
+                return Err("Failed to create pipe: {}", std::strerror(errno));
+            if (make_pipe(err_pipe) != 0) {
+                close(out_pipe[0]);
+                close(out_pipe[1]);
+                return Err("Failed to create pipe: {}", std::strerror(errno));
+            }
+
+            const pid_t pid = fork();
+            if (pid < 0)
+                return Err("Failed to fork: {}", std::strerror(errno));
+
+            if (pid == 0) {
+                dup2(out_pipe[1], STDOUT_FILENO);
+                dup2(err_pipe[1], STDERR_FILENO);
+                close(out_pipe[0]);
+                close(out_pipe[1]);
+                close(err_pipe[0]);
+                close(err_pipe[1]);
+
+                if (!cwd.empty() && chdir(cwd.c_str()) != 0) {
+                    const std::string message = "muuk: failed to enter '" + cwd + "': " + std::strerror(errno) + "\n";
+                    (void)!write(STDERR_FILENO, message.data(), message.size());
+                    _exit(127);
+                }
+
+                std::vector<char*> argv;
+                for (const auto& arg : args)
+                    argv.push_back(const_cast<char*>(arg.c_str()));
+                argv.push_back(nullptr);
+
+                execvp(argv[0], argv.data());
+
+                const std::string message = "muuk: failed to execute '" + args[0] + "': " + std::strerror(errno) + "\n";
+                (void)!write(STDERR_FILENO, message.data(), message.size());
+                _exit(127);
+            }
+
+            close(out_pipe[1]);
+            close(err_pipe[1]);
+
+            Output output;
+            std::array<pollfd, 2> fds = { {
+                { out_pipe[0], POLLIN, 0 },
+                { err_pipe[0], POLLIN, 0 },
+            } };
+            std::array<std::string*, 2> sinks = { &output.out, &output.err };
+            std::array<char, 4096> buffer;
+
+            int open_fds = 2;
+            while (open_fds > 0) {
+                if (poll(fds.data(), fds.size(), -1) < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    break;
+                }
+
+                for (size_t i = 0; i < fds.size(); ++i) {
+                    if (fds[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                        continue;
+
+                    const auto count = read(fds[i].fd, buffer.data(), buffer.size());
+                    if (count > 0) {
+                        sinks[i]->append(buffer.data(), static_cast<size_t>(count));
+                    } else if (count == 0 || errno != EINTR) {
+                        close(fds[i].fd);
+                        fds[i].fd = -1;
+                        --open_fds;
+                    }
+                }
+            }
+
+            int status = 0;
+            rusage usage {};
+            while (wait4(pid, &status, 0, &usage) < 0 && errno == EINTR) { }
+
+            output.exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+#ifdef __APPLE__
+            output.max_rss_kb = usage.ru_maxrss / 1024; // bytes on macOS
+#else
+            output.max_rss_kb = usage.ru_maxrss;
+#endif
+            output.user_ms = usage.ru_utime.tv_sec * 1000 + usage.ru_utime.tv_usec / 1000;
+            output.sys_ms = usage.ru_stime.tv_sec * 1000 + usage.ru_stime.tv_usec / 1000;
+            output.in_blocks = usage.ru_inblock;
+            output.out_blocks = usage.ru_oublock;
+            return output;
+        }
+
+        Result<Output> run_shell(const std::string& command, const std::string& cwd) {
+            return run({ "/bin/sh", "-c", command }, cwd);
+        }
+
+        std::string current_executable() {
+#ifdef __APPLE__
+            std::array<char, 4096> buffer {};
+            uint32_t size = buffer.size();
+            if (_NSGetExecutablePath(buffer.data(), &size) == 0)
+                return fs::weakly_canonical(buffer.data()).string();
+            return "muuk";
+#else
+            std::error_code ec;
+            const auto path = fs::read_symlink("/proc/self/exe", ec);
+            return ec ? "muuk" : path.string();
+#endif
+        }
+
+        void set_env(const std::string& name, const std::string& value) {
+            setenv(name.c_str(), value.c_str(), 1);
+        }
+#endif
+    } // namespace process
+} // namespace util
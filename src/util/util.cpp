@@ -104,6 +104,20 @@ namespace util {
 #endif
             return new_path;
         }
+
+        void write_if_changed(const std::string& path, const std::string& contents) {
+            if (fs::exists(path)) {
+                std::ifstream in(path, std::ios::binary);
+                const std::string existing((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+                if (existing == contents)
+                    return;
+            }
+
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            if (!out)
+                throw std::runtime_error("Failed to write " + path);
+            out << contents;
+        }
     } // namespace file_system
 
     // ==========================
@@ -266,14 +280,13 @@ namespace util {
 
     namespace string_ops {
         std::string to_lower(const std::string& s) {
-            std::string result;
-            result.reserve(s.size());
+            std::string result = s;
             std::transform(
                 result.begin(),
                 result.end(),
                 result.begin(),
                 [](unsigned char c) -> char { return static_cast<char>(std::tolower(c)); });
-            return s;
+            return result;
         }
     }
 } // namespace util
@@ -29,9 +29,10 @@ namespace muuk {
                 if (flag[0] != '-') {
                     return Err("{} compiler flag (`{}`) must start with `-`", compiler_.to_string(), flag);
                 }
-                // Allowed characters: alphanumeric, `-`, `_`, `=`, `+`, `:`, `.`
+                // Allowed characters: alphanumeric, `-`, `_`, `=`, `+`, `:`, `.`, `/`
+                // and `,` (for `-Wl,` and `-Xlinker` style pass-through flags)
                 for (char c : flag) {
-                    if (!std::isalnum(c) && c != '-' && c != '_' && c != '=' && c != '+' && c != ':' && c != '.' && c != '/') {
+                    if (!std::isalnum(c) && c != '-' && c != '_' && c != '=' && c != '+' && c != ':' && c != '.' && c != '/' && c != ',') {
                         return Err("{} compiler flag (`{}`) contains invalid characters", compiler_.to_string(), flag);
                     }
                 }
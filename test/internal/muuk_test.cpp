@@ -2,6 +2,10 @@
 
 #include "test_build_manager.hpp"
 #include "test_buildparser.hpp"
+#include "test_cache.hpp"
+#include "test_deps.hpp"
+#include "test_dist.hpp"
+#include "test_executor.hpp"
 #include "test_module_resolver.hpp"
 #include "test_muukvalidator.hpp"
 #include "test_util.hpp"
@@ -2,12 +2,19 @@
 #ifndef TEST_BUILD_MANAGER_HPP
 #define TEST_BUILD_MANAGER_HPP
 #include <algorithm>
+#include <filesystem>
+#include <fstream>
 
 #include <gtest/gtest.h>
 
 #include "../../include/compiler.hpp"
+#include "build/isa.hpp"
+#include "build/linker.hpp"
 #include "build/manager.hpp"
+#include "build/pgo.hpp"
+#include "build/resources.hpp"
 #include "build/targets.hpp"
+#include "util.hpp"
 
 using namespace muuk;
 using namespace muuk::build;
@@ -39,6 +46,56 @@ TEST_F(BuildManagerTest, AddCompilationTarget) {
     EXPECT_EQ(compilation_targets[0].flags, std::vector<std::string>({ "-O2", "-Iinclude" }));
 }
 
+// ISPC targets generate a header that other sources wait for
+TEST_F(BuildManagerTest, TracksGeneratedHeaders) {
+    build_manager.add_compilation_target("kernels/price.ispc", "price.ispc.o", {}, CompilationUnitType::Ispc);
+    build_manager.add_compilation_target("source.cpp", "source.o", {});
+    EXPECT_TRUE(build_manager.get_generated_headers().empty());
+
+    auto* kernel = build_manager.find_compilation_target("output", "price.ispc.o");
+    ASSERT_NE(kernel, nullptr);
+    kernel->generated_header = "ispc/price_ispc.h";
+
+    EXPECT_EQ(build_manager.get_generated_headers(), std::vector<std::string>({ "ispc/price_ispc.h" }));
+    EXPECT_EQ(isa::ispc_target("x86-64-v3"), "avx2-i32x8");
+}
+
+TEST_F(BuildManagerTest, SizesResourcePoolsByMemory) {
+    EXPECT_EQ(pool_depth(16384, LINK_JOB_MEMORY_MB), 8u);
+    EXPECT_EQ(pool_depth(1024, HEAVY_JOB_MEMORY_MB), 1u);
+    EXPECT_EQ(pool_depth(0, LINK_JOB_MEMORY_MB), 0u);
+
+    BuildProfile profile;
+    profile.lto_jobs = 1;
+    profile.pools[HEAVY_POOL] = 3;
+
+    const auto pools = resource_pools(&profile, 16384);
+    EXPECT_EQ(pools.at(LINK_POOL), 8u);
+    EXPECT_EQ(pools.at(HEAVY_POOL), 3u);
+    EXPECT_EQ(pools.at(LTO_LINK_POOL), 1u);
+
+    // Unknown memory leaves the pools unbounded
+    EXPECT_TRUE(resource_pools(nullptr, 0).empty());
+}
+
+TEST_F(BuildManagerTest, SizesJobsByCpusAndMemory) {
+    EXPECT_EQ(jobs_within(16, 8192, 1024), 8u);
+    EXPECT_EQ(jobs_within(4, 65536, 1024), 4u);
+    EXPECT_EQ(jobs_within(8, 512, 1024), 1u);
+
+    // Unknown memory leaves the CPUs to decide
+    EXPECT_EQ(jobs_within(8, 0, 1024), 8u);
+}
+
+TEST_F(BuildManagerTest, LinksObjectLibrariesWithoutArchives) {
+    build_manager.add_object_library("libcore.a", { "a.o", "b.o" });
+
+    ASSERT_NE(build_manager.find_object_library("libcore.a"), nullptr);
+    EXPECT_EQ(*build_manager.find_object_library("libcore.a"), std::vector<std::string>({ "a.o", "b.o" }));
+    EXPECT_EQ(build_manager.find_object_library("libother.a"), nullptr);
+    EXPECT_TRUE(build_manager.get_archive_targets().empty());
+}
+
 // TODO: Raise Err for double adding?
 // Test adding a duplicate compilation target (should not add it twice)
 TEST_F(BuildManagerTest, AddDuplicateCompilationTarget) {
@@ -170,4 +227,117 @@ TEST_F(BuildManagerTest, ExecutableLinksToItself) {
     EXPECT_NE(std::find(link_targets[0].inputs.begin(), link_targets[0].inputs.end(), "self_exec"), link_targets[0].inputs.end());
 }
 
+TEST(LinkerTest, SelectsLinkerFlags) {
+    EXPECT_TRUE(linker_flags(Compiler::GCC, "")->empty());
+    EXPECT_FALSE(linker_flags(Compiler::GCC, "ld.bfd").has_value());
+    EXPECT_TRUE(linker_flags(Compiler::MSVC, "lld")->empty());
+
+    // `auto` only ever picks a linker the toolchain can run
+    const auto flags = linker_flags(Compiler::GCC, "auto");
+    ASSERT_TRUE(flags.has_value());
+    if (!flags->empty())
+        EXPECT_TRUE(linker_available(Compiler::GCC, flags->front().substr(std::string("-fuse-ld=").size())));
+}
+
+TEST(PgoTest, MergesGccProfilesForTheOptimizedBuild) {
+    const auto previous = std::filesystem::current_path();
+    const auto dir = std::filesystem::temp_directory_path() / "muuk_pgo_test";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    std::filesystem::current_path(dir);
+
+    EXPECT_EQ(pgo::training_command("./build/release/app.exe --bench", "release"), "./build/release-pgo-gen/app.exe --bench");
+
+    BuildProfile instrumented;
+    ASSERT_TRUE(pgo::add_flags(instrumented, Compiler::GCC, "release", pgo::Stage::Instrument).has_value());
+    EXPECT_EQ(instrumented.lflags, std::vector<std::string>({ "-fprofile-generate" }));
+    EXPECT_FALSE(pgo::add_flags(instrumented, Compiler::MSVC, "release", pgo::Stage::Instrument).has_value());
+
+    // Nothing to optimize with yet
+    BuildProfile optimized;
+    ASSERT_TRUE(pgo::add_flags(optimized, Compiler::GCC, "release", pgo::Stage::Optimize).has_value());
+    EXPECT_TRUE(optimized.cflags.empty());
+    EXPECT_FALSE(pgo::merge_profiles(Compiler::GCC, "release").has_value());
+
+    std::filesystem::create_directories(pgo::raw_profile_dir("release"));
+    std::ofstream(pgo::raw_profile_dir("release") / "^#^#build#release-pgo-gen#muuk_files#a.gcda") << "counters";
+
+    const auto data = pgo::merge_profiles(Compiler::GCC, "release");
+    ASSERT_TRUE(data.has_value());
+    EXPECT_TRUE(std::filesystem::exists(*data / "^#^#build#release#muuk_files#a.gcda"));
+
+    ASSERT_TRUE(pgo::add_flags(optimized, Compiler::GCC, "release", pgo::Stage::Optimize).has_value());
+    ASSERT_FALSE(optimized.cflags.empty());
+    EXPECT_EQ(optimized.cflags.front(), "-fprofile-use=" + data->generic_string());
+
+    std::filesystem::current_path(previous);
+    std::filesystem::remove_all(dir);
+}
+
+TEST(PgoTest, OrdersHottestFunctions) {
+    const std::string show = "Counters:\n"
+                             "  main:\n"
+                             "    Hash: 0x0000000000000001\n"
+                             "    Counters: 1\n"
+                             "    Function count: 1\n"
+                             "  a.cpp;_ZL4helpv:\n"
+                             "    Hash: 0x0000000000000002\n"
+                             "    Counters: 2\n"
+                             "    Function count: 1000\n"
+                             "  _Z4coldv:\n"
+                             "    Hash: 0x0000000000000003\n"
+                             "    Counters: 1\n"
+                             "    Function count: 0\n"
+                             "Instrumentation level: IR\n"
+                             "Functions shown: 3\n";
+
+    EXPECT_EQ(pgo::hottest_functions(show), std::vector<std::string>({ "_ZL4helpv", "main" }));
+}
+
+TEST(IsaTest, DispatchesToTheVariantOfEachLevel) {
+    const auto levels = isa::sort_levels({ "x86-64-v3", "x86-64" });
+    ASSERT_TRUE(levels.has_value());
+    EXPECT_EQ(*levels, std::vector<std::string>({ "x86-64", "x86-64-v3" }));
+    EXPECT_FALSE(isa::sort_levels({ "haswell" }).has_value());
+    EXPECT_EQ(isa::variant_object("build/a.cpp.o", "x86-64-v3"), "build/a.cpp.x86-64-v3.o");
+
+#if defined(__x86_64__) && defined(__linux__)
+    const auto dir = std::filesystem::temp_directory_path() / "muuk_isa_test";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    // Each variant has its own copy of the vtable, inline functions and
+    // globals, which must not leak into the other variant
+    std::ofstream(dir / "kernel.cpp") << "struct Shape { virtual ~Shape() = default; virtual int sides() const { return 4; } };\n"
+                                         "int counter = 7;\n"
+                                         "int sum(int n) { int s = 0; for (int i = 0; i < n; ++i) s += i; return s + counter; }\n"
+                                         "Shape* make() { return new Shape; }\n";
+    std::ofstream(dir / "main.cpp") << "struct Shape { virtual ~Shape() = default; virtual int sides() const { return 4; } };\n"
+                                       "int sum(int n); Shape* make(); extern int counter;\n"
+                                       "int main() { Shape* s = make(); int r = sum(4) + s->sides() + counter; delete s; return r; }\n";
+
+    isa::ArchiveOptions options { "g++", "ar", (dir / "libkernel.a").string(), *levels, {} };
+    for (const auto& level : *levels) {
+        const auto object = isa::variant_object((dir / "kernel.cpp.o").string(), level);
+        const auto compiled = util::process::run({ "g++", "-O2", "-march=" + level, "-c", (dir / "kernel.cpp").string(), "-o", object });
+        ASSERT_TRUE(compiled.has_value());
+        ASSERT_EQ(compiled->exit_code, 0) << compiled->err;
+        options.objects.push_back(object);
+    }
+
+    const auto archived = isa::archive(options);
+    ASSERT_TRUE(archived.has_value()) << archived.error().message;
+
+    const auto linked = util::process::run({ "g++", (dir / "main.cpp").string(), options.output, "-o", (dir / "app").string() });
+    ASSERT_TRUE(linked.has_value());
+    ASSERT_EQ(linked->exit_code, 0) << linked->err;
+
+    const auto ran = util::process::run({ (dir / "app").string() });
+    ASSERT_TRUE(ran.has_value());
+    EXPECT_EQ(ran->exit_code, 6 + 7 + 4 + 7);
+
+    std::filesystem::remove_all(dir);
+#endif
+}
+
 #endif // TEST_BUILD_MANAGER_HPP
@@ -0,0 +1,140 @@
+#pragma once
+#ifndef TEST_CACHE_HPP
+#define TEST_CACHE_HPP
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "build/artifacts.hpp"
+#include "cache/compiler_cache.hpp"
+#include "cache/hash.hpp"
+#include "cache/http.hpp"
+#include "cache/remote_cache.hpp"
+#include "util.hpp"
+
+using namespace muuk::cache;
+
+TEST(CacheHashTest, Sha256KnownAnswers) {
+    EXPECT_EQ(sha256_hex(""), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    EXPECT_EQ(sha256_hex("abc"), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    EXPECT_EQ(
+        sha256_hex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"),
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+}
+
+TEST(CacheHashTest, IncrementalMatchesOneShot) {
+    const std::string data(1000, 'x');
+
+    Sha256 hash;
+    for (size_t i = 0; i < data.size(); i += 7)
+        hash.update(data.substr(i, 7));
+
+    EXPECT_EQ(hash.hex_digest(), sha256_hex(data));
+}
+
+TEST(CompilerInvocationTest, ParsesCacheableCompile) {
+    const auto invocation = parse_invocation({ "g++", "-c", "src/a.cpp", "-o", "a.o", "-O2", "-MD", "-MF", "a.o.d" });
+
+    ASSERT_TRUE(invocation.cacheable);
+    EXPECT_EQ(invocation.source, "src/a.cpp");
+    EXPECT_EQ(invocation.output, "a.o");
+    EXPECT_EQ(invocation.depfile, "a.o.d");
+    EXPECT_EQ(normalized_flags(invocation), std::vector<std::string>({ "-c", "-O2", "-MD" }));
+    EXPECT_EQ(
+        preprocessor_args(invocation),
+        std::vector<std::string>({ "g++", "-E", "src/a.cpp", "-O2" }));
+}
+
+TEST(CompilerInvocationTest, RejectsUncacheableCommands) {
+    EXPECT_FALSE(parse_invocation({ "g++", "a.cpp", "-o", "a" }).cacheable);
+    EXPECT_FALSE(parse_invocation({ "g++", "-c", "a.cpp", "b.cpp" }).cacheable);
+    EXPECT_FALSE(parse_invocation({ "g++", "-c", "a.cpp", "-o", "a.o", "-gsplit-dwarf" }).cacheable);
+}
+
+TEST(RemoteCacheTest, ParsesUrls) {
+    const auto url = parse_url("http://cache.local:9090/team/");
+    ASSERT_TRUE(url);
+    EXPECT_EQ(url->host, "cache.local");
+    EXPECT_EQ(url->port, 9090);
+    EXPECT_EQ(url->prefix, "/team");
+
+    EXPECT_EQ(parse_url("http://cache")->port, 80);
+    EXPECT_FALSE(parse_url("https://cache"));
+    EXPECT_FALSE(parse_url("http://cache:http"));
+}
+
+TEST(RemoteCacheTest, RoundTripsEntries) {
+    std::mutex mutex;
+    std::map<std::string, std::string> stored;
+
+    HttpServer server("127.0.0.1", 0, 2, [&](const HttpRequest& request) -> HttpResponse {
+        std::lock_guard lock(mutex);
+        if (request.method == "PUT") {
+            stored[request.path] = request.body;
+            return { 200, {}, "" };
+        }
+        auto it = stored.find(request.path);
+        return it == stored.end() ? HttpResponse { 404, {}, "" } : HttpResponse { 200, {}, it->second };
+    });
+    ASSERT_TRUE(server.listen());
+    std::thread serving([&] { server.serve(); });
+
+    RemoteCacheOptions options;
+    options.url = "http://127.0.0.1:" + std::to_string(server.port()) + "/prefix";
+    auto remote = RemoteCache::connect(options);
+    ASSERT_TRUE(remote);
+
+    const std::string key(64, 'a');
+    auto miss = remote->fetch(key);
+    ASSERT_TRUE(miss);
+    EXPECT_FALSE(miss->has_value());
+
+    const EntryFiles files = { { "o", std::string(100000, 'x') }, { "d", "a.hpp\n" }, { "stderr", "warning" } };
+    ASSERT_TRUE(remote->upload(key, files));
+    EXPECT_TRUE(stored.contains("/prefix/cas/" + sha256_hex("warning")));
+
+    auto hit = remote->fetch(key);
+    ASSERT_TRUE(hit);
+    ASSERT_TRUE(hit->has_value());
+    EXPECT_EQ(**hit, files);
+
+    server.stop();
+    serving.join();
+}
+
+TEST(ArtifactCacheTest, StoresAndRestoresPrebuiltLibraries) {
+    namespace fs = std::filesystem;
+
+    const auto root = fs::temp_directory_path() / "muuk_artifact_test";
+    fs::remove_all(root);
+    util::process::set_env("MUUK_CACHE_DIR", (root / "cache").string());
+
+    const std::string key(64, 'b');
+    const auto archive = root / "a" / "libfmt.a";
+    fs::create_directories(archive.parent_path());
+    std::ofstream(archive) << "archive";
+
+    EXPECT_FALSE(muuk::build::restore_prebuilt_library(key, root / "b" / "libfmt.a"));
+
+    muuk::build::BuildManager manager;
+    manager.add_prebuilt_library("library.fmt", { key, archive.string(), false });
+    muuk::build::store_prebuilt_libraries(manager);
+
+    const auto restored = root / "b" / "libfmt.a";
+    ASSERT_TRUE(muuk::build::restore_prebuilt_library(key, restored));
+
+    std::ifstream in(restored);
+    EXPECT_EQ(std::string(std::istreambuf_iterator<char>(in), {}), "archive");
+
+    util::process::set_env("MUUK_CACHE_DIR", "");
+    fs::remove_all(root);
+}
+
+#endif // TEST_CACHE_HPP
@@ -0,0 +1,102 @@
+#pragma once
+#ifndef TEST_DEPS_HPP
+#define TEST_DEPS_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "build/auto_pch.hpp"
+#include "build/deps.hpp"
+
+using namespace muuk::build;
+
+TEST(DepfileTest, ParsesPrerequisitesOfFirstTarget) {
+    const std::string depfile = "foo.o: src/foo.cpp \\\n"
+                                "  include/foo.hpp /usr/include/c++/13/vector\n";
+
+    EXPECT_EQ(
+        parse_depfile(depfile),
+        std::vector<std::string>({ "src/foo.cpp", "include/foo.hpp", "/usr/include/c++/13/vector" }));
+}
+
+TEST(DepfileTest, HandlesEscapesAndPhonyTargets) {
+    const std::string depfile = "foo.o: my\\ dir/foo.cpp a$$b.hpp\n"
+                                "a$$b.hpp:\n";
+
+    EXPECT_EQ(
+        parse_depfile(depfile),
+        std::vector<std::string>({ "my dir/foo.cpp", "a$b.hpp" }));
+}
+
+TEST(DepfileTest, ParsesNinjaDepsOutput) {
+    const std::string output = "foo.o: #deps 2, deps mtime 123 (VALID)\n"
+                               "    ../../src/foo.cpp\n"
+                               "    ../../include/foo.hpp\n"
+                               "\n"
+                               "bar.o: #deps 1, deps mtime 456 (STALE)\n"
+                               "    ../../src/bar.cpp\n"
+                               "\n";
+
+    const auto deps = parse_ninja_deps_output(output);
+    ASSERT_EQ(deps.size(), 1);
+    EXPECT_EQ(
+        deps.at("foo.o"),
+        std::vector<std::string>({ "../../src/foo.cpp", "../../include/foo.hpp" }));
+}
+
+TEST(DepfileTest, ReadsNinjaDepsLog) {
+    std::string log = "# ninjadeps\n";
+    auto put = [&log](uint32_t value) { log.append(reinterpret_cast<const char*>(&value), sizeof(value)); };
+    auto path = [&](std::string name, uint32_t id) {
+        name.resize((name.size() + 3) / 4 * 4, '\0');
+        put(static_cast<uint32_t>(name.size() + 4));
+        log += name;
+        put(~id);
+    };
+    auto record = [&](uint32_t output, std::vector<uint32_t> deps) {
+        put(0x80000000u | static_cast<uint32_t>((3 + deps.size()) * 4));
+        put(output);
+        put(123);
+        put(0);
+        for (const auto dep : deps)
+            put(dep);
+    };
+
+    put(4);
+    path("foo.o", 0);
+    path("../../src/foo.cpp", 1);
+    path("../../inc/a.hpp", 2);
+    record(0, { 1 });
+    record(0, { 1, 2 });
+
+    // A truncated record at the end is ignored
+    const auto complete = log;
+    put(0x80000000u | 64);
+
+    const auto deps = read_ninja_deps_log(log);
+    ASSERT_EQ(deps.size(), 1);
+    EXPECT_EQ(deps.at("foo.o"), std::vector<std::string>({ "../../src/foo.cpp", "../../inc/a.hpp" }));
+    EXPECT_EQ(read_ninja_deps_log(complete), deps);
+
+    // Ninja discards logs older than version 3, and so does muuk
+    EXPECT_TRUE(read_ninja_deps_log(std::string("# ninjadeps\n\x02\0\0\0", 16)).empty());
+}
+
+TEST(AutoPchTest, ScansIncludeDirectives) {
+    const std::string source = "#include <vector>\n"
+                               "  #  include \"util.hpp\"\n"
+                               "// #include <ignored>\n"
+                               "#define X 1\n";
+
+    const auto includes = pch::scan_includes(source);
+    ASSERT_EQ(includes.size(), 2);
+    EXPECT_EQ(includes[0].spelling, "vector");
+    EXPECT_TRUE(includes[0].angled);
+    EXPECT_EQ(includes[1].spelling, "util.hpp");
+    EXPECT_FALSE(includes[1].angled);
+}
+
+#endif // TEST_DEPS_HPP
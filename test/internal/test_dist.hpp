@@ -0,0 +1,108 @@
+#pragma once
+#ifndef TEST_DIST_HPP
+#define TEST_DIST_HPP
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "build/deps.hpp"
+#include "cache/compiler_cache.hpp"
+#include "cache/hash.hpp"
+#include "cache/http.hpp"
+#include "dist/client.hpp"
+#include "dist/protocol.hpp"
+#include "dist/worker.hpp"
+
+namespace fs = std::filesystem;
+
+TEST(DistProtocolTest, RoundTripsFields) {
+    const muuk::dist::Fields fields = {
+        { "arg", "-O2" },
+        { "arg", "" },
+        { "object", std::string("\0\x7f" "ELF\n\t", 7) },
+    };
+
+    const auto decoded = muuk::dist::decode_fields(muuk::dist::encode_fields(fields));
+    ASSERT_TRUE(decoded.has_value());
+    EXPECT_EQ(*decoded, fields);
+    EXPECT_EQ(muuk::dist::find_fields(*decoded, "arg").size(), 2);
+
+    EXPECT_FALSE(muuk::dist::decode_fields("arg\t10\nshort").has_value());
+    EXPECT_FALSE(muuk::dist::decode_fields("no header").has_value());
+}
+
+TEST(DistProtocolTest, OnlyAllowsKnownCompilers) {
+    EXPECT_TRUE(muuk::dist::is_allowed_compiler("g++"));
+    EXPECT_TRUE(muuk::dist::is_allowed_compiler("clang++-17"));
+    EXPECT_FALSE(muuk::dist::is_allowed_compiler("/bin/sh"));
+    EXPECT_FALSE(muuk::dist::is_allowed_compiler("g++; rm -rf /"));
+}
+
+TEST(DistWorkerTest, CompilesOnLocalhost) {
+    const auto root = fs::temp_directory_path() / "muuk_dist_test";
+    fs::remove_all(root);
+    fs::create_directories(root / "project" / "include");
+    fs::create_directories(root / "project" / "build");
+
+    const auto project = (root / "project").generic_string();
+    std::ofstream(root / "project" / "include" / "answer.hpp") << "inline int answer() { return 42; }\n";
+    std::ofstream(root / "project" / "main.cpp") << "#include \"answer.hpp\"\nint main() { return answer(); }\n";
+    std::ofstream(root / "project" / "broken.cpp") << "int broken() { return missing; }\n";
+
+    muuk::WorkerOptions worker_options;
+    worker_options.dir = (root / "worker").string();
+    worker_options.port = 0;
+    worker_options.threads = 2;
+
+    muuk::dist::Worker worker(worker_options);
+    ASSERT_TRUE(worker.listen().has_value());
+    std::thread server([&] { worker.serve(); });
+
+    muuk::dist::DistOptions options;
+    options.workers = { "http://127.0.0.1:" + std::to_string(worker.port()) };
+    options.project_root = project;
+
+    auto invocation = [&](const std::string& source, const std::string& object) {
+        return muuk::cache::parse_invocation({ "g++", "-c", project + "/" + source, "-o", project + "/build/" + object,
+                                               "-I" + project + "/include", "-O1", "-MD", "-MF", project + "/build/" + object + ".d" });
+    };
+
+    for (const bool pump : { false, true }) {
+        options.pump = pump;
+
+        const auto compile = invocation("main.cpp", pump ? "pump.o" : "main.o");
+        auto compiled = muuk::dist::compile_remote(options, compile);
+        ASSERT_TRUE(compiled.has_value()) << compiled.error().message;
+        EXPECT_EQ(compiled->exit_code, 0) << compiled->err;
+        EXPECT_GT(fs::file_size(compile.output), 0);
+
+        std::ifstream depfile(compile.depfile);
+        const std::string deps((std::istreambuf_iterator<char>(depfile)), std::istreambuf_iterator<char>());
+        EXPECT_NE(deps.find("answer.hpp"), std::string::npos);
+    }
+
+    // Pump mode sent the header once; the worker has it now
+    muuk::cache::HttpClient client(*muuk::cache::parse_url(options.workers[0]), std::chrono::seconds(5));
+    const auto missing = client.request(
+        "POST",
+        "/missing",
+        muuk::cache::sha256_file(project + "/include/answer.hpp").value_or("") + "\n");
+    ASSERT_TRUE(missing.has_value());
+    EXPECT_EQ(missing->body, "");
+
+    // Errors come back as diagnostics naming the client's paths
+    const auto failed = muuk::dist::compile_remote(options, invocation("broken.cpp", "broken.o"));
+    ASSERT_TRUE(failed.has_value());
+    EXPECT_NE(failed->exit_code, 0);
+    EXPECT_NE(failed->err.find(project + "/broken.cpp"), std::string::npos) << failed->err;
+
+    worker.stop();
+    server.join();
+    fs::remove_all(root);
+}
+
+#endif // TEST_DIST_HPP
@@ -0,0 +1,387 @@
+#pragma once
+#ifndef TEST_EXECUTOR_HPP
+#define TEST_EXECUTOR_HPP
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "build/compile_profile.hpp"
+#include "build/executor.hpp"
+#include "build/include_graph.hpp"
+#include "build/stats.hpp"
+#include "build/timings.hpp"
+#include "build/watch.hpp"
+
+namespace fs = std::filesystem;
+using namespace muuk::build;
+
+class ExecutorTest : public ::testing::Test {
+protected:
+    fs::path dir;
+
+    void SetUp() override {
+        dir = fs::temp_directory_path() / "muuk_executor_test";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+        write("in.txt", "a");
+    }
+
+    void TearDown() override {
+        fs::remove_all(dir);
+    }
+
+    void write(const std::string& name, const std::string& contents) {
+        std::ofstream(dir / name, std::ios::trunc) << contents;
+    }
+
+    /// Moves a file's mtime forward, as if it was edited a bit later.
+    void touch(const std::string& name) {
+        fs::last_write_time(dir / name, fs::last_write_time(dir / name) + std::chrono::seconds(2));
+    }
+
+    static BuildEdge edge(const std::string& output, const std::string& input, const std::string& command) {
+        BuildEdge edge;
+        edge.outputs = { output };
+        edge.inputs = { input };
+        edge.command = command;
+        edge.description = output;
+        return edge;
+    }
+
+    size_t run(const BuildGraph& graph, const std::vector<std::string>& targets = {}) {
+        ExecutorOptions options;
+        options.jobs = 2;
+        options.targets = targets;
+
+        auto stats = Executor(dir, graph).run(options);
+        EXPECT_TRUE(stats.has_value());
+        return stats ? stats->ran : 0;
+    }
+};
+
+TEST_F(ExecutorTest, RebuildsOnlyWhatChanged) {
+    BuildGraph graph;
+    graph.edges.push_back(edge("mid.txt", "in.txt", "cp in.txt mid.txt"));
+    graph.edges.push_back(edge("out.txt", "mid.txt", "cp mid.txt out.txt"));
+    graph.edges.push_back(edge("other.txt", "in2.txt", "cp in2.txt other.txt"));
+    graph.aliases["out"] = { "out.txt" };
+    write("in2.txt", "b");
+
+    EXPECT_EQ(run(graph), 3);
+    EXPECT_EQ(run(graph), 0);
+
+    touch("in.txt");
+    EXPECT_EQ(run(graph, { "out" }), 2);
+
+    // A changed command reruns the edge
+    graph.edges[2].command = "cat in2.txt > other.txt";
+    EXPECT_EQ(run(graph), 1);
+}
+
+TEST_F(ExecutorTest, UnchangedOutputsDontDirtyDependents) {
+    BuildGraph graph;
+    graph.edges.push_back(edge("mid.txt", "in.txt", "cmp -s in.txt mid.txt || cp in.txt mid.txt"));
+    graph.edges.push_back(edge("out.txt", "mid.txt", "cp mid.txt out.txt"));
+
+    EXPECT_EQ(run(graph), 2);
+
+    touch("in.txt");
+    EXPECT_EQ(run(graph), 1);
+    EXPECT_EQ(run(graph), 0);
+}
+
+TEST_F(ExecutorTest, RecordsDepfiles) {
+    BuildGraph graph;
+    auto compile = edge("out.txt", "in.txt", "cp in.txt out.txt && echo 'out.txt: in.txt header.h' > out.txt.d");
+    compile.depfile = "out.txt.d";
+    compile.deps = DepsFormat::Gcc;
+    graph.edges.push_back(compile);
+    write("header.h", "");
+
+    EXPECT_EQ(run(graph), 1);
+    EXPECT_EQ(run(graph), 0);
+
+    touch("header.h");
+    EXPECT_EQ(run(graph), 1);
+
+    DepsLog deps_log;
+    deps_log.load(dir / DEPS_LOG_FILE);
+    ASSERT_TRUE(deps_log.lookup("out.txt").has_value());
+    EXPECT_EQ(deps_log.lookup("out.txt")->deps, std::vector<std::string>({ "in.txt", "header.h" }));
+}
+
+TEST_F(ExecutorTest, StopsOnFailure) {
+    BuildGraph graph;
+    graph.edges.push_back(edge("mid.txt", "in.txt", "exit 1"));
+    graph.edges.push_back(edge("out.txt", "mid.txt", "cp mid.txt out.txt"));
+
+    EXPECT_FALSE(Executor(dir, graph).run({}).has_value());
+    EXPECT_FALSE(fs::exists(dir / "out.txt"));
+
+    // Unknown targets are rejected up front
+    EXPECT_FALSE(Executor(dir, graph).run({ 1, { "missing" } }).has_value());
+}
+
+TEST_F(ExecutorTest, WritesResponseFiles) {
+    BuildGraph graph;
+    auto link = edge("out.txt", "in.txt", "cat $(cat out.txt.rsp) > out.txt");
+    link.rspfile = "out.txt.rsp";
+    link.rspfile_content = "in.txt";
+    graph.edges.push_back(link);
+    write("in2.txt", "b");
+
+    EXPECT_EQ(run(graph), 1);
+    EXPECT_FALSE(fs::exists(dir / "out.txt.rsp"));
+
+    // The response file is part of the command
+    graph.edges[0].rspfile_content = "in.txt in2.txt";
+    EXPECT_EQ(run(graph), 1);
+    EXPECT_EQ(run(graph), 0);
+}
+
+TEST_F(ExecutorTest, LimitsPoolConcurrency) {
+    // `mkdir` fails if another edge of the pool holds the lock
+    const std::string command = "mkdir lock && sleep 0.2 && rmdir lock && cp in.txt ";
+
+    BuildGraph graph;
+    graph.pools[LTO_LINK_POOL] = 1;
+    for (const auto* output : { "a.txt", "b.txt", "c.txt" }) {
+        auto link = edge(output, "in.txt", command + output);
+        link.pool = LTO_LINK_POOL;
+        graph.edges.push_back(link);
+    }
+
+    ExecutorOptions options;
+    options.jobs = 3;
+    auto stats = Executor(dir, graph).run(options);
+    ASSERT_TRUE(stats.has_value());
+    EXPECT_EQ(stats->ran, 3);
+}
+
+TEST(TimingsTest, PrioritizesCriticalPath) {
+    const auto entries = parse_build_log("# ninja log v5\n"
+                                         "0\t100\t0\ta.o\tabc\n"
+                                         "0\t5\t0\tc.o\tdef\n"
+                                         "100\t110\t0\tlib.a\t123\n"
+                                         "110\t160\t0\tapp\t456\n");
+    ASSERT_EQ(entries.size(), 4);
+    EXPECT_EQ(entries[2].output, "lib.a");
+
+    EdgeDurations durations;
+    for (const auto& entry : entries)
+        durations[entry.output] = entry.end_ms - entry.start_ms;
+
+    BuildGraph graph;
+    auto add = [&](const std::string& rule, const std::string& output, std::vector<std::string> inputs) {
+        BuildEdge edge;
+        edge.rule = rule;
+        edge.outputs = { output };
+        edge.inputs = std::move(inputs);
+        graph.edges.push_back(edge);
+    };
+    add("compile", "c.o", { "c.cpp" });
+    add("compile", "a.o", { "a.cpp" });
+    add("compile", "b.o", { "b.cpp" });
+    add("archive", "lib.a", { "a.o" });
+    add("link", "app", { "lib.a", "b.o" });
+
+    assign_priorities(graph, durations);
+
+    EXPECT_DOUBLE_EQ(graph.edges[0].priority, 5.0);
+    EXPECT_DOUBLE_EQ(graph.edges[1].priority, 160.0);
+
+    // No history: the mean of the other compiles
+    EXPECT_DOUBLE_EQ(graph.edges[2].priority, 52.5 + 50.0);
+    EXPECT_DOUBLE_EQ(graph.edges[4].priority, 50.0);
+}
+
+TEST(TimingsTest, ReportsLastBuild) {
+    const auto entries = last_build_entries(parse_build_log("# ninja log v5\n"
+                                                            "0\t900\t0\told.o\tabc\n"
+                                                            "0\t30\t0\tb.o\tdef\n"
+                                                            "0\t100\t0\ta.o\tabc\n"
+                                                            "100\t110\t0\tlib.a\t123\n"
+                                                            "110\t160\t0\tapp\t456\n"));
+    ASSERT_EQ(entries.size(), 4);
+
+    BuildGraph graph;
+    auto add = [&](const std::string& rule, const std::string& output, std::vector<std::string> inputs) {
+        BuildEdge edge;
+        edge.rule = rule;
+        edge.outputs = { output };
+        edge.inputs = std::move(inputs);
+        graph.edges.push_back(edge);
+    };
+    add("compile", "a.o", { "a.cpp" });
+    add("compile", "b.o", { "b.cpp" });
+    add("archive", "lib.a", { "a.o" });
+    add("link", "app", { "lib.a", "b.o" });
+
+    const auto report = analyze_timings(graph, entries);
+    ASSERT_EQ(report.edges.size(), 4);
+    EXPECT_EQ(report.wall_ms, 160);
+    EXPECT_EQ(report.total_ms, 190);
+    EXPECT_EQ(report.lanes, 2);
+
+    std::vector<std::string> path;
+    for (const auto index : report.critical_path)
+        path.push_back(report.edges[index].output);
+    EXPECT_EQ(path, std::vector<std::string>({ "a.o", "lib.a", "app" }));
+
+    for (const auto& edge : report.edges)
+        if (edge.output == "a.o" || edge.output == "b.o")
+            EXPECT_EQ(edge.group, edge.output == "a.o" ? "lib.a" : "app");
+
+    EXPECT_NE(format_chrome_trace(report).find("\"ph\": \"X\""), std::string::npos);
+}
+
+TEST(CompileProfileTest, AggregatesTimeTraces) {
+    const std::string trace = R"({"traceEvents": [
+        {"ph": "X", "name": "ExecuteCompiler", "ts": 0, "dur": 9000},
+        {"ph": "X", "name": "Frontend", "ts": 0, "dur": 6000},
+        {"ph": "X", "name": "Source", "ts": 0, "dur": 4000, "args": {"detail": "/usr/include/c++/13/vector"}},
+        {"ph": "X", "name": "InstantiateClass", "ts": 0, "dur": 2000, "args": {"detail": "std::vector<int>"}},
+        {"ph": "X", "name": "InstantiateClass", "ts": 0, "dur": 1000, "args": {"detail": "std::vector<char>"}},
+        {"ph": "X", "name": "Backend", "ts": 6000, "dur": 3000},
+        {"ph": "M", "name": "process_name"}
+    ]})";
+
+    CompileProfile profile;
+    ASSERT_TRUE(add_time_trace(profile, "a.o", trace).has_value());
+    ASSERT_TRUE(add_time_trace(profile, "b.o", trace).has_value());
+    EXPECT_FALSE(add_time_trace(profile, "c.o", "not json").has_value());
+
+    EXPECT_EQ(profile.translation_units, 2);
+    EXPECT_EQ(profile.frontend_us, 12000);
+    EXPECT_EQ(profile.headers["/usr/include/c++/13/vector"].count, 2);
+    EXPECT_EQ(profile.templates["std::vector<$>"].total_us, 6000);
+
+    const auto report = format_compile_profile(profile, 1);
+    EXPECT_NE(report.find("std::vector<int>"), std::string::npos);
+    EXPECT_EQ(report.find("std::vector<char>"), std::string::npos);
+}
+
+TEST(IncludeGraphTest, RanksHeadersByCost) {
+    const std::unordered_map<std::string, std::string> files = {
+        { "/p/a.cpp", "#include \"big.hpp\"\n#include <small.hpp>\n" },
+        { "/p/b.cpp", "#include \"big.hpp\"\n" },
+        { "/p/c.cpp", "#include <small.hpp>\n" },
+        { "/p/big.hpp", "#include \"detail/inner.hpp\"\n" + std::string(100, ' ') },
+        { "/p/detail/inner.hpp", std::string(1000, ' ') },
+        { "/usr/include/small.hpp", std::string(10, ' ') },
+    };
+
+    const std::vector<pch::TranslationUnit> tus = {
+        { "/p/a.cpp", { "/p/big.hpp", "/p/detail/inner.hpp", "/usr/include/small.hpp" } },
+        { "/p/b.cpp", { "/p/big.hpp", "/p/detail/inner.hpp" } },
+        { "/p/c.cpp", { "/usr/include/small.hpp" } },
+    };
+
+    const auto report = analyze_includes(tus, [&](const std::string& path) {
+        auto it = files.find(path);
+        return it != files.end() ? it->second : std::string();
+    });
+
+    ASSERT_EQ(report.headers.size(), 3);
+    const auto& big = report.headers[0];
+    EXPECT_EQ(big.path, "/p/big.hpp");
+    EXPECT_EQ(big.transitive_size, files.at("/p/big.hpp").size() + 1000);
+    EXPECT_EQ(big.translation_units, 2);
+    EXPECT_EQ(big.includers, 2);
+    EXPECT_EQ(big.cost, big.transitive_size * 2);
+
+    EXPECT_EQ(report.headers[1].path, "/p/detail/inner.hpp");
+    EXPECT_EQ(report.headers[1].includers, 1);
+    EXPECT_EQ(report.headers[2].transitive_size, 10);
+
+    EXPECT_EQ(include_report_json(report)["headers"].size(), 3);
+}
+
+TEST(StatsTest, RoundTripsRecords) {
+    CommandStats first;
+    first.output = "a.cpp.o";
+    first.tool = "g++";
+    first.user_ms = 1200;
+    first.max_rss_kb = 1 << 20;
+
+    CommandStats rebuilt = first;
+    rebuilt.user_ms = 900;
+    rebuilt.exit_code = 1;
+
+    CommandStats link;
+    link.output = "app";
+    link.tool = "ld";
+    link.sys_ms = -1;
+
+    const auto contents = encode_stats(first) + encode_stats(link) + encode_stats(rebuilt);
+    const auto records = decode_stats(contents);
+    ASSERT_EQ(records.size(), 3);
+    EXPECT_EQ(records[0].max_rss_kb, 1 << 20);
+    EXPECT_EQ(records[1].sys_ms, -1);
+
+    // A record cut short by an interrupted write is dropped
+    EXPECT_EQ(decode_stats(contents.substr(0, contents.size() - 3)).size(), 2);
+
+    const auto latest = latest_stats(records);
+    ASSERT_EQ(latest.size(), 2);
+    EXPECT_EQ(latest[0].output, "app");
+    EXPECT_EQ(latest[1].user_ms, 900);
+    EXPECT_EQ(latest[1].exit_code, 1);
+}
+
+TEST(StatsTest, DescribesCommands) {
+    using Description = std::pair<std::string, std::string>;
+    EXPECT_EQ(describe_command({ "/usr/bin/g++", "-c", "a.cpp", "-o", "a.cpp.o", "-MD", "-MF", "a.cpp.o.d" }), Description("a.cpp.o", "g++"));
+    EXPECT_EQ(describe_command({ "muuk", "cc-wrap", "--", "clang++", "-c", "a.cpp", "-o", "a.o" }), Description("a.o", "clang++"));
+    EXPECT_EQ(describe_command({ "cl", "/c", "a.cpp", "/Foa.obj" }), Description("a.obj", "cl"));
+    EXPECT_EQ(describe_command({ "link", "@app.exe.rsp", "/OUT:app.exe" }), Description("app.exe", "link"));
+}
+
+#ifdef __linux__
+TEST(WatchTest, ClassifiesChanges) {
+    const auto dir = fs::temp_directory_path() / "muuk_watch_test";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    const auto source = (dir / "a.cpp").generic_string();
+    std::ofstream(source) << "int a;";
+
+    Watcher watcher;
+    ASSERT_TRUE(watcher.watch({ source }));
+    const std::chrono::milliseconds quiet(20);
+
+    // An edit only rebuilds
+    std::ofstream(source) << "int a = 1;";
+    auto changes = watcher.wait(quiet);
+    ASSERT_TRUE(changes);
+    EXPECT_FALSE(changes->manifests);
+    EXPECT_FALSE(changes->directories);
+    EXPECT_EQ(changes->paths, std::vector<std::string>({ source }));
+
+    // Saving through a renamed temporary is still an edit
+    std::ofstream(dir / "a.cpp.tmp") << "int a = 2;";
+    fs::rename(dir / "a.cpp.tmp", source);
+    changes = watcher.wait(quiet);
+    ASSERT_TRUE(changes);
+    EXPECT_FALSE(changes->directories);
+
+    // A new source may match a glob; a burst is a single change
+    std::ofstream(dir / "b.cpp") << "int b;";
+    std::ofstream(dir / "muuk.toml") << "[package]";
+    std::ofstream(dir / "notes.txt") << "ignored";
+    changes = watcher.wait(quiet);
+    ASSERT_TRUE(changes);
+    EXPECT_TRUE(changes->manifests);
+    EXPECT_TRUE(changes->directories);
+    EXPECT_EQ(changes->paths.size(), 2);
+
+    fs::remove_all(dir);
+}
+#endif
+
+#endif // TEST_EXECUTOR_HPP
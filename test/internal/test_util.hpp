@@ -83,3 +83,12 @@ TEST_F(UtilTest, EnsureGitignoreCreationEdgeCases) {
     std::getline(file, content);
     EXPECT_EQ(content, "*");
 }
+
+TEST_F(UtilTest, ExpandResponseFiles) {
+    fs::create_directories(test_directory);
+    std::ofstream(test_directory + "/nested.rsp") << "-O2";
+    std::ofstream(test_directory + "/args.rsp") << "-c a.cpp\n\"-DNAME=a b\" -I'x y' \\@literal @" << test_directory << "/nested.rsp";
+
+    EXPECT_EQ(util::process::expand_response_files({ "g++", "@" + test_directory + "/args.rsp", "@missing.rsp" }),
+        std::vector<std::string>({ "g++", "-c", "a.cpp", "-DNAME=a b", "-Ix y", "@literal", "-O2", "@missing.rsp" }));
+}